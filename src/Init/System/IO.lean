@@ -204,6 +204,11 @@ def sleep (ms : UInt32) : BaseIO Unit :=
 /-- Check if the task has finished execution, at which point calling `Task.get` will return immediately. -/
 @[extern "lean_io_has_finished"] opaque hasFinished : @& Task α → BaseIO Bool
 
+/--
+Return the number of worker threads running tasks of non-dedicated priority, or `0` if tasks are run synchronously
+because there is no task manager. -/
+@[extern "lean_io_get_num_task_workers"] opaque getNumTaskWorkers : BaseIO Nat
+
 /-- Wait for the task to finish, then return its result. -/
 @[extern "lean_io_wait"] opaque wait (t : Task α) : BaseIO α :=
   return t.get
@@ -219,6 +224,64 @@ local macro "nonempty_list" : tactic =>
 /-- Helper method for implementing "deterministic" timeouts. It is the number of "small" memory allocations performed by the current execution thread. -/
 @[extern "lean_io_get_num_heartbeats"] opaque getNumHeartbeats : BaseIO Nat
 
+/--
+Return the memory of free pages and unused segments of the small object allocator to the operating system.
+This is done automatically every few million allocations, see `LEAN_RELEASE_FREE_MEMORY_THRESHOLD`,
+but long-running processes may want to call it explicitly after a memory-intensive operation.
+-/
+@[extern "lean_io_release_free_memory"] opaque releaseFreeMemory : BaseIO Unit
+
+/-- Allocation statistics for the objects of one size class of the small object allocator. -/
+structure AllocSlotStats where
+  /-- Size in bytes of the objects in this size class. -/
+  objSize   : UInt64
+  numAllocs : UInt64
+  numFrees  : UInt64
+  deriving Repr, Inhabited
+
+/--
+Allocation statistics aggregated over all threads, see `IO.getAllocStats`.
+Objects bigger than the largest size class are only included in `numAllocs`, `numFrees`, and `liveBytes`.
+-/
+structure AllocStats where
+  numAllocs            : UInt64
+  numFrees             : UInt64
+  /-- Number of bytes used by objects that have not been freed yet, including size class rounding. -/
+  liveBytes            : UInt64
+  /-- Number of segments obtained from the operating system and not released yet. -/
+  numSegments          : UInt64
+  /-- Number of 8 KB pages in use. -/
+  numPages             : UInt64
+  /-- Number of objects freed by a thread different from the one that allocated them. -/
+  numRemoteFrees       : UInt64
+  /-- Number of segments backed by `MAP_HUGETLB` pages, see `LEAN_HUGE_PAGES`. -/
+  numHugetlbSegments   : UInt64
+  /-- Number of segments marked for transparent huge pages, see `LEAN_HUGE_PAGES`. -/
+  numThpSegments       : UInt64
+  /-- Number of segments where huge pages were requested but are not available. -/
+  numHugePageFallbacks : UInt64
+  /-- Statistics for the size classes that have been used. -/
+  slots                : Array AllocSlotStats
+  deriving Repr, Inhabited
+
+/--
+Return allocation statistics for the whole process. The counters are always enabled and are
+maintained per thread without synchronization, so this is cheap to call in production, but values for threads
+that are running concurrently may be slightly out of date.
+-/
+@[extern "lean_io_get_alloc_stats"] opaque getAllocStats : BaseIO AllocStats
+
+/--
+Start recording the events of the task manager, which are written to `fname` in Chrome trace event format by
+`IO.stopTaskTrace` or at exit. `%p` in `fname` is replaced with the process id. Events of previous traces are
+discarded, and nothing happens if tracing is already enabled, e.g. by setting `LEAN_TASK_TRACE`. Only the last
+`LEAN_TASK_TRACE_BUFFER_SIZE` events of each thread are kept.
+-/
+@[extern "lean_io_start_task_trace"] opaque startTaskTrace (fname : @& FilePath) : IO Unit
+
+/-- Stop recording task events and write the trace started by `IO.startTaskTrace` or `LEAN_TASK_TRACE`. -/
+@[extern "lean_io_stop_task_trace"] opaque stopTaskTrace : IO Unit
+
 /--
 The mode of a file handle (i.e., a set of `open` flags and an `fdopen` mode).
 
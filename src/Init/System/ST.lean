@@ -94,6 +94,25 @@ def Ref.modifyGet {σ α β : Type} (r : Ref σ α) (f : α → β × α) : ST 
   Ref.set r a
   pure b
 
+/--
+Atomically updates the value of `r` using `f`. Unlike `Ref.modify`, the value is never taken out of `r`, so threads
+reading `r` concurrently are not blocked while `f` is running. On the other hand, if the reference is shared between
+threads, `f` receives a shared value and may be applied more than once when other threads write to `r` concurrently,
+so the value cannot be updated destructively.
+-/
+@[extern "lean_st_ref_atomic_modify"]
+def Ref.atomicModify {σ α : Type} (r : @& Ref σ α) (f : α → α) : ST σ Unit := do
+  let v ← Ref.get r
+  Ref.set r (f v)
+
+/-- Atomically updates the value of `r` using `f` and returns the first component of its result. See `Ref.atomicModify`. -/
+@[extern "lean_st_ref_atomic_modify_get"]
+def Ref.atomicModifyGet {σ α β : Type} (r : @& Ref σ α) (f : α → β × α) : ST σ β := do
+  let v ← Ref.get r
+  let (b, a) := f v
+  Ref.set r a
+  pure b
+
 end Prim
 
 section
@@ -107,6 +126,8 @@ variable {σ : Type} {m : Type → Type} [Monad m] [MonadLiftT (ST σ) m]
 @[inline] def Ref.ptrEq {α : Type} (r1 r2 : Ref σ α) : m Bool := liftM <| Prim.Ref.ptrEq r1 r2
 @[inline] def Ref.modify {α : Type} (r : Ref σ α) (f : α → α) : m Unit := liftM <| Prim.Ref.modify r f
 @[inline] def Ref.modifyGet {α : Type} {β : Type} (r : Ref σ α) (f : α → β × α) : m β := liftM <| Prim.Ref.modifyGet r f
+@[inline] def Ref.atomicModify {α : Type} (r : Ref σ α) (f : α → α) : m Unit := liftM <| Prim.Ref.atomicModify r f
+@[inline] def Ref.atomicModifyGet {α : Type} {β : Type} (r : Ref σ α) (f : α → β × α) : m β := liftM <| Prim.Ref.atomicModifyGet r f
 
 def Ref.toMonadStateOf (r : Ref σ α) : MonadStateOf α m where
   get := r.get
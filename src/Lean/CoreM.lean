@@ -5,6 +5,7 @@ Authors: Leonardo de Moura
 -/
 import Lean.Util.RecDepth
 import Lean.Util.Trace
+import Lean.Util.FoldConsts
 import Lean.Log
 import Lean.Eval
 import Lean.ResolveName
@@ -282,15 +283,87 @@ def Exception.isMaxHeartbeat (ex : Exception) : Bool :=
 def mkArrow (d b : Expr) : CoreM Expr :=
   return Lean.mkForall (← mkFreshUserName `x) BinderInfo.default d b
 
+register_builtin_option kernel.async : Bool := {
+  defValue := false
+  descr := "(kernel) type check the values of theorems in separate tasks, failures are reported by `#print axioms` and at the end of the file"
+}
+
+register_builtin_option kernel.profile : Bool := {
+  defValue := false
+  descr := "(kernel) report the calls of the kernel functions and the unfolded constants for declarations whose type checking takes at least `kernel.profile.threshold` milliseconds. Declarations are then checked synchronously, even if `kernel.async` is set"
+}
+
+register_builtin_option kernel.profile.threshold : Nat := {
+  defValue := 100
+  descr := "(kernel) threshold in milliseconds for reporting declarations with `kernel.profile`"
+}
+
+register_builtin_option kernel.profile.json : String := {
+  defValue := ""
+  descr := "(kernel) file to which `kernel.profile` appends a JSON object for each reported declaration, one per line"
+}
+
+register_builtin_option kernel.hashCons : Bool := {
+  defValue := false
+  descr := "(kernel) share the structurally equal subterms of declarations before type checking them, see `Kernel.hashCons`"
+}
+
+/--
+Apply `Kernel.hashCons` to the types and values of `decl`. Since `addDecl` stores the result in the environment, the
+subterms of later declarations are also shared with those of the declarations added with `kernel.hashCons` before. -/
+private def hashConsDecl (decl : Declaration) : CoreM Declaration :=
+  decl.mapExprM fun e => Kernel.hashCons e
+
+/-- Report `profile` for `decl` if type checking it took at least `kernel.profile.threshold` milliseconds. -/
+private def reportKernelProfile (decl : Declaration) (profile : KernelProfile) : CoreM Unit := do
+  let opts ← getOptions
+  if profile.nanos < kernel.profile.threshold.get opts * 1000000 then
+    return
+  let unfolded := profile.unfolded.qsort fun a b => a.2 > b.2 || (a.2 == b.2 && Name.lt a.1 b.1)
+  let mut msg := m!"kernel type checking of {decl.getNames} took {profile.nanos / 1000000}ms"
+  for c in profile.counters do
+    msg := msg ++ m!"\n  {c.fn}: {c.calls} calls, {c.hits} hits"
+  unless unfolded.isEmpty do
+    msg := msg ++ m!"\n  most unfolded: " ++ ", ".intercalate ((unfolded.extract 0 10).toList.map fun (n, k) => s!"{n} ({k})")
+  logInfo msg
+  let fileName := kernel.profile.json.get opts
+  unless fileName.isEmpty do
+    let json := Json.mkObj [
+      ("module",   toJson (← getEnv).mainModule),
+      ("decls",    toJson decl.getNames),
+      ("nanos",    toJson profile.nanos),
+      ("counters", Json.mkObj <| profile.counters.toList.map fun c =>
+        (c.fn, Json.mkObj [("calls", toJson c.calls), ("hits", toJson c.hits)])),
+      ("unfolded", Json.mkObj <| unfolded.toList.map fun (n, k) => (n.toString, toJson k))]
+    IO.FS.withFile fileName .append fun h => h.putStrLn json.compress
+
 def addDecl (decl : Declaration) : CoreM Unit := do
   profileitM Exception "type checking" (← getOptions) do
     withTraceNode `Kernel (fun _ => return m!"typechecking declaration") do
       if !(← MonadLog.hasErrors) && decl.hasSorry then
         logWarning "declaration uses 'sorry'"
-      match (← getEnv).addDecl decl with
+      let opts ← getOptions
+      let decl ← if kernel.hashCons.get opts then hashConsDecl decl else pure decl
+      -- the profile covers the whole check, so `kernel.profile` takes precedence over `kernel.async`
+      let result ← if kernel.profile.get opts then
+          let (result, profile) := (← getEnv).addDeclWithProfile decl
+          reportKernelProfile decl profile
+          pure result
+        else if kernel.async.get opts then
+          pure <| (← getEnv).addDeclAsync decl
+        else
+          pure <| (← getEnv).addDecl decl
+      match result with
       | Except.ok    env => setEnv env
       | Except.error ex  => throwKernelException ex
 
+/-- Wait for the kernel checks started by `addDecl` when `kernel.async` is set, and log their failures. -/
+def joinKernelChecks : CoreM Unit := do
+  let (env, failures) := (← getEnv).joinKernelChecks
+  setEnv env
+  for (declName, ex) in failures do
+    logError m!"failed to type check '{declName}'{indentD (ex.toMessageData (← getOptions))}"
+
 private def supportedRecursors :=
   #[``Empty.rec, ``False.rec, ``Eq.ndrec, ``Eq.rec, ``Eq.recOn, ``Eq.casesOn, ``False.casesOn, ``Empty.casesOn, ``And.rec, ``And.casesOn]
 
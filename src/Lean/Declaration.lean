@@ -188,6 +188,32 @@ def Declaration.isUnsafeInductiveDeclEx : Declaration → Bool
 @[inline] def Declaration.forExprM {m : Type → Type} [Monad m] (d : Declaration) (f : Expr → m Unit) : m Unit :=
   d.foldExprM (fun _ a => f a) ()
 
+/-- Replace the types and values of `d` with the results of `f`. -/
+@[specialize] def Declaration.mapExprM {m : Type → Type} [Monad m] (d : Declaration) (f : Expr → m Expr) : m Declaration :=
+  match d with
+  | Declaration.quotDecl           => pure d
+  | Declaration.axiomDecl val      => return .axiomDecl { val with type := (← f val.type) }
+  | Declaration.defnDecl val       => return .defnDecl { val with type := (← f val.type), value := (← f val.value) }
+  | Declaration.opaqueDecl val     => return .opaqueDecl { val with type := (← f val.type), value := (← f val.value) }
+  | Declaration.thmDecl val        => return .thmDecl { val with type := (← f val.type), value := (← f val.value) }
+  | Declaration.mutualDefnDecl vals =>
+    return .mutualDefnDecl (← vals.mapM fun val => return { val with type := (← f val.type), value := (← f val.value) })
+  | Declaration.inductDecl lparams nparams inductTypes isUnsafe => do
+    let inductTypes ← inductTypes.mapM fun inductType => return { inductType with
+      type  := (← f inductType.type)
+      ctors := (← inductType.ctors.mapM fun ctor => return { ctor with type := (← f ctor.type) }) }
+    return .inductDecl lparams nparams inductTypes isUnsafe
+
+/-- Return the names of the constants declared by `d`, not including the constructors and recursors of inductive types. -/
+def Declaration.getNames : Declaration → List Name
+  | Declaration.quotDecl                       => [``Quot]
+  | Declaration.axiomDecl { name := n, .. }    => [n]
+  | Declaration.defnDecl { name := n, .. }     => [n]
+  | Declaration.opaqueDecl { name := n, .. }   => [n]
+  | Declaration.thmDecl { name := n, .. }      => [n]
+  | Declaration.mutualDefnDecl defs            => defs.map fun d => d.name
+  | Declaration.inductDecl _ _ inductTypes _   => inductTypes.map fun t => t.name
+
 /-- The kernel compiles (mutual) inductive declarations (see `inductiveDecls`) into a set of
     - `Declaration.inductDecl` (for each inductive datatype in the mutual Declaration),
     - `Declaration.ctorDecl` (for each Constructor in the mutual Declaration),
@@ -67,7 +67,11 @@ def processCommand : FrontendM Bool := do
 
 partial def processCommands : FrontendM Unit := do
   let done ← processCommand
-  unless done do
+  if done then
+    -- report failures of kernel checks started with `kernel.async` at the end of the input
+    let stx := (← get).commands.back
+    runCommandElabM <| withRef stx <| Command.liftCoreM joinKernelChecks
+  else
     processCommands
 
 end Frontend
@@ -120,6 +124,8 @@ def runFrontend
     let ilean := { module := mainModuleName, references : Lean.Server.Ilean }
     IO.FS.writeFile ileanFileName $ Json.compress $ toJson ilean
 
+  -- do not lose the import image written in the background, see `importImageDir`
+  waitImportImageWrites
   pure (s.commandState.env, !s.commandState.messages.hasErrors)
 
 end Lean.Elab
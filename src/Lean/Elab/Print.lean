@@ -124,6 +124,7 @@ private def printAxiomsOf (constName : Name) : CommandElabM Unit := do
 @[builtin_command_elab «printAxioms»] def elabPrintAxioms : CommandElab
   | `(#print%$tk axioms $id) => withRef tk do
     let cs ← resolveGlobalConstWithInfos id
+    liftCoreM joinKernelChecks
     cs.forM printAxiomsOf
   | _ => throwUnsupportedSyntax
 
@@ -31,7 +31,7 @@ abbrev ConstMap := SMap Name ConstantInfo
 structure Import where
   module      : Name
   runtimeOnly : Bool := false
-  deriving Repr, Inhabited
+  deriving Repr, Inhabited, BEq, Hashable
 
 instance : Coe Name Import := ⟨({module := ·})⟩
 
@@ -74,8 +74,57 @@ structure ModuleData where
   -/
   extraConstNames : Array Name
   entries         : Array (Name × Array EnvExtensionEntry)
+  /--
+  Index of `constNames` sorted by name hash, see `mkConstIndex`. It is used to find imported constants
+  without inserting all of them in the environment when `lazyImport` is set.
+  -/
+  constIndex      : ByteArray := .empty
   deriving Inhabited
 
+register_builtin_option importImageDir : String := {
+  defValue := ""
+  descr    := "directory in which to cache the linked imports of a module header as a single image file, which is reused by all files with the same header as long as the imported .olean files are unchanged; empty to disable"
+}
+
+register_builtin_option importImageDirMaxSize : Nat := {
+  defValue := 4096
+  descr    := "maximal total size in megabytes of the images in `importImageDir`; when a new image exceeds it, the images written least recently are deleted; 0 for no limit"
+}
+
+register_builtin_option compressOLean : Bool := {
+  defValue := false
+  descr    := "write the .olean file of the module in a compressed format, which is smaller but cannot be mapped into memory when importing it; intended for distributing build artifacts"
+}
+
+register_builtin_option kernel.sharedCacheSize : Nat := {
+  defValue := 0
+  descr    := "(kernel) maximum number of type inference and reduction results of closed terms using only imported constants that are shared by the kernel type checkers of all declarations added to an imported environment; 0 to disable"
+}
+
+register_builtin_option lazyImport : Bool := {
+  defValue := false
+  descr    := "find imported constants on demand using the constant indices of the imported .olean files instead of inserting them in the environment when importing. Functions enumerating `Environment.constants` only see the constants of the current module in this mode."
+}
+
+/-- Sort the hashes of `constNames` together with their positions, see `src/library/module.cpp`. -/
+@[extern "lean_mk_const_index"]
+opaque mkConstIndex (constNames : @& Array Name) : ByteArray
+
+/--
+Merge the constant indices of `mods`. If a constant is declared in two modules, return the index of the
+second module and the position of the constant in its `constNames`.
+-/
+@[extern "lean_mk_imported_const_index"]
+opaque mkImportedConstIndex (mods : @& Array ModuleData) : Except (Nat × Nat) ByteArray
+
+/-- Find an imported constant using an index created by `mkImportedConstIndex`. -/
+@[extern "lean_find_imported_const"]
+opaque findImportedConst? (index : @& ByteArray) (mods : @& Array ModuleData) (n : @& Name) : Option ConstantInfo
+
+/-- Find the module declaring an imported constant using an index created by `mkImportedConstIndex`. -/
+@[extern "lean_find_imported_const_module_idx"]
+opaque findImportedConstModuleIdx? (index : @& ByteArray) (mods : @& Array ModuleData) (n : @& Name) : Option ModuleIdx
+
 /-- Environment fields that are not used often. -/
 structure EnvironmentHeader where
   /--
@@ -100,6 +149,12 @@ structure EnvironmentHeader where
   moduleNames  : Array Name   := #[]
   /-- Module data for all imported modules. -/
   moduleData   : Array ModuleData := #[]
+  /--
+  Merged constant index of `moduleData` if the modules were imported with `lazyImport`.
+  In this case, imported constants are not in `Environment.constants`, and `Environment.const2ModIdx` only
+  contains the extra constant names of imported modules.
+  -/
+  constIndex?  : Option ByteArray := none
   deriving Nonempty
 
 /--
@@ -155,25 +210,49 @@ namespace Environment
 private def addAux (env : Environment) (cinfo : ConstantInfo) : Environment :=
   { env with constants := env.constants.insert cinfo.name cinfo }
 
+@[export lean_environment_find]
+def find? (env : Environment) (n : Name) : Option ConstantInfo :=
+  /- It is safe to use `find'` because we never overwrite imported declarations. -/
+  match env.constants.find?' n, env.header.constIndex? with
+  | none, some index => findImportedConst? index env.header.moduleData n
+  | c,    _          => c
+
+def contains (env : Environment) (n : Name) : Bool :=
+  env.constants.contains n || match env.header.constIndex? with
+    | some index => (findImportedConstModuleIdx? index env.header.moduleData n).isSome
+    | none       => false
+
+/--
+  Run `f` on all constants of the environment. Unlike `env.constants.forM`, this includes the imported constants
+  that were not inserted in `env.constants` because `lazyImport` is set. These are read in place from the data of
+  the imported modules, which is usually memory-mapped, instead of being copied into a map first. -/
+@[specialize] def forConstantsM [Monad m] (env : Environment) (f : Name → ConstantInfo → m PUnit) : m PUnit := do
+  if env.header.constIndex?.isSome then
+    for mod in env.header.moduleData do
+      for c in mod.constants do
+        f c.name c
+  env.constants.forM f
+
+/-- Fold over all constants of the environment, including lazily imported ones, see `forConstantsM`. -/
+@[specialize] def foldConstants (env : Environment) (init : σ) (f : σ → Name → ConstantInfo → σ) : σ :=
+  let init := if env.header.constIndex?.isSome then
+    env.header.moduleData.foldl (init := init) fun s mod =>
+      mod.constants.foldl (init := s) fun s c => f s c.name c
+  else
+    init
+  env.constants.fold f init
+
 /--
 Save an extra constant name that is used to populate `const2ModIdx` when we import
 .olean files. We use this feature to save in which module an auxiliary declaration
 created by the code generator has been created.
 -/
 def addExtraName (env : Environment) (name : Name) : Environment :=
-  if env.constants.contains name then
+  if env.contains name then
     env
   else
     { env with extraConstNames := env.extraConstNames.insert name }
 
-@[export lean_environment_find]
-def find? (env : Environment) (n : Name) : Option ConstantInfo :=
-  /- It is safe to use `find'` because we never overwrite imported declarations. -/
-  env.constants.find?' n
-
-def contains (env : Environment) (n : Name) : Bool :=
-  env.constants.contains n
-
 def imports (env : Environment) : Array Import :=
   env.header.imports
 
@@ -201,7 +280,18 @@ private def getTrustLevel (env : Environment) : UInt32 :=
   env.header.trustLevel
 
 def getModuleIdxFor? (env : Environment) (declName : Name) : Option ModuleIdx :=
-  env.const2ModIdx.find? declName
+  match env.const2ModIdx.find? declName, env.header.constIndex? with
+  | none, some index => findImportedConstModuleIdx? index env.header.moduleData declName
+  | idx,  _          => idx
+
+/--
+Return `true` if `declName` is a constant imported from another module. Unlike `getModuleIdxFor?`, this does not
+hold for the extra constant names of imported modules, which the current module may still declare. -/
+@[export lean_environment_is_imported_const]
+private def isImportedConst (env : Environment) (declName : Name) : Bool :=
+  env.constants.map₁.contains declName || match env.header.constIndex? with
+    | some index => (findImportedConstModuleIdx? index env.header.moduleData declName).isSome
+    | none       => false
 
 def isConstructor (env : Environment) (declName : Name) : Bool :=
   match env.find? declName with
@@ -231,6 +321,27 @@ inductive KernelException where
   | excessiveMemory
   | deepRecursion
   | interrupted
+  deriving Inhabited
+
+/-- Counters of a function of the kernel type checker, see `KernelProfile`. -/
+structure KernelProfile.Counter where
+  fn    : String
+  calls : Nat
+  /--
+  Number of cache hits for `whnfCore`, `whnf` and `inferType`, of calls resolved without reduction for
+  `isDefEqCore`, of successful reductions for `reduceRecursor` and `reduceNat`, and of steps of
+  `lazyDeltaReductionStep` that compared arguments instead of unfolding definitions. -/
+  hits  : Nat
+  deriving Inhabited, Repr
+
+/-- Counters collected by the kernel while type checking a declaration, see `Environment.addDeclWithProfile`. -/
+structure KernelProfile where
+  counters : Array KernelProfile.Counter
+  /-- Number of times each constant was delta-unfolded. -/
+  unfolded : Array (Name × Nat)
+  /-- Time spent type checking the declaration, in nanoseconds. -/
+  nanos    : Nat
+  deriving Inhabited
 
 namespace Environment
 
@@ -238,6 +349,20 @@ namespace Environment
 @[extern "lean_add_decl"]
 opaque addDecl (env : Environment) (decl : @& Declaration) : Except KernelException Environment
 
+/-- Like `addDecl`, but also return counters of the kernel functions used to type check the declaration. -/
+@[extern "lean_add_decl_with_profile"]
+opaque addDeclWithProfile (env : Environment) (decl : @& Declaration) : Except KernelException Environment × KernelProfile
+
+/--
+Type check the header of the theorem `decl` and add it to the environment without checking its value.
+The value must be checked using `checkTheoremValue` on the original environment. -/
+@[extern "lean_add_theorem_header"]
+opaque addTheoremHeader (env : Environment) (decl : @& Declaration) : Except KernelException Environment
+
+/-- Type check the value of the theorem `decl` against its type. The environment must not contain `decl`. -/
+@[extern "lean_check_theorem_value"]
+opaque checkTheoremValue (env : Environment) (decl : @& Declaration) : Except KernelException Unit
+
 end Environment
 
 namespace ConstantInfo
@@ -383,6 +508,82 @@ end EnvExtension
 def registerEnvExtension {σ : Type} (mkInitial : IO σ) : IO (EnvExtension σ) := EnvExtensionInterfaceImp.registerExt mkInitial
 private def mkInitialExtensionStates : IO (Array EnvExtensionState) := EnvExtensionInterfaceImp.mkInitialExtStates
 
+/-- A kernel check of a theorem value running in a separate task, see `Environment.addDeclAsync`. -/
+structure PendingKernelCheck where
+  declName : Name
+  task     : Task (Except KernelException Unit)
+
+instance : Inhabited PendingKernelCheck := ⟨{ declName := default, task := .pure (.ok ()) }⟩
+
+/-- The kernel checks started by `Environment.addDeclAsync`. -/
+structure KernelChecks where
+  /-- Checks that have not been joined yet, most recent first. -/
+  pending : List PendingKernelCheck := []
+  /-- Theorems whose checks failed when they were joined. They are still in the environment, which must not be written. -/
+  failed  : List Name := []
+  deriving Inhabited
+
+builtin_initialize kernelChecksExt : EnvExtension KernelChecks ← registerEnvExtension (pure {})
+
+/--
+Kernel type inference and reduction results shared by the type checkers of all declarations added to an imported
+environment, see `kernel.sharedCacheSize`. -/
+opaque KernelCachePointed : NonemptyType
+
+def KernelCache : Type := KernelCachePointed.type
+
+instance : Nonempty KernelCache := KernelCachePointed.property
+
+/-- Create a cache with at most `capacity` entries, evicting the least recently used ones. -/
+@[extern "lean_kernel_cache_mk"]
+opaque KernelCache.new (capacity : @& Nat) : IO KernelCache
+
+/-- Return the number of cache hits and misses for each kind of cached result. -/
+@[extern "lean_kernel_cache_stats"]
+opaque KernelCache.stats (cache : @& KernelCache) : IO (Array (String × Nat × Nat))
+
+builtin_initialize kernelCacheExt : EnvExtension (Option KernelCache) ← registerEnvExtension (pure none)
+
+@[export lean_environment_kernel_cache]
+private def getKernelCache? (env : Environment) : Option KernelCache :=
+  kernelCacheExt.getState env
+
+namespace Environment
+
+/--
+Like `addDecl`, but the value of a theorem is type checked in a separate task, and the theorem is added as soon as
+its header has been checked. Failures are reported by `joinKernelChecks`, which `writeModule` uses.
+Other kinds of declarations are checked synchronously. -/
+def addDeclAsync (env : Environment) (decl : Declaration) : Except KernelException Environment := do
+  match decl with
+  | .thmDecl val =>
+    let env' ← env.addTheoremHeader decl
+    let task := Task.spawn fun _ => env.checkTheoremValue decl
+    return kernelChecksExt.modifyState env' fun s => { s with pending := { declName := val.name, task } :: s.pending }
+  | _ => env.addDecl decl
+
+/-- Return `true` if there are kernel checks started by `addDeclAsync` that have not been joined yet. -/
+def hasPendingKernelChecks (env : Environment) : Bool :=
+  !(kernelChecksExt.getState env).pending.isEmpty
+
+/-- Return the theorems whose kernel checks failed when they were joined, in declaration order. -/
+def kernelCheckFailures (env : Environment) : List Name :=
+  (kernelChecksExt.getState env).failed
+
+/--
+Wait for all kernel checks started by `addDeclAsync`. Return the environment without pending checks, and the checks
+that failed since the last join, in declaration order. The failed theorems stay in the environment, but they are
+recorded in `kernelCheckFailures`, so `writeModule` refuses to write it. -/
+def joinKernelChecks (env : Environment) : Environment × List (Name × KernelException) :=
+  let s := kernelChecksExt.getState env
+  let failures := s.pending.foldl (init := []) fun failures c =>
+    match c.task.get with
+    | .ok _    => failures
+    | .error e => (c.declName, e) :: failures
+  (kernelChecksExt.setState env { pending := [], failed := s.failed ++ failures.map (·.1) }, failures)
+
+end Environment
+
 @[export lean_mk_empty_environment]
 def mkEmptyEnvironment (trustLevel : UInt32 := 0) : IO Environment := do
   let initializing ← IO.initializing
@@ -429,6 +630,10 @@ structure PersistentEnvExtension (α : Type) (β : Type) (σ : Type) where
   addEntryFn      : σ → β → σ
   exportEntriesFn : σ → Array α
   statsFn         : σ → Format
+  /--
+  If set, `addImportedFn` is `pure ∘ pureAddImportedFn?`, i.e., it depends neither on the environment nor on global
+  state. The imported states of these extensions are computed in parallel. -/
+  pureAddImportedFn? : Option (Array (Array α) → σ) := none
 
 instance {α σ} [Inhabited σ] : Inhabited (PersistentEnvExtensionState α σ) :=
   ⟨{importedEntries := #[], state := default }⟩
@@ -476,6 +681,8 @@ structure PersistentEnvExtensionDescr (α β σ : Type) where
   addEntryFn      : σ → β → σ
   exportEntriesFn : σ → Array α
   statsFn         : σ → Format := fun _ => Format.nil
+  /-- See `PersistentEnvExtension.pureAddImportedFn?`. -/
+  pureAddImportedFn? : Option (Array (Array α) → σ) := none
 
 unsafe def registerPersistentEnvExtensionUnsafe {α β σ : Type} [Inhabited σ] (descr : PersistentEnvExtensionDescr α β σ) : IO (PersistentEnvExtension α β σ) := do
   let pExts ← persistentEnvExtensionsRef.get
@@ -493,7 +700,8 @@ unsafe def registerPersistentEnvExtensionUnsafe {α β σ : Type} [Inhabited σ]
     addImportedFn   := descr.addImportedFn,
     addEntryFn      := descr.addEntryFn,
     exportEntriesFn := descr.exportEntriesFn,
-    statsFn         := descr.statsFn
+    statsFn         := descr.statsFn,
+    pureAddImportedFn? := descr.pureAddImportedFn?
   }
   persistentEnvExtensionsRef.modify fun pExts => pExts.push (unsafeCast pExt)
   return pExt
@@ -521,7 +729,8 @@ def registerSimplePersistentEnvExtension {α σ : Type} [Inhabited σ] (descr :
     addEntryFn      := fun s e => match s with
       | (entries, s) => (e::entries, descr.addEntryFn s e),
     exportEntriesFn := fun s => descr.toArrayFn s.1.reverse,
-    statsFn := fun s => format "number of local entries: " ++ format s.1.length
+    statsFn := fun s => format "number of local entries: " ++ format s.1.length,
+    pureAddImportedFn? := some fun as => ([], descr.addImportedFn as)
   }
 
 namespace SimplePersistentEnvExtension
@@ -615,16 +824,40 @@ def contains [Inhabited α] (ext : MapDeclarationExtension α) (env : Environmen
 
 end MapDeclarationExtension
 
+/--
+  Save `data` as an `.olean` file. If `compress` is true, the file is compressed in blocks, which are decompressed and
+  relocated when reading it instead of mapping it into memory, see `compressOLean`.
+  Large modules are compacted using up to `numTasks` tasks, or one per hardware thread if it is `0`; `numTasks := 1`
+  compacts them sequentially. The file does not depend on `numTasks`. -/
 @[extern "lean_save_module_data"]
-opaque saveModuleData (fname : @& System.FilePath) (mod : @& Name) (data : @& ModuleData) : IO Unit
+opaque saveModuleData (fname : @& System.FilePath) (mod : @& Name) (data : @& ModuleData) (compress := false)
+    (numTasks : UInt32 := 0) : IO Unit
 @[extern "lean_read_module_data"]
 opaque readModuleData (fname : @& System.FilePath) : IO (ModuleData × CompactedRegion)
 
+/--
+  Return the 128-bit content hash that `saveModuleData` stores in the header of an `.olean` file, reading only the
+  header. Returns `none` for files written by older versions of Lean, which do not contain a hash. -/
+@[extern "lean_read_module_data_hash"]
+opaque readModuleDataHash? (fname : @& System.FilePath) : IO (Option (UInt64 × UInt64))
+
+/-- Import images being written in the background, see `importImageDir` and `waitImportImageWrites`. -/
+private builtin_initialize importImageWritesRef : IO.Ref (Array (Task (Except IO.Error Unit))) ← IO.mkRef #[]
+
+/--
+  Wait until the import images that `importModules` is writing in the background (see `importImageDir`) have been
+  written. They read the imported data, so this must be done before freeing it, and before exiting the process so
+  that the images are not lost. -/
+def waitImportImageWrites : BaseIO Unit := do
+  for t in (← importImageWritesRef.swap #[]) do
+    discard <| IO.wait t
+
 /--
   Free compacted regions of imports. No live references to imported objects may exist at the time of invocation; in
   particular, `env` should be the last reference to any `Environment` derived from these imports. -/
 @[noinline, export lean_environment_free_regions]
-unsafe def Environment.freeRegions (env : Environment) : IO Unit :=
+unsafe def Environment.freeRegions (env : Environment) : IO Unit := do
+  waitImportImageWrites
   /-
     NOTE: This assumes `env` is not inferred as a borrowed parameter, and is freed after extracting the `header` field.
     Otherwise, we would encounter undefined behavior when the constant map in `env`, which may reference objects in
@@ -652,12 +885,17 @@ def mkModuleData (env : Environment) : IO ModuleData := do
   return {
     imports         := env.header.imports
     extraConstNames := env.extraConstNames.toArray
+    constIndex      := mkConstIndex constNames
     constNames, constants, entries
   }
 
 @[export lean_write_module]
-def writeModule (env : Environment) (fname : System.FilePath) : IO Unit := do
-  saveModuleData fname env.mainModule (← mkModuleData env)
+def writeModule (env : Environment) (fname : System.FilePath) (compress := false) : IO Unit := do
+  let (env, _) := env.joinKernelChecks
+  let failed := env.kernelCheckFailures
+  unless failed.isEmpty do
+    throw <| IO.userError s!"failed to write '{fname}', (kernel) declarations failed to type check: {failed}"
+  saveModuleData fname env.mainModule (← mkModuleData env) compress
 
 /--
 Construct a mapping from persistent extension name to entension index at the array of persistent extensions.
@@ -702,9 +940,16 @@ private def setImportedEntries (env : Environment) (mods : Array ModuleData) (st
 @[extern 1 "lean_get_num_attributes"] opaque getNumBuiltinAttributes : IO Nat
 
 private partial def finalizePersistentExtensions (env : Environment) (mods : Array ModuleData) (opts : Options) : IO Environment := do
-  loop 0 env
+  -- Start computing the states of the extensions that do not depend on the environment in parallel
+  let tasks := if (← IO.getNumTaskWorkers) ≤ 1 then #[] else
+    (← persistentEnvExtensionsRef.get).map fun extDescr =>
+      extDescr.pureAddImportedFn?.map fun addImportedFn =>
+        -- do not capture `env` in the task, it would be marked as multi-threaded
+        let entries := (extDescr.toEnvExtension.getState env).importedEntries
+        Task.spawn fun _ => addImportedFn entries
+  loop tasks 0 env
 where
-  loop (i : Nat) (env : Environment) : IO Environment := do
+  loop (tasks : Array (Option (Task EnvExtensionState))) (i : Nat) (env : Environment) : IO Environment := do
     -- Recall that the size of the array stored `persistentEnvExtensionRef` may increase when we import user-defined environment extensions.
     let pExtDescrs ← persistentEnvExtensionsRef.get
     if i < pExtDescrs.size then
@@ -712,7 +957,9 @@ where
       let s := extDescr.toEnvExtension.getState env
       let prevSize := (← persistentEnvExtensionsRef.get).size
       let prevAttrSize ← getNumBuiltinAttributes
-      let newState ← extDescr.addImportedFn s.importedEntries { env := env, opts := opts }
+      let newState ← match tasks[i]? with
+        | some (some task) => pure task.get
+        | _                => extDescr.addImportedFn s.importedEntries { env := env, opts := opts }
       let mut env := extDescr.toEnvExtension.setState env { s with state := newState }
       env ← ensureExtensionsArraySize env
       if (← persistentEnvExtensionsRef.get).size > prevSize || (← getNumBuiltinAttributes) > prevAttrSize then
@@ -722,7 +969,7 @@ where
         env ← setImportedEntries env mods prevSize
         -- See comment at `updateEnvAttributesRef`
         env ← updateEnvAttributes env
-      loop (i + 1) env
+      loop tasks (i + 1) env
     else
       return env
 
@@ -742,23 +989,64 @@ abbrev ImportStateM := StateRefT ImportState IO
 @[inline] nonrec def ImportStateM.run (x : ImportStateM α) (s : ImportState := {}) : IO (α × ImportState) :=
   x.run s
 
-partial def importModulesCore (imports : Array Import) : ImportStateM Unit := do
-  for i in imports do
-    if i.runtimeOnly || (← get).moduleNameSet.contains i.module then
-      continue
-    modify fun s => { s with moduleNameSet := s.moduleNameSet.insert i.module }
-    let mFile ← findOLean i.module
-    unless (← mFile.pathExists) do
-      throw <| IO.userError s!"object file '{mFile}' of module {i.module} does not exist"
-    let (mod, region) ← readModuleData mFile
-    importModulesCore mod.imports
-    modify fun s => { s with
-      moduleData  := s.moduleData.push mod
-      regions     := s.regions.push region
-      moduleNames := s.moduleNames.push i.module
-    }
+private def findModuleOLean (module : Name) : IO System.FilePath := do
+  let mFile ← findOLean module
+  unless (← mFile.pathExists) do
+    throw <| IO.userError s!"object file '{mFile}' of module {module} does not exist"
+  return mFile
 
-def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0) : IO Environment := do
+/--
+Reads the `.olean` files of `imports` and of all their transitive imports that are not in `moduleNameSet` yet.
+The import graph is discovered level by level, and the files of each level are read and relocated in parallel tasks.
+-/
+private partial def readModulesParallel (imports : Array Import) (moduleNameSet : NameHashSet) :
+    IO (HashMap Name (ModuleData × CompactedRegion)) :=
+  go imports moduleNameSet {}
+where
+  go (imports : Array Import) (seen : NameHashSet) (loaded : HashMap Name (ModuleData × CompactedRegion)) := do
+    let mut seen := seen
+    let mut tasks := #[]
+    for i in imports do
+      if i.runtimeOnly || seen.contains i.module then
+        continue
+      seen := seen.insert i.module
+      let mFile ← findModuleOLean i.module
+      tasks := tasks.push (i.module, ← IO.asTask (readModuleData mFile))
+    if tasks.isEmpty then
+      return loaded
+    let mut loaded := loaded
+    let mut next := #[]
+    for (module, task) in tasks do
+      let (mod, region) ← IO.ofExcept (← IO.wait task)
+      loaded := loaded.insert module (mod, region)
+      next := next ++ mod.imports
+    go next seen loaded
+
+/--
+Imports `imports` and their transitive imports into the state. The `.olean` files are read in parallel first, and then
+the modules are added in depth-first post-order, so the resulting order of `moduleNames`, `moduleData`, and `regions`
+does not depend on the scheduling of the reads.
+-/
+partial def importModulesCore (imports : Array Import) : ImportStateM Unit := do
+  let loaded ← readModulesParallel imports (← get).moduleNameSet
+  go loaded imports
+where
+  go (loaded : HashMap Name (ModuleData × CompactedRegion)) (imports : Array Import) : ImportStateM Unit := do
+    for i in imports do
+      if i.runtimeOnly || (← get).moduleNameSet.contains i.module then
+        continue
+      modify fun s => { s with moduleNameSet := s.moduleNameSet.insert i.module }
+      let (mod, region) ← match loaded.find? i.module with
+        | some r => pure r
+        | none   => readModuleData (← findModuleOLean i.module)
+      go loaded mod.imports
+      modify fun s => { s with
+        moduleData  := s.moduleData.push mod
+        regions     := s.regions.push region
+        moduleNames := s.moduleNames.push i.module
+      }
+
+private def mkConstMaps (s : ImportState) : IO (HashMap Name ModuleIdx × HashMap Name ConstantInfo) := do
   let numConsts := s.moduleData.foldl (init := 0) fun numConsts mod =>
     numConsts + mod.constants.size + mod.extraConstNames.size
   let mut const2ModIdx : HashMap Name ModuleIdx := mkHashMap (capacity := numConsts)
@@ -774,6 +1062,29 @@ def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (
       const2ModIdx := const2ModIdx.insert cname modIdx
     for cname in mod.extraConstNames do
       const2ModIdx := const2ModIdx.insert cname modIdx
+  return (const2ModIdx, constantMap)
+
+/--
+Like `mkConstMaps`, but only the extra constant names are inserted in `const2ModIdx`. The imported constants
+are found on demand using the merged constant index of the modules, which is returned as well.
+-/
+private def mkLazyConstMaps (s : ImportState) : IO (HashMap Name ModuleIdx × ByteArray) := do
+  let index ← match mkImportedConstIndex s.moduleData with
+    | .ok index => pure index
+    | .error (modIdx, i) =>
+      let cname := s.moduleData[modIdx]!.constNames[i]!
+      let prevModIdx := s.moduleData.findIdx? (·.constNames.contains cname) |>.get!
+      throw <| IO.userError s!"import {s.moduleNames[modIdx]!} failed, environment already contains '{cname}' from {s.moduleNames[prevModIdx]!}"
+  let numExtraConsts := s.moduleData.foldl (init := 0) fun n mod => n + mod.extraConstNames.size
+  let mut const2ModIdx : HashMap Name ModuleIdx := mkHashMap (capacity := numExtraConsts)
+  for h:modIdx in [0:s.moduleData.size] do
+    for cname in (s.moduleData[modIdx]'h.upper).extraConstNames do
+      const2ModIdx := const2ModIdx.insert cname modIdx
+  return (const2ModIdx, index)
+
+private def mkImportedEnvironment (s : ImportState) (imports : Array Import) (opts : Options) (trustLevel : UInt32)
+    (const2ModIdx : HashMap Name ModuleIdx) (constantMap : HashMap Name ConstantInfo) (constIndex? : Option ByteArray) :
+    IO Environment := do
   let constants : ConstMap := SMap.fromHashMap constantMap false
   let exts ← mkInitialExtensionStates
   let env : Environment := {
@@ -788,11 +1099,156 @@ def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (
       regions      := s.regions
       moduleNames  := s.moduleNames
       moduleData   := s.moduleData
+      constIndex?  := constIndex?
     }
   }
   let env ← setImportedEntries env s.moduleData
   let env ← finalizePersistentExtensions env s.moduleData opts
-  pure env
+  let cacheSize := kernel.sharedCacheSize.get opts
+  if cacheSize == 0 then
+    return env
+  else
+    return kernelCacheExt.setState env (some (← KernelCache.new cacheSize))
+
+def finalizeImport (s : ImportState) (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0) : IO Environment := do
+  if lazyImport.get opts then
+    let (const2ModIdx, index) ← mkLazyConstMaps s
+    mkImportedEnvironment s imports opts trustLevel const2ModIdx {} (some index)
+  else
+    let (const2ModIdx, constantMap) ← mkConstMaps s
+    mkImportedEnvironment s imports opts trustLevel const2ModIdx constantMap none
+
+/--
+  The linked imports of a module header: the data of all imported modules together with the constant maps
+  built from them, saved as a single compacted object so that files with the same header can load it with one
+  `mmap` instead of reading and linking each `.olean` file, see `importImageDir`. Extension states are not part
+  of the image as they may contain closures, which cannot be compacted; they are recomputed from `moduleData`. -/
+structure ImportImage where
+  githash      : String
+  imports      : Array Import
+  /-- `.olean` file and modification time of each module in `moduleNames`, used to validate the image. -/
+  oleans       : Array (String × IO.FS.SystemTime)
+  moduleNames  : Array Name
+  moduleData   : Array ModuleData
+  const2ModIdx : HashMap Name ModuleIdx
+  constants    : HashMap Name ConstantInfo
+
+/-- Like `saveModuleData`, but the file starts with a different header, so that it is never read as an `.olean` file. -/
+@[extern "lean_save_import_image"]
+private opaque saveImportImageCore (fname : @& System.FilePath) (key : @& Name) (img : @& ImportImage) : IO Unit
+/-- Like `readModuleData`, but fails unless the file was written by `saveImportImageCore`. -/
+@[extern "lean_read_import_image"]
+private opaque readImportImageCore (fname : @& System.FilePath) : IO (ImportImage × CompactedRegion)
+
+/-- Header of the files written by `saveImportImageCore`, see `g_import_image_header` in `module.cpp`. -/
+private def importImageHeader : ByteArray := "leanimage!!!!!#!".toUTF8
+
+/-- Return `true` if `fname` starts with the header of import images. -/
+private def isImportImage (fname : System.FilePath) : IO Bool := do
+  let h ← IO.FS.Handle.mk fname .read
+  return (← h.read importImageHeader.size.toUSize).data == importImageHeader.data
+
+/--
+  Image file of `imports` in `dir`. Its name is also used to derive the base address of the image.
+  Images use their own extension, so that they cannot be confused with `.olean` files in the same directory. -/
+def importImageFile (dir : System.FilePath) (imports : Array Import) : Name × System.FilePath :=
+  let key := String.mk <| Nat.toDigits 16 (hash imports).toNat
+  (.str .anonymous s!"importImage{key}", dir / s!"{key}.limg")
+
+private def getOLeanStamps (moduleNames : Array Name) : IO (Array (String × IO.FS.SystemTime)) :=
+  moduleNames.mapM fun mod => do
+    let fname ← findOLean mod
+    return (fname.toString, (← fname.metadata).modified)
+
+/--
+  Delete the images in `dir` written least recently, except `keep`, until their total size is at most `maxSize`
+  bytes. Only files with the extension and header of images are considered, other files in `dir` are never deleted.
+  Images that cannot be deleted, e.g. because they are in use on Windows, are skipped. -/
+private def evictImportImages (dir : System.FilePath) (maxSize : Nat) (keep : System.FilePath) : IO Unit := do
+  let mut images := #[]
+  for entry in (← dir.readDir) do
+    if entry.path.extension == some "limg" then
+      -- images may be deleted by other processes at any time
+      try
+        if ← isImportImage entry.path then
+          let md ← entry.path.metadata
+          images := images.push (entry.path, md.byteSize.toNat, md.modified)
+      catch _ =>
+        pure ()
+  let mut size := images.foldl (· + ·.2.1) 0
+  for (fname, fsize, _) in images.qsort (·.2.2 < ·.2.2) do
+    if size ≤ maxSize then
+      break
+    if fname != keep then
+      try
+        IO.FS.removeFile fname
+        size := size - fsize
+      catch _ =>
+        pure ()
+
+/--
+  Save the linked imports `s` of `imports` in `dir`, then delete old images if the images in `dir` take more than
+  `maxSize` bytes (unless `maxSize` is `0`). Errors are ignored, as the image is merely a cache.
+  The image is written to a temporary file first so that concurrent processes never see a partial image. -/
+def saveImportImage (dir : System.FilePath) (imports : Array Import) (s : ImportState)
+    (const2ModIdx : HashMap Name ModuleIdx) (constants : HashMap Name ConstantInfo) (maxSize := 0) : IO Unit := do
+  let (key, fname) := importImageFile dir imports
+  try
+    let img : ImportImage := {
+      githash, imports, const2ModIdx, constants
+      oleans      := (← getOLeanStamps s.moduleNames)
+      moduleNames := s.moduleNames
+      moduleData  := s.moduleData
+    }
+    IO.FS.createDirAll dir
+    let tmp := fname.withExtension s!"{← IO.Process.getPID}.tmp"
+    saveImportImageCore tmp key img
+    IO.FS.rename tmp fname
+    if maxSize > 0 then
+      evictImportImages dir maxSize fname
+  catch _ =>
+    pure ()
+
+private unsafe def readImportImageImp (dir : System.FilePath) (imports : Array Import) :
+    IO (Option (ImportImage × CompactedRegion)) := do
+  let (_, fname) := importImageFile dir imports
+  unless (← fname.pathExists) do
+    return none
+  let some (img, region) ← (try some <$> readImportImageCore fname catch _ => pure none)
+    | return none
+  let valid ← try
+      pure (img.githash == githash && img.imports == imports &&
+        (← getOLeanStamps img.moduleNames) == img.oleans)
+    catch _ => pure false
+  if valid then
+    return some (img, region)
+  else
+    region.free
+    return none
+
+/--
+  Read the image of `imports` in `dir` if it exists and is still valid, i.e. it was created by the same Lean
+  version from the same `.olean` files as would be imported now. -/
+@[implemented_by readImportImageImp]
+opaque readImportImage (dir : System.FilePath) (imports : Array Import) : IO (Option (ImportImage × CompactedRegion))
+
+private def importModulesUsingImage (dir : System.FilePath) (imports : Array Import) (opts : Options)
+    (trustLevel : UInt32) : IO Environment := do
+  if let some (img, region) ← readImportImage dir imports then
+    let s : ImportState := {
+      moduleNames := img.moduleNames
+      moduleData  := img.moduleData
+      regions     := #[region]
+    }
+    mkImportedEnvironment s imports opts trustLevel img.const2ModIdx img.constants none
+  else
+    let (_, s) ← importModulesCore imports |>.run
+    let (const2ModIdx, constantMap) ← mkConstMaps s
+    -- Writing the image takes much longer than importing, and it is only used by later imports
+    let maxSize := importImageDirMaxSize.get opts * 1024 * 1024
+    let t ← IO.asTask (prio := .dedicated) <| saveImportImage dir imports s const2ModIdx constantMap maxSize
+    importImageWritesRef.modify (·.push t)
+    mkImportedEnvironment s imports opts trustLevel const2ModIdx constantMap none
 
 @[export lean_import_modules]
 def importModules (imports : Array Import) (opts : Options) (trustLevel : UInt32 := 0) : IO Environment := profileitIO "import" opts do
@@ -800,8 +1256,12 @@ def importModules (imports : Array Import) (opts : Options) (trustLevel : UInt32
     if imp.module matches .anonymous then
       throw <| IO.userError "import failed, trying to import module with anonymous name"
   withImporting do
-    let (_, s) ← importModulesCore imports |>.run
-    finalizeImport s imports opts trustLevel
+    let dir := importImageDir.get opts
+    if !dir.isEmpty && !lazyImport.get opts then
+      importModulesUsingImage dir imports opts trustLevel
+    else
+      let (_, s) ← importModulesCore imports |>.run
+      finalizeImport s imports opts trustLevel
 
 /--
   Create environment object from imports and free compacted regions after calling `act`. No live references to the
@@ -868,6 +1328,9 @@ def displayStats (env : Environment) : IO Unit := do
   IO.println ("number of buckets for imported consts: " ++ toString env.constants.numBuckets);
   IO.println ("trust level:                           " ++ toString env.header.trustLevel);
   IO.println ("number of extensions:                  " ++ toString env.extensions.size);
+  if let some cache := kernelCacheExt.getState env then
+    for (kind, hits, misses) in (← cache.stats) do
+      IO.println s!"kernel cache '{kind}': {hits} hits, {misses} misses ({hits * 100 / max 1 (hits + misses)}% hit rate)"
   pExtDescrs.forM fun extDescr => do
     IO.println ("extension '" ++ toString extDescr.name ++ "'")
     let s := extDescr.toEnvExtension.getState env
@@ -928,6 +1391,13 @@ def isDefEqGuarded (env : Environment) (lctx : LocalContext) (a b : Expr) : Bool
 @[extern "lean_kernel_whnf"]
 opaque whnf (env : Environment) (lctx : LocalContext) (a : Expr) : Except KernelException Expr
 
+/--
+  Return an expression structurally equal to `e` whose subterms are shared with the subterms of all the expressions
+  previously returned by `hashCons`, so that the kernel can detect equal subterms by pointer equality.
+  The table of shared subterms is global, and does not keep alive subterms that are not used anymore. -/
+@[extern "lean_kernel_hash_cons"]
+opaque hashCons (e : Expr) : BaseIO Expr
+
 end Kernel
 
 class MonadEnv (m : Type → Type) where
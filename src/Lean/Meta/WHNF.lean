@@ -803,6 +803,16 @@ def reduceBinNatOp (f : Nat → Nat → Nat) (a b : Expr) : MetaM (Option Expr)
   trace[Meta.isDefEq.whnf.reduceBinOp] "{a} op {b}"
   return mkRawNatLit <| f a b
 
+/--
+Like `reduceBinNatOp`, but does not reduce if the shift amount `b` does not fit in a `UInt32`, like the kernel.
+The runtime implementations of `Nat.shiftLeft` and `Nat.shiftRight` panic on such shift amounts. -/
+def reduceNatShift (f : Nat → Nat → Nat) (a b : Expr) : MetaM (Option Expr) :=
+  withNatValue b fun b =>
+  if b ≥ UInt32.size then return none else
+  withNatValue a fun a => do
+  trace[Meta.isDefEq.whnf.reduceBinOp] "{a} op {b}"
+  return mkRawNatLit <| f a b
+
 def reduceBinNatPred (f : Nat → Nat → Bool) (a b : Expr) : MetaM (Option Expr) := do
   withNatValue a fun a =>
   withNatValue b fun b =>
@@ -815,6 +825,8 @@ def reduceNat? (e : Expr) : MetaM (Option Expr) :=
     | Expr.app (Expr.const fn _) a                =>
       if fn == ``Nat.succ then
         reduceUnaryNatOp Nat.succ a
+      else if fn == ``Nat.log2 then
+        reduceUnaryNatOp Nat.log2 a
       else
         return none
     | Expr.app (Expr.app (Expr.const fn _) a1) a2 =>
@@ -827,6 +839,11 @@ def reduceNat? (e : Expr) : MetaM (Option Expr) :=
       else if fn == ``Nat.gcd then reduceBinNatOp Nat.gcd a1 a2
       else if fn == ``Nat.beq then reduceBinNatPred Nat.beq a1 a2
       else if fn == ``Nat.ble then reduceBinNatPred Nat.ble a1 a2
+      else if fn == ``Nat.land then reduceBinNatOp Nat.land a1 a2
+      else if fn == ``Nat.lor then reduceBinNatOp Nat.lor a1 a2
+      else if fn == ``Nat.xor then reduceBinNatOp Nat.xor a1 a2
+      else if fn == ``Nat.shiftLeft then reduceNatShift Nat.shiftLeft a1 a2
+      else if fn == ``Nat.shiftRight then reduceNatShift Nat.shiftRight a1 a2
       else return none
     | _ =>
       return none
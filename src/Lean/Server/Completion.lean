@@ -244,7 +244,7 @@ private def idCompletionCore (ctx : ContextInfo) (id : Name) (hoverInfo : HoverI
         addCompletionItem localDecl.userName localDecl.type expectedType? none (kind := CompletionItemKind.variable) score
   -- search for matches in the environment
   let env ← getEnv
-  env.constants.forM fun declName c => do
+  env.forConstantsM fun declName c => do
     unless (← isBlackListed declName) do
       let matchUsingNamespace (ns : Name): M Bool := do
         if let some (label, score) ← matchDecl? ns id danglingDot declName then
@@ -365,7 +365,7 @@ private def dotCompletion (ctx : ContextInfo) (info : TermInfo) (hoverInfo : Hov
       else
         failure
     else
-      (← getEnv).constants.forM fun declName c => do
+      (← getEnv).forConstantsM fun declName c => do
         let some declName ← normPrivateName? declName
           | return
         let typeName := declName.getPrefix
@@ -379,7 +379,7 @@ private def dotIdCompletion (ctx : ContextInfo) (lctx : LocalContext) (id : Name
     let some expectedType := expectedType? | return ()
     let resultTypeFn := (← instantiateMVars expectedType).cleanupAnnotations.getAppFn
     let .const typeName .. := resultTypeFn.cleanupAnnotations | return ()
-    (← getEnv).constants.forM fun declName c => do
+    (← getEnv).forConstantsM fun declName c => do
       let some (label, score) ← matchDecl? typeName id (danglingDot := false) declName | pure ()
       addCompletionItem label c.type expectedType? declName (← getCompletionKindForDecl c) score
 
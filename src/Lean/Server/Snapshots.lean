@@ -123,7 +123,7 @@ def compileNextCmd (inputCtx : Parser.InputContext) (snap : Snapshot) (hasWidget
   }
   let (output, _) ← IO.FS.withIsolatedStreams (isolateStderr := server.stderrAsMessages.get scope.opts) <| liftM (m := BaseIO) do
     Elab.Command.catchExceptions
-      (getResetInfoTrees *> Elab.Command.elabCommandTopLevel cmdStx)
+      (getResetInfoTrees *> Elab.Command.elabCommandTopLevel cmdStx *> joinKernelChecksAtEnd cmdStx)
       cmdCtx cmdStateRef
   let postNew := (← tacticCacheNew.get).post
   snap.tacticCache.modify fun _ => { pre := postNew, post := {} }
@@ -149,6 +149,12 @@ def compileNextCmd (inputCtx : Parser.InputContext) (snap : Snapshot) (hasWidget
   return postCmdSnap
 
 where
+  /-- Report the failures of kernel checks started with `kernel.async` at the end of the file, like
+  `Frontend.processCommands`. -/
+  joinKernelChecksAtEnd (cmdStx : Syntax) : Elab.Command.CommandElabM Unit := do
+    if Parser.isTerminalCommand cmdStx then
+      withRef cmdStx <| Elab.Command.liftCoreM joinKernelChecks
+
   /-- Compute the current interactive diagnostics log by finding a "diff" relative to the parent
   snapshot. We need to do this because unlike the `MessageLog` itself, interactive diags are not
   part of the command state. -/
@@ -214,7 +214,8 @@ typedef struct {
 /* Object of type `Task _`. The lifetime of a `lean_task` object can be represented as a state machine with atomic
    state transitions.
 
-   In the following, `condition` describes a predicate uniquely identifying a state.
+   In the following, `condition` describes a predicate uniquely identifying a state. All transitions are performed
+   while holding the lock of the task, which the task manager assigns to the task by hashing its address.
 
    creation:
    * Task.spawn ==> Queued
@@ -224,28 +225,28 @@ typedef struct {
 
    states:
    * Queued
-     * condition: in task_manager::m_queues && m_imp != nullptr && !m_imp->m_deleted
+     * condition: in a task_manager queue && m_imp != nullptr && !m_imp->m_deleted
      * invariant: m_value == nullptr
      * transition: RC becomes 0 ==> Deactivated (`deactivate_task` lock)
-     * transition: dequeued by worker thread            ==> Running     (`spawn_worker` lock)
+     * transition: dequeued by worker thread            ==> Running     (`run_task` lock)
    * Waiting
      * condition: reachable from task via `m_head_dep->m_next_dep->...` && !m_imp->m_deleted
      * invariant: m_imp != nullptr && m_value == nullptr
      * invariant: task dependency is Queued/Waiting/Running
        * It cannot become Deactivated because this task should be holding an owned reference to it
      * transition: RC becomes 0 ==> Deactivated (`deactivate_task` lock)
-     * transition: task dependency Finished ==> Queued (`handle_finished` under `spawn_worker` lock)
+     * transition: task dependency Finished ==> Queued (`handle_finished` lock)
    * Promised
      * condition: obtained as result from promise
      * invariant: m_imp != nullptr && m_value == nullptr
-     * transition: promise resolved ==> Finished (`resolve_core` under `spawn_worker` lock)
+     * transition: promise resolved ==> Finished (`resolve` lock)
      * transition: RC becomes 0 ==> Deactivated (`deactivate_task` lock)
    * Running
      * condition: m_imp != nullptr && m_imp->m_closure == nullptr
        * The worker takes ownership of the closure when running it
      * invariant: m_value == nullptr
      * transition: RC becomes 0 ==> Deactivated (`deactivate_task` lock)
-     * transition: finished execution                   ==> Finished    (`spawn_worker` lock)
+     * transition: finished execution                   ==> Finished    (`run_task` lock)
    * Deactivated
      * condition: m_imp != nullptr && m_imp->m_deleted
      * invariant: RC == 0
@@ -314,6 +315,37 @@ LEAN_SHARED void * lean_alloc_small(unsigned sz, unsigned slot_idx);
 LEAN_SHARED void lean_free_small(void * p);
 LEAN_SHARED unsigned lean_small_mem_size(void * p);
 LEAN_SHARED void lean_inc_heartbeat(void);
+/* Return the memory of free pages and unused segments of the small object allocator to the OS.
+   Heaps owned by other threads release their free memory the next time they need a new page. */
+LEAN_SHARED void lean_release_free_memory(void);
+/* Set the number of small and medium allocations after which the free memory of a thread heap is automatically
+   returned to the OS. The initial value can be set using the environment variable
+   `LEAN_RELEASE_FREE_MEMORY_THRESHOLD`. The value `0` disables the automatic release. */
+LEAN_SHARED void lean_set_release_free_memory_threshold(uint64_t n);
+/* Return the number of allocator segments backed by `MAP_HUGETLB` pages, the number of segments marked for
+   transparent huge pages, and the number of segments where huge pages were requested but are not available.
+   Huge pages are requested by setting the environment variable `LEAN_HUGE_PAGES` to `thp` or `hugetlb`. */
+LEAN_SHARED void lean_get_huge_page_stats(uint64_t * num_hugetlb, uint64_t * num_thp, uint64_t * num_fallbacks);
+
+/* Allocator statistics aggregated over all threads, see `lean_get_alloc_stats`. */
+typedef struct {
+    uint64_t m_num_alloc;        /* number of allocated objects */
+    uint64_t m_num_dealloc;      /* number of deallocated objects */
+    uint64_t m_live_bytes;       /* number of bytes used by objects that have not been deallocated */
+    uint64_t m_num_segments;     /* number of segments obtained from the OS and not released yet */
+    uint64_t m_num_pages;        /* number of pages in use, in units of 8 Kb */
+    uint64_t m_num_remote_frees; /* number of objects deallocated by a thread different from the one that allocated them */
+} lean_alloc_stats;
+
+/* Return the number of size classes of the allocator. */
+LEAN_SHARED unsigned lean_get_alloc_num_slots(void);
+/* Return the size in bytes of the objects in the given size class. */
+LEAN_SHARED unsigned lean_get_alloc_slot_size(unsigned slot_idx);
+/* Store allocator statistics in `s`. If `slot_num_alloc` and `slot_num_dealloc` are not null, they must point to
+   arrays of size `lean_get_alloc_num_slots()`, and the number of allocations and deallocations of each size class is stored there.
+   The counters are always enabled, and are maintained per thread without synchronization. Thus, the values
+   for threads that are running concurrently with this function may be slightly out of date. */
+LEAN_SHARED void lean_get_alloc_stats(lean_alloc_stats * s, uint64_t * slot_num_alloc, uint64_t * slot_num_dealloc);
 
 #ifndef __cplusplus
 void * malloc(size_t);  // avoid including big `stdlib.h`
@@ -1113,6 +1145,8 @@ LEAN_SHARED bool lean_io_check_canceled_core(void);
 LEAN_SHARED void lean_io_cancel_core(b_lean_obj_arg t);
 /* primitive for implementing `IO.hasFinished : Task a -> IO Unit` */
 LEAN_SHARED bool lean_io_has_finished_core(b_lean_obj_arg t);
+/* primitive for implementing `IO.getNumTaskWorkers : IO Nat` */
+LEAN_SHARED unsigned lean_io_get_num_task_workers_core(void);
 /* primitive for implementing `IO.waitAny : List (Task a) -> IO (Task a)` */
 LEAN_SHARED b_lean_obj_res lean_io_wait_any_core(b_lean_obj_arg task_list);
 
@@ -1879,6 +1913,8 @@ LEAN_SHARED lean_obj_res lean_st_ref_get(b_lean_obj_arg, lean_obj_arg);
 LEAN_SHARED lean_obj_res lean_st_ref_set(b_lean_obj_arg, lean_obj_arg, lean_obj_arg);
 LEAN_SHARED lean_obj_res lean_st_ref_reset(b_lean_obj_arg, lean_obj_arg);
 LEAN_SHARED lean_obj_res lean_st_ref_swap(b_lean_obj_arg, lean_obj_arg, lean_obj_arg);
+LEAN_SHARED lean_obj_res lean_st_ref_atomic_modify(b_lean_obj_arg, lean_obj_arg, lean_obj_arg);
+LEAN_SHARED lean_obj_res lean_st_ref_atomic_modify_get(b_lean_obj_arg, lean_obj_arg, lean_obj_arg);
 
 /* pointer address unsafe primitive  */
 static inline size_t lean_ptr_addr(b_lean_obj_arg a) { return (size_t)a; }
@@ -7,6 +7,7 @@ Author: Leonardo de Moura
 #include <utility>
 #include <vector>
 #include <limits>
+#include <chrono>
 #include "runtime/sstream.h"
 #include "runtime/thread.h"
 #include "util/map_foreach.h"
@@ -173,16 +174,21 @@ environment environment::add_definition(declaration const & d, bool check) const
     }
 }
 
+/* Check the value of the theorem `d` against its type. The environment `env` does not contain `d`. */
+static void check_theorem_value(environment const & env, declaration const & d, type_checker & checker) {
+    theorem_val const & v = d.to_theorem_val();
+    check_no_metavar_no_fvar(env, v.get_name(), v.get_value());
+    expr val_type = checker.check(v.get_value(), v.get_lparams());
+    if (!checker.is_def_eq(val_type, v.get_type()))
+        throw definition_type_mismatch_exception(env, d, val_type);
+}
+
 environment environment::add_theorem(declaration const & d, bool check) const {
     theorem_val const & v = d.to_theorem_val();
     if (check) {
-        // TODO(Leo): we must add support for handling tasks here
         type_checker checker(*this);
         check_constant_val(*this, v.to_constant_val(), checker);
-        check_no_metavar_no_fvar(*this, v.get_name(), v.get_value());
-        expr val_type = checker.check(v.get_value(), v.get_lparams());
-        if (!checker.is_def_eq(val_type, v.get_type()))
-            throw definition_type_mismatch_exception(*this, d, val_type);
+        check_theorem_value(*this, d, checker);
     }
     return add(constant_info(d));
 }
@@ -252,6 +258,44 @@ extern "C" LEAN_EXPORT object * lean_add_decl(object * env, object * decl) {
         });
 }
 
+/* Check only the header of the theorem `decl` and add it to `env`. The value is checked by `lean_check_theorem_value`,
+   usually in a separate task. */
+extern "C" LEAN_EXPORT object * lean_add_theorem_header(object * env, object * decl) {
+    return catch_kernel_exceptions<environment>([&]() {
+            environment new_env(env);
+            declaration d(decl, true);
+            if (!d.is_theorem())
+                throw kernel_exception(new_env, "invalid declaration, theorem expected");
+            check_constant_val(new_env, d.to_theorem_val().to_constant_val(), definition_safety::safe);
+            return new_env.add(d, false);
+        });
+}
+
+extern "C" LEAN_EXPORT object * lean_check_theorem_value(object * env, object * decl) {
+    return catch_kernel_exceptions<object_ref>([&]() {
+            environment e(env);
+            declaration d(decl, true);
+            if (!d.is_theorem())
+                throw kernel_exception(e, "invalid declaration, theorem expected");
+            type_checker checker(e);
+            check_theorem_value(e, d, checker);
+            return object_ref(box(0));
+        });
+}
+
+/* addDeclWithProfile (env : Environment) (decl : @& Declaration) : Except KernelException Environment × KernelProfile */
+extern "C" LEAN_EXPORT object * lean_add_decl_with_profile(object * env, object * decl) {
+    kernel_profile profile;
+    auto start = std::chrono::steady_clock::now();
+    object * r;
+    {
+        kernel_profile_scope scope(profile);
+        r = lean_add_decl(env, decl);
+    }
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return mk_cnstr(0, object_ref(r), to_object(profile, nanos)).steal();
+}
+
 void environment::for_each_constant(std::function<void(constant_info const & d)> const & f) const {
     smap_foreach(cnstr_get(raw(), 1), [&](object *, object * v) {
             constant_info cinfo(v, true);
@@ -0,0 +1,154 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include "runtime/thread.h"
+#include "runtime/io.h"
+#include "kernel/expr_eq_fn.h"
+#include "kernel/hash_cons.h"
+
+#ifndef LEAN_HASH_CONS_NUM_SHARDS
+#define LEAN_HASH_CONS_NUM_SHARDS 64
+#endif
+
+#ifndef LEAN_HASH_CONS_MIN_SWEEP_SIZE
+#define LEAN_HASH_CONS_MIN_SWEEP_SIZE 1024
+#endif
+
+namespace lean {
+/* Set of representatives split into shards by hash code, each one protected by its own mutex. */
+class hash_cons_table {
+    struct shard {
+        mutex                                                   m_mutex;
+        std::unordered_set<expr, expr_hash, is_bi_equal_proc>   m_set;
+        /* Number of entries at which the next sweep happens. */
+        size_t                                                  m_sweep_size = LEAN_HASH_CONS_MIN_SWEEP_SIZE;
+    };
+    shard m_shards[LEAN_HASH_CONS_NUM_SHARDS];
+
+    shard & get_shard(expr const & e) { return m_shards[hash(e) % LEAN_HASH_CONS_NUM_SHARDS]; }
+
+    /* Return true iff the table holds the only reference to `e`. Entries are marked as multi-threaded when they are
+       inserted. Entries stored in compacted regions have no reference counter and are never removed. */
+    static bool is_unused(expr const & e) {
+        return std::atomic_load_explicit(lean_get_rc_mt_addr(e.raw()), std::memory_order_acquire) == -1;
+    }
+
+    /* Remove the unused entries of `s`. Other entries only become unused when the entries using them as subterms are
+       removed, and are removed by later sweeps. */
+    static void sweep(shard & s) {
+        for (auto it = s.m_set.begin(); it != s.m_set.end();) {
+            if (is_unused(*it))
+                it = s.m_set.erase(it);
+            else
+                ++it;
+        }
+        s.m_sweep_size = std::max(static_cast<size_t>(LEAN_HASH_CONS_MIN_SWEEP_SIZE), 2 * s.m_set.size());
+    }
+public:
+    optional<expr> find(expr const & e) {
+        shard & s = get_shard(e);
+        lock_guard<mutex> lock(s.m_mutex);
+        auto it = s.m_set.find(e);
+        if (it == s.m_set.end())
+            return none_expr();
+        return some_expr(*it);
+    }
+
+    expr find_or_insert(expr const & e) {
+        shard & s = get_shard(e);
+        lock_guard<mutex> lock(s.m_mutex);
+        auto it = s.m_set.find(e);
+        if (it != s.m_set.end())
+            return *it;
+        if (s.m_set.size() >= s.m_sweep_size)
+            sweep(s);
+        /* The representatives are used by type checkers running in other threads. */
+        mark_mt(e.raw());
+        s.m_set.insert(e);
+        return e;
+    }
+};
+
+static hash_cons_table * g_hash_cons_table = nullptr;
+
+class hash_cons_fn {
+    hash_cons_table &                   m_table;
+    /* Representatives of the subterms of the input visited so far. */
+    std::unordered_map<object *, expr>  m_cache;
+
+    expr visit_children(expr const & e) {
+        switch (e.kind()) {
+        case expr_kind::BVar: case expr_kind::Lit:
+        case expr_kind::MVar: case expr_kind::FVar:
+        case expr_kind::Sort: case expr_kind::Const:
+            return e;
+        case expr_kind::MData:
+            return update_mdata(e, visit(mdata_expr(e)));
+        case expr_kind::Proj:
+            return update_proj(e, visit(proj_expr(e)));
+        case expr_kind::App: {
+            expr new_f = visit(app_fn(e));
+            expr new_a = visit(app_arg(e));
+            return update_app(e, new_f, new_a);
+        }
+        case expr_kind::Lambda: case expr_kind::Pi: {
+            expr new_d = visit(binding_domain(e));
+            expr new_b = visit(binding_body(e));
+            return update_binding(e, new_d, new_b);
+        }
+        case expr_kind::Let: {
+            expr new_t = visit(let_type(e));
+            expr new_v = visit(let_value(e));
+            expr new_b = visit(let_body(e));
+            return update_let(e, new_t, new_v, new_b);
+        }
+        }
+        lean_unreachable(); // LCOV_EXCL_LINE
+    }
+
+    expr visit(expr const & e) {
+        auto it = m_cache.find(e.raw());
+        if (it != m_cache.end())
+            return it->second;
+        expr r;
+        if (is_atomic(e)) {
+            r = m_table.find_or_insert(e);
+        } else if (optional<expr> s = m_table.find(e)) {
+            /* There is no need to visit the subterms of `e`, they are the subterms of `*s`. */
+            r = *s;
+        } else {
+            r = m_table.find_or_insert(visit_children(e));
+        }
+        m_cache.insert(mk_pair(e.raw(), r));
+        return r;
+    }
+public:
+    hash_cons_fn():m_table(*g_hash_cons_table) {}
+    expr operator()(expr const & e) { return visit(e); }
+};
+
+expr hash_cons(expr const & e) {
+    return hash_cons_fn()(e);
+}
+
+/* Kernel.hashCons (e : Expr) : BaseIO Expr */
+extern "C" LEAN_EXPORT obj_res lean_kernel_hash_cons(obj_arg e, obj_arg) {
+    return io_result_mk_ok(hash_cons(expr(e)).steal());
+}
+
+void initialize_hash_cons() {
+    g_hash_cons_table = new hash_cons_table();
+}
+
+void finalize_hash_cons() {
+    delete g_hash_cons_table;
+}
+}
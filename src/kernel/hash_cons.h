@@ -0,0 +1,23 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#pragma once
+#include "kernel/expr.h"
+
+namespace lean {
+/** \brief Return an expression structurally equal to \c e, including binder names and binder information, such that
+    all subterms that are structurally equal to a subterm of an expression previously returned by this function are
+    represented by the same object. The type checker can then detect that these subterms are equal by pointer
+    equality.
+
+    The representatives are stored in a global table that can be used from multiple threads. The table does not keep
+    them alive: an entry is removed when the table holds the only reference to it. As in the rest of the kernel, the
+    `nonDep` flag of `let`-expressions is not preserved. */
+expr hash_cons(expr const & e);
+
+void initialize_hash_cons();
+void finalize_hash_cons();
+}
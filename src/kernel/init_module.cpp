@@ -12,6 +12,8 @@ Author: Leonardo de Moura
 #include "kernel/local_ctx.h"
 #include "kernel/inductive.h"
 #include "kernel/quot.h"
+#include "kernel/kernel_cache.h"
+#include "kernel/hash_cons.h"
 
 namespace lean {
 void initialize_kernel_module() {
@@ -23,9 +25,13 @@ void initialize_kernel_module() {
     initialize_local_ctx();
     initialize_inductive();
     initialize_quot();
+    initialize_kernel_cache();
+    initialize_hash_cons();
 }
 
 void finalize_kernel_module() {
+    finalize_hash_cons();
+    finalize_kernel_cache();
     finalize_quot();
     finalize_inductive();
     finalize_local_ctx();
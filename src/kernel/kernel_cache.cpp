@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#include <limits>
+#include "runtime/object.h"
+#include "runtime/io.h"
+#include "kernel/kernel_cache.h"
+
+namespace lean {
+extern "C" object* lean_environment_kernel_cache(object*);
+extern "C" uint8 lean_environment_is_imported_const(object*, object*);
+
+kernel_cache::kernel_cache(size_t capacity):m_capacity(capacity) {
+    for (unsigned k = 0; k < num_kinds; k++) {
+        m_hits[k]   = 0;
+        m_misses[k] = 0;
+    }
+}
+
+optional<expr> kernel_cache::find(kind k, expr const & e) {
+    lock_guard<mutex> lock(m_mutex);
+    auto it = m_map.find(key(e, static_cast<unsigned>(k)));
+    if (it == m_map.end()) {
+        m_misses[static_cast<unsigned>(k)]++;
+        return none_expr();
+    }
+    m_hits[static_cast<unsigned>(k)]++;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return some_expr(it->second->second);
+}
+
+void kernel_cache::insert(kind k, expr const & e, expr const & v) {
+    /* The entries are used by type checkers running in other threads. */
+    mark_mt(e.raw());
+    mark_mt(v.raw());
+    lock_guard<mutex> lock(m_mutex);
+    key ky(e, static_cast<unsigned>(k));
+    if (m_map.find(ky) != m_map.end())
+        return;
+    m_lru.emplace_front(ky, v);
+    m_map.insert(mk_pair(ky, m_lru.begin()));
+    if (m_map.size() > m_capacity) {
+        m_map.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+void kernel_cache::get_stats(uint64 (&hits)[num_kinds], uint64 (&misses)[num_kinds]) {
+    lock_guard<mutex> lock(m_mutex);
+    for (unsigned k = 0; k < num_kinds; k++) {
+        hits[k]   = m_hits[k];
+        misses[k] = m_misses[k];
+    }
+}
+
+static lean_external_class * g_kernel_cache_external_class = nullptr;
+static void kernel_cache_finalizer(void * h) {
+    delete static_cast<kernel_cache *>(h);
+}
+/* All entries are marked as multi-threaded when they are inserted. */
+static void kernel_cache_foreach(void *, b_obj_arg) {}
+
+static kernel_cache * kernel_cache_get(b_obj_arg c) {
+    return static_cast<kernel_cache *>(lean_get_external_data(c));
+}
+
+kernel_cache * get_kernel_cache(environment const & env) {
+    object * c = lean_environment_kernel_cache(env.to_obj_arg());
+    if (is_scalar(c))
+        return nullptr;
+    /* The environment keeps the cache alive. */
+    kernel_cache * r = kernel_cache_get(cnstr_get(c, 0));
+    dec_ref(c);
+    return r;
+}
+
+bool is_imported_constant(environment const & env, name const & n) {
+    return lean_environment_is_imported_const(env.to_obj_arg(), n.to_obj_arg()) != 0;
+}
+
+/* KernelCache.new (capacity : @& Nat) : IO KernelCache */
+extern "C" LEAN_EXPORT obj_res lean_kernel_cache_mk(b_obj_arg capacity, obj_arg) {
+    size_t c = is_scalar(capacity) ? unbox(capacity) : std::numeric_limits<size_t>::max();
+    return io_result_mk_ok(lean_alloc_external(g_kernel_cache_external_class, new kernel_cache(c)));
+}
+
+/* KernelCache.stats (cache : @& KernelCache) : IO (Array (String × Nat × Nat)) */
+extern "C" LEAN_EXPORT obj_res lean_kernel_cache_stats(b_obj_arg cache, obj_arg) {
+    static char const * names[kernel_cache::num_kinds] = { "infer", "check", "whnfCore", "whnf" };
+    uint64 hits[kernel_cache::num_kinds], misses[kernel_cache::num_kinds];
+    kernel_cache_get(cache)->get_stats(hits, misses);
+    object * r = lean_mk_empty_array();
+    for (unsigned k = 0; k < kernel_cache::num_kinds; k++) {
+        object * counts = mk_cnstr(0, lean_uint64_to_nat(hits[k]), lean_uint64_to_nat(misses[k])).steal();
+        r = lean_array_push(r, mk_cnstr(0, lean_mk_string(names[k]), counts).steal());
+    }
+    return io_result_mk_ok(r);
+}
+
+void initialize_kernel_cache() {
+    g_kernel_cache_external_class = lean_register_external_class(kernel_cache_finalizer, kernel_cache_foreach);
+}
+
+void finalize_kernel_cache() {
+}
+}
@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#pragma once
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include "runtime/thread.h"
+#include "runtime/hash.h"
+#include "kernel/expr.h"
+#include "kernel/expr_eq_fn.h"
+#include "kernel/environment.h"
+
+namespace lean {
+/** \brief Cache of type inference and weak head normal form results shared by the type checkers of all the
+    declarations added to an imported environment, possibly in different threads.
+
+    Only results for closed expressions without universe parameters that only use imported constants are stored.
+    These results cannot change when declarations are added to the environment, and all environments using the same
+    cache have the same imported constants. The cache keeps at most `capacity` entries, evicting the least recently
+    used one. */
+class kernel_cache {
+public:
+    enum class kind { Infer, Check, WhnfCore, Whnf };
+    static constexpr unsigned num_kinds = 4;
+private:
+    typedef std::pair<expr, unsigned> key;
+    struct key_hash {
+        size_t operator()(key const & k) const { return hash(hash(k.first), k.second); }
+    };
+    typedef std::list<std::pair<key, expr>> lru_list;
+    mutex                                                   m_mutex;
+    size_t                                                  m_capacity;
+    /* Entries ordered from the most recently used to the least recently used one. */
+    lru_list                                                m_lru;
+    std::unordered_map<key, lru_list::iterator, key_hash>   m_map;
+    uint64                                                  m_hits[num_kinds];
+    uint64                                                  m_misses[num_kinds];
+public:
+    explicit kernel_cache(size_t capacity);
+    optional<expr> find(kind k, expr const & e);
+    void insert(kind k, expr const & e, expr const & v);
+    /** \brief Return the number of hits and misses of `find` for each kind of entry. */
+    void get_stats(uint64 (&hits)[num_kinds], uint64 (&misses)[num_kinds]);
+};
+
+/** \brief Return the cache shared by the type checkers of \c env, if any. */
+kernel_cache * get_kernel_cache(environment const & env);
+/** \brief Return true iff \c n is an imported constant of \c env. This does not hold for the extra constant names
+    of imported modules, see `Environment.isImportedConst`. */
+bool is_imported_constant(environment const & env, name const & n);
+
+void initialize_kernel_cache();
+void finalize_kernel_cache();
+}
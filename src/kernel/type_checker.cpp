@@ -4,11 +4,14 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <limits>
 #include <utility>
 #include <vector>
 #include "runtime/interrupt.h"
 #include "runtime/sstream.h"
 #include "runtime/flet.h"
+#include "runtime/array_ref.h"
+#include "util/nat.h"
 #include "util/lbool.h"
 #include "kernel/type_checker.h"
 #include "kernel/expr_maps.h"
@@ -35,9 +38,94 @@ static expr * g_nat_mod      = nullptr;
 static expr * g_nat_div      = nullptr;
 static expr * g_nat_beq      = nullptr;
 static expr * g_nat_ble      = nullptr;
+static expr * g_nat_land     = nullptr;
+static expr * g_nat_lor      = nullptr;
+static expr * g_nat_xor      = nullptr;
+static expr * g_nat_shiftl   = nullptr;
+static expr * g_nat_shiftr   = nullptr;
+static expr * g_nat_log2     = nullptr;
+
+LEAN_THREAD_PTR(kernel_profile, g_kernel_profile);
+
+kernel_profile_scope::kernel_profile_scope(kernel_profile & p):m_old(g_kernel_profile) {
+    g_kernel_profile = &p;
+}
+
+kernel_profile_scope::~kernel_profile_scope() {
+    g_kernel_profile = m_old;
+}
+
+object_ref to_object(kernel_profile const & p, uint64 nanos) {
+    static char const * fns[kernel_profile::NumFns] = {
+        "whnfCore", "whnf", "isDefEqCore", "inferType", "reduceRecursor", "reduceNat", "lazyDeltaReductionStep"
+    };
+    buffer<object_ref> counters;
+    for (unsigned f = 0; f < kernel_profile::NumFns; f++)
+        counters.push_back(mk_cnstr(0, string_ref(fns[f]), nat(lean_uint64_to_nat(p.m_calls[f])), nat(lean_uint64_to_nat(p.m_hits[f]))));
+    buffer<object_ref> unfolded;
+    for (auto const & e : p.m_unfolded)
+        unfolded.push_back(mk_cnstr(0, e.first, nat(lean_uint64_to_nat(e.second))));
+    return mk_cnstr(0, array_ref<object_ref>(counters), array_ref<object_ref>(unfolded), nat(lean_uint64_to_nat(nanos)));
+}
 
 type_checker::state::state(environment const & env):
-    m_env(env), m_ngen(*g_kernel_fresh) {}
+    m_env(env), m_ngen(*g_kernel_fresh), m_cache(get_kernel_cache(env)), m_profile(g_kernel_profile) {}
+
+/** \brief Return true if the results for \c e can be stored in the cache shared with other declarations.
+    This is the case for closed expressions without universe parameters that only use imported constants when
+    checking safe declarations. */
+bool type_checker::is_shareable(expr const & e) {
+    return m_st->m_cache && m_definition_safety == definition_safety::safe &&
+        !has_fvar(e) && !has_mvar(e) && !has_univ_param(e) && uses_only_imported_constants(e);
+}
+
+/** \brief Return true if all constants in \c e are imported. The result is memoized for all composite subterms of \c e
+    and all constants, since the type checker asks for the same subterms many times. */
+bool type_checker::uses_only_imported_constants(expr const & e) {
+    switch (e.kind()) {
+    case expr_kind::BVar: case expr_kind::Sort: case expr_kind::Lit:
+    case expr_kind::MVar: case expr_kind::FVar:
+        return true;
+    case expr_kind::Const: {
+        auto it = m_st->m_imported_consts.find(const_name(e));
+        if (it != m_st->m_imported_consts.end())
+            return it->second;
+        bool r = is_imported_constant(env(), const_name(e));
+        m_st->m_imported_consts.insert(mk_pair(const_name(e), r));
+        return r;
+    }
+    case expr_kind::MData: case expr_kind::Proj:
+    case expr_kind::App:   case expr_kind::Lambda:
+    case expr_kind::Pi:    case expr_kind::Let:
+        break;
+    }
+    auto it = m_st->m_shareable.find(e);
+    if (it != m_st->m_shareable.end())
+        return it->second;
+    bool r;
+    switch (e.kind()) {
+    case expr_kind::MData:
+        r = uses_only_imported_constants(mdata_expr(e));
+        break;
+    case expr_kind::Proj:
+        r = uses_only_imported_constants(proj_expr(e));
+        break;
+    case expr_kind::App:
+        r = uses_only_imported_constants(app_fn(e)) && uses_only_imported_constants(app_arg(e));
+        break;
+    case expr_kind::Lambda: case expr_kind::Pi:
+        r = uses_only_imported_constants(binding_domain(e)) && uses_only_imported_constants(binding_body(e));
+        break;
+    case expr_kind::Let:
+        r = uses_only_imported_constants(let_type(e)) && uses_only_imported_constants(let_value(e)) &&
+            uses_only_imported_constants(let_body(e));
+        break;
+    default:
+        lean_unreachable(); // LCOV_EXCL_LINE
+    }
+    m_st->m_shareable.insert(mk_pair(e, r));
+    return r;
+}
 
 /** \brief Make sure \c e "is" a sort, and return the corresponding sort.
     If \c e is not a sort, then the whnf procedure is invoked.
@@ -288,10 +376,23 @@ expr type_checker::infer_type_core(expr const & e, bool infer_only) {
 
     lean_assert(!has_loose_bvars(e));
     check_system("type checker", /* do_check_interrupted */ true);
+    profile_call(kernel_profile::InferType);
 
     auto it = m_st->m_infer_type[infer_only].find(e);
-    if (it != m_st->m_infer_type[infer_only].end())
+    if (it != m_st->m_infer_type[infer_only].end()) {
+        profile_hit(kernel_profile::InferType);
         return it->second;
+    }
+
+    kernel_cache::kind cache_kind = infer_only ? kernel_cache::kind::Infer : kernel_cache::kind::Check;
+    bool shared = is_shareable(e);
+    if (shared) {
+        if (auto r = m_st->m_cache->find(cache_kind, e)) {
+            profile_hit(kernel_profile::InferType);
+            m_st->m_infer_type[infer_only].insert(mk_pair(e, *r));
+            return *r;
+        }
+    }
 
     expr r;
     switch (e.kind()) {
@@ -314,6 +415,8 @@ expr type_checker::infer_type_core(expr const & e, bool infer_only) {
     }
 
     m_st->m_infer_type[infer_only].insert(mk_pair(e, r));
+    if (shared)
+        m_st->m_cache->insert(cache_kind, e, r);
     return r;
 }
 
@@ -347,8 +450,10 @@ bool type_checker::is_prop(expr const & e) {
 /** \brief Apply normalizer extensions to \c e.
     If `cheap == true`, then we don't perform delta-reduction when reducing major premise. */
 optional<expr> type_checker::reduce_recursor(expr const & e, bool cheap_rec, bool cheap_proj) {
+    profile_call(kernel_profile::ReduceRecursor);
     if (env().is_quot_initialized()) {
         if (optional<expr> r = quot_reduce_rec(e, [&](expr const & e) { return whnf(e); })) {
+            profile_hit(kernel_profile::ReduceRecursor);
             return r;
         }
     }
@@ -356,6 +461,7 @@ optional<expr> type_checker::reduce_recursor(expr const & e, bool cheap_rec, boo
                                                 [&](expr const & e) { return cheap_rec ? whnf_core(e, cheap_rec, cheap_proj) : whnf(e); },
                                                 [&](expr const & e) { return infer(e); },
                                                 [&](expr const & e1, expr const & e2) { return is_def_eq(e1, e2); })) {
+        profile_hit(kernel_profile::ReduceRecursor);
         return r;
     }
     return none_expr();
@@ -431,9 +537,20 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     }
 
     // check cache
+    profile_call(kernel_profile::WhnfCore);
     auto it = m_st->m_whnf_core.find(e);
-    if (it != m_st->m_whnf_core.end())
+    if (it != m_st->m_whnf_core.end()) {
+        profile_hit(kernel_profile::WhnfCore);
         return it->second;
+    }
+    bool shared = !cheap_rec && !cheap_proj && is_shareable(e);
+    if (shared) {
+        if (auto r = m_st->m_cache->find(kernel_cache::kind::WhnfCore, e)) {
+            profile_hit(kernel_profile::WhnfCore);
+            m_st->m_whnf_core.insert(mk_pair(e, *r));
+            return *r;
+        }
+    }
 
     // do the actual work
     expr r;
@@ -485,6 +602,8 @@ expr type_checker::whnf_core(expr const & e, bool cheap_rec, bool cheap_proj) {
     if (!cheap_rec && !cheap_proj) {
         m_st->m_whnf_core.insert(mk_pair(e, r));
     }
+    if (shared)
+        m_st->m_cache->insert(kernel_cache::kind::WhnfCore, e, r);
     return r;
 }
 
@@ -503,8 +622,11 @@ optional<constant_info> type_checker::is_delta(expr const & e) const {
 optional<expr> type_checker::unfold_definition_core(expr const & e) {
     if (is_constant(e)) {
         if (auto d = is_delta(e)) {
-            if (length(const_levels(e)) == d->get_num_lparams())
+            if (length(const_levels(e)) == d->get_num_lparams()) {
+                if (m_st->m_profile)
+                    m_st->m_profile->m_unfolded[const_name(e)]++;
                 return some_expr(instantiate_value_lparams(*d, const_levels(e)));
+            }
         }
     }
     return none_expr();
@@ -586,7 +708,20 @@ template<typename F> optional<expr> type_checker::reduce_bin_nat_pred(F const &
     return f(v1.raw(), v2.raw()) ? some_expr(mk_bool_true()) : some_expr(mk_bool_false());
 }
 
-optional<expr> type_checker::reduce_nat(expr const & e) {
+/* The runtime implementation of `Nat.shiftLeft` and `Nat.shiftRight` panics if the shift amount does not fit in an `unsigned`.
+   We do not reduce these applications, and fall back to unfolding the definitions. */
+template<typename F> optional<expr> type_checker::reduce_nat_shift(F const & f, expr const & e) {
+    expr arg2 = whnf(app_arg(e));
+    if (!is_nat_lit_ext(arg2)) return none_expr();
+    nat v2 = get_nat_val(arg2);
+    if (!v2.is_small() || v2.get_small_value() > std::numeric_limits<unsigned>::max()) return none_expr();
+    expr arg1 = whnf(app_arg(app_fn(e)));
+    if (!is_nat_lit_ext(arg1)) return none_expr();
+    nat v1 = get_nat_val(arg1);
+    return some_expr(mk_lit(literal(nat(f(v1.raw(), v2.raw())))));
+}
+
+optional<expr> type_checker::reduce_nat_core(expr const & e) {
     if (has_fvar(e)) return none_expr();
     unsigned nargs = get_app_num_args(e);
     if (nargs == 1) {
@@ -597,6 +732,12 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
             nat v = get_nat_val(arg);
             return some_expr(mk_lit(literal(nat(v+nat(1)))));
         }
+        if (f == *g_nat_log2) {
+            expr arg = whnf(app_arg(e));
+            if (!is_nat_lit_ext(arg)) return none_expr();
+            nat v = get_nat_val(arg);
+            return some_expr(mk_lit(literal(nat(nat_log2(v.raw())))));
+        }
     } else if (nargs == 2) {
         expr const & f = app_fn(app_fn(e));
         if (!is_constant(f)) return none_expr();
@@ -609,10 +750,23 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
         if (f == *g_nat_div) return reduce_bin_nat_op(nat_div, e);
         if (f == *g_nat_beq) return reduce_bin_nat_pred(nat_eq, e);
         if (f == *g_nat_ble) return reduce_bin_nat_pred(nat_le, e);
+        if (f == *g_nat_land) return reduce_bin_nat_op(nat_land, e);
+        if (f == *g_nat_lor) return reduce_bin_nat_op(nat_lor, e);
+        if (f == *g_nat_xor) return reduce_bin_nat_op(nat_lxor, e);
+        if (f == *g_nat_shiftl) return reduce_nat_shift(nat_shiftl, e);
+        if (f == *g_nat_shiftr) return reduce_nat_shift(nat_shiftr, e);
     }
     return none_expr();
 }
 
+optional<expr> type_checker::reduce_nat(expr const & e) {
+    profile_call(kernel_profile::ReduceNat);
+    optional<expr> r = reduce_nat_core(e);
+    if (r)
+        profile_hit(kernel_profile::ReduceNat);
+    return r;
+}
+
 /** \brief Put expression \c t in weak head normal form */
 expr type_checker::whnf(expr const & e) {
     // Do not cache easy cases
@@ -633,25 +787,38 @@ expr type_checker::whnf(expr const & e) {
     }
 
     // check cache
+    profile_call(kernel_profile::Whnf);
     auto it = m_st->m_whnf.find(e);
-    if (it != m_st->m_whnf.end())
+    if (it != m_st->m_whnf.end()) {
+        profile_hit(kernel_profile::Whnf);
         return it->second;
+    }
+    bool shared = is_shareable(e);
+    if (shared) {
+        if (auto r = m_st->m_cache->find(kernel_cache::kind::Whnf, e)) {
+            profile_hit(kernel_profile::Whnf);
+            m_st->m_whnf.insert(mk_pair(e, *r));
+            return *r;
+        }
+    }
 
+    auto cache = [&](expr const & r) {
+        m_st->m_whnf.insert(mk_pair(e, r));
+        if (shared)
+            m_st->m_cache->insert(kernel_cache::kind::Whnf, e, r);
+        return r;
+    };
     expr t = e;
     while (true) {
         expr t1 = whnf_core(t);
         if (auto v = reduce_native(env(), t1)) {
-            m_st->m_whnf.insert(mk_pair(e, *v));
-            return *v;
+            return cache(*v);
         } else if (auto v = reduce_nat(t1)) {
-            m_st->m_whnf.insert(mk_pair(e, *v));
-            return *v;
+            return cache(*v);
         } else if (auto next_t = unfold_definition(t1)) {
             t = *next_t;
         } else {
-            auto r = t1;
-            m_st->m_whnf.insert(mk_pair(e, r));
-            return r;
+            return cache(t1);
         }
     }
 }
@@ -858,6 +1025,7 @@ optional<expr> type_checker::try_unfold_proj_app(expr const & e) {
 
      \remark t_n, s_n and cs are updated. */
 auto type_checker::lazy_delta_reduction_step(expr & t_n, expr & s_n) -> reduction_status {
+    profile_call(kernel_profile::LazyDeltaReductionStep);
     auto d_t = is_delta(t_n);
     auto d_s = is_delta(s_n);
     if (!d_t && !d_s) {
@@ -898,6 +1066,7 @@ auto type_checker::lazy_delta_reduction_step(expr & t_n, expr & s_n) -> reductio
                 if (!failed_before(t_n, s_n)) {
                     if (is_def_eq(const_levels(get_app_fn(t_n)), const_levels(get_app_fn(s_n))) &&
                         is_def_eq_args(t_n, s_n)) {
+                        profile_hit(kernel_profile::LazyDeltaReductionStep);
                         return reduction_status::DefEqual;
                     } else {
                         cache_failure(t_n, s_n);
@@ -1003,9 +1172,13 @@ bool type_checker::is_def_eq_unit_like(expr const & t, expr const & s) {
 
 bool type_checker::is_def_eq_core(expr const & t, expr const & s) {
     check_system("is_definitionally_equal", /* do_check_interrupted */ true);
+    profile_call(kernel_profile::IsDefEqCore);
     bool use_hash = true;
     lbool r = quick_is_def_eq(t, s, use_hash);
-    if (r != l_undef) return r == l_true;
+    if (r != l_undef) {
+        profile_hit(kernel_profile::IsDefEqCore);
+        return r == l_true;
+    }
     
     // Very basic support for proofs by reflection. If `t` has no free variables and `s` is `Bool.true`,
     // we fully reduce `t` and check whether result is `s`.
@@ -1163,6 +1336,18 @@ void initialize_type_checker() {
     mark_persistent(g_nat_beq->raw());
     g_nat_ble      = new expr(mk_constant(name{"Nat", "ble"}));
     mark_persistent(g_nat_ble->raw());
+    g_nat_land     = new expr(mk_constant(name{"Nat", "land"}));
+    mark_persistent(g_nat_land->raw());
+    g_nat_lor      = new expr(mk_constant(name{"Nat", "lor"}));
+    mark_persistent(g_nat_lor->raw());
+    g_nat_xor      = new expr(mk_constant(name{"Nat", "xor"}));
+    mark_persistent(g_nat_xor->raw());
+    g_nat_shiftl   = new expr(mk_constant(name{"Nat", "shiftLeft"}));
+    mark_persistent(g_nat_shiftl->raw());
+    g_nat_shiftr   = new expr(mk_constant(name{"Nat", "shiftRight"}));
+    mark_persistent(g_nat_shiftr->raw());
+    g_nat_log2     = new expr(mk_constant(name{"Nat", "log2"}));
+    mark_persistent(g_nat_log2->raw());
     g_string_mk    = new expr(mk_constant(name{"String", "mk"}));
     mark_persistent(g_string_mk->raw());
     g_lean_reduce_bool = new expr(mk_constant(name{"Lean", "reduceBool"}));
@@ -1186,6 +1371,12 @@ void finalize_type_checker() {
     delete g_nat_mod;
     delete g_nat_beq;
     delete g_nat_ble;
+    delete g_nat_land;
+    delete g_nat_lor;
+    delete g_nat_xor;
+    delete g_nat_shiftl;
+    delete g_nat_shiftr;
+    delete g_nat_log2;
     delete g_string_mk;
     delete g_lean_reduce_bool;
     delete g_lean_reduce_nat;
@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <unordered_map>
 #include <unordered_set>
 #include <memory>
 #include <utility>
@@ -16,8 +17,33 @@ Author: Leonardo de Moura
 #include "kernel/local_ctx.h"
 #include "kernel/expr_maps.h"
 #include "kernel/equiv_manager.h"
+#include "kernel/kernel_cache.h"
 
 namespace lean {
+/** \brief Counters of the functions of the type checker, see `kernel_profile_scope`. */
+struct kernel_profile {
+    enum fn { WhnfCore, Whnf, IsDefEqCore, InferType, ReduceRecursor, ReduceNat, LazyDeltaReductionStep, NumFns };
+    uint64 m_calls[NumFns] = {};
+    /* Number of cache hits for `whnf_core`, `whnf` and `infer_type`, of calls resolved without reduction for
+       `is_def_eq_core`, of successful reductions for `reduce_recursor` and `reduce_nat`, and of steps of
+       `lazy_delta_reduction_step` that compared arguments instead of unfolding definitions. */
+    uint64 m_hits[NumFns]  = {};
+    /* Number of times each constant has been delta-unfolded */
+    std::unordered_map<name, uint64, name_hash_fn> m_unfolded;
+};
+
+/** \brief Convert into an object of the Lean type `KernelProfile`, where `nanos` is the time it took to collect `p`. */
+object_ref to_object(kernel_profile const & p, uint64 nanos);
+
+/** \brief While an object of this class is alive, the type checkers created in the current thread record their
+    counters in the given profile. */
+class kernel_profile_scope {
+    kernel_profile * m_old;
+public:
+    kernel_profile_scope(kernel_profile & p);
+    ~kernel_profile_scope();
+};
+
 /** \brief Lean Type Checker. It can also be used to infer types, check whether a
     type \c A is convertible to a type \c B, etc. */
 class type_checker {
@@ -32,6 +58,13 @@ public:
         expr_map<expr>            m_whnf;
         equiv_manager             m_eqv_manager;
         expr_pair_set             m_failure;
+        /* Cache shared with the type checkers of other declarations, see `kernel_cache`. */
+        kernel_cache *            m_cache;
+        /* Whether expressions and constants only use imported constants, see `is_shareable`. */
+        expr_map<bool>            m_shareable;
+        std::unordered_map<name, bool, name_hash_fn> m_imported_consts;
+        /* Profile of the active `kernel_profile_scope` when the state was created, if any. */
+        kernel_profile *          m_profile;
         friend type_checker;
     public:
         state(environment const & env);
@@ -60,6 +93,10 @@ private:
     expr infer_let(expr const & e, bool infer_only);
     expr infer_type_core(expr const & e, bool infer_only);
     expr infer_type(expr const & e);
+    bool is_shareable(expr const & e);
+    bool uses_only_imported_constants(expr const & e);
+    void profile_call(kernel_profile::fn f) { if (m_st->m_profile) m_st->m_profile->m_calls[f]++; }
+    void profile_hit(kernel_profile::fn f) { if (m_st->m_profile) m_st->m_profile->m_hits[f]++; }
 
     enum class reduction_status { Continue, DefUnknown, DefEqual, DefDiff };
     optional<expr> reduce_recursor(expr const & e, bool cheap_rec, bool cheap_proj);
@@ -98,6 +135,8 @@ private:
 
     template<typename F> optional<expr> reduce_bin_nat_op(F const & f, expr const & e);
     template<typename F> optional<expr> reduce_bin_nat_pred(F const & f, expr const & e);
+    template<typename F> optional<expr> reduce_nat_shift(F const & f, expr const & e);
+    optional<expr> reduce_nat_core(expr const & e);
     optional<expr> reduce_nat(expr const & e);
 public:
     type_checker(state & st, local_ctx const & lctx, definition_safety ds = definition_safety::safe);
@@ -36,22 +36,38 @@ of the `traceFile`. If rebuilt, save the new `depTrace` to the `tracefile`.
     build
     depTrace.writeToFile traceFile
 
-/-- Fetch the trace of a file that may have its hash already cached in a `.hash` file. -/
-def fetchFileTrace (file : FilePath) : BuildM BuildTrace := do
+/--
+Compute the hash of an `.olean` file from the content hash Lean stores in its
+header, which avoids reading the whole file. Falls back to hashing the file
+if it has no such hash.
+-/
+def computeOLeanHash (file : FilePath) : IO Hash := do
+  if let some (h₁, h₂) ← Lean.readModuleDataHash? file then
+    return ⟨mixHash h₁ h₂⟩
+  else
+    computeFileHash file
+
+/--
+Fetch the trace of a file that may have its hash already cached in a `.hash` file.
+The hash is computed using `hashFile` otherwise.
+-/
+def fetchFileTrace (file : FilePath)
+(hashFile : FilePath → IO Hash := computeFileHash) : BuildM BuildTrace := do
   if (← getTrustHash) then
-    let hashFile := FilePath.mk <| file.toString ++ ".hash"
-    if let some hash ← Hash.load? hashFile then
+    let hashFilePath := FilePath.mk <| file.toString ++ ".hash"
+    if let some hash ← Hash.load? hashFilePath then
       return .mk hash (← getMTime file)
     else
-      let hash ← computeHash file
-      IO.FS.writeFile hashFile hash.toString
+      let hash ← hashFile file
+      IO.FS.writeFile hashFilePath hash.toString
       return .mk hash (← getMTime file)
   else
-    computeTrace file
+    return .mk (← hashFile file) (← getMTime file)
 
-/-- Compute the hash of a file and save it to a `.hash` file. -/
-def cacheFileHash (file : FilePath) : IO Hash := do
-  let hash ← computeHash file
+/-- Compute the hash of a file using `hashFile` and save it to a `.hash` file. -/
+def cacheFileHash (file : FilePath)
+(hashFile : FilePath → IO Hash := computeFileHash) : IO Hash := do
+  let hash ← hashFile file
   let hashFile := FilePath.mk <| file.toString ++ ".hash"
   IO.FS.writeFile hashFile hash.toString
   return hash
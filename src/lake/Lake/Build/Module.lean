@@ -152,7 +152,7 @@ def Module.recBuildLean (mod : Module) : IndexBuildM (BuildJob Unit) := do
     buildUnlessUpToDate mod modTrace mod.traceFile do
       compileLeanModule mod.name.toString mod.leanFile mod.oleanFile mod.ileanFile mod.cFile
         (← getLeanPath) mod.rootDir dynlibs dynlibPath (mod.weakLeanArgs ++ mod.leanArgs) (← getLean)
-      discard <| cacheFileHash mod.oleanFile
+      discard <| cacheFileHash mod.oleanFile computeOLeanHash
       discard <| cacheFileHash mod.ileanFile
       discard <| cacheFileHash mod.cFile
     return ((), depTrace)
@@ -165,7 +165,7 @@ def Module.leanArtsFacetConfig : ModuleFacetConfig leanArtsFacet :=
 def Module.oleanFacetConfig : ModuleFacetConfig oleanFacet :=
   mkFacetJobConfigSmall fun mod => do
     (← mod.leanArts.fetch).bindSync fun _ depTrace =>
-      return (mod.oleanFile, mixTrace (← fetchFileTrace mod.oleanFile) depTrace)
+      return (mod.oleanFile, mixTrace (← fetchFileTrace mod.oleanFile computeOLeanHash) depTrace)
 
 /-- The `ModuleFacetConfig` for the builtin `ileanFacet`. -/
 def Module.ileanFacetConfig : ModuleFacetConfig ileanFacet :=
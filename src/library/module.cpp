@@ -11,6 +11,8 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <sys/stat.h>
 #include "runtime/thread.h"
 #include "runtime/interrupt.h"
@@ -18,6 +20,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 #include "runtime/hash.h"
 #include "runtime/io.h"
 #include "runtime/compact.h"
+#include "runtime/compress.h"
 #include "runtime/buffer.h"
 #include "util/io.h"
 #include "util/name_map.h"
@@ -43,8 +46,177 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 namespace lean {
 // manually padded to multiple of word size, see `initialize_module`
 static char const * g_olean_header   = "oleanfile!!!!!!!";
+/* The compacted objects are followed by their relocation bitmap (see `object_compactor::get_relocations`), the size of
+   the compacted objects, and this marker. Files without it do not have a relocation bitmap. */
+static char const * g_olean_relocs_footer = "oleanrel";
+/* Header of .olean files whose base address is followed by a 128-bit hash (see `hash128`) of the data following the
+   header, see `lean_read_module_data_hash`. Files starting with `g_olean_header` do not have a hash. */
+static char const * g_olean_hash_header = "oleanfile!!!!!#!";
+/* Header of compressed .olean files, which is followed by the base address, the hash of the uncompressed data, the
+   size of the uncompressed data following the header in an uncompressed file, the block size, the number of blocks,
+   the end offset of each compressed block, and the blocks, which are compressed independently using `lz_compress`. */
+static char const * g_olean_lz_header = "oleanlz4!!!!!!!!";
+/* Header of import images (see `ImportImage` in `Environment.lean`), which are otherwise stored like uncompressed
+   .olean files with a hash. Images and .olean files are never read as each other. */
+static char const * g_import_image_header = "leanimage!!!!!#!";
 
-extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, object *) {
+struct olean_header {
+    char * m_base_addr;
+    bool   m_compressed;
+    bool   m_has_hash;
+    uint64 m_hash[2];
+    /* Size of the header in the file; the compacted objects were compacted for `m_base_addr + m_size`. */
+    size_t m_size;
+};
+
+/* Read the header of an .olean file, or of an import image if `image` is true, from `in`. Return false if it is not
+   a valid header. */
+static bool read_olean_header(std::istream & in, olean_header & h, bool image = false) {
+    char magic[16];
+    size_t magic_size = strlen(g_olean_header);
+    if (!in.read(magic, magic_size))
+        return false;
+    if (image) {
+        if (strncmp(magic, g_import_image_header, magic_size) != 0)
+            return false;
+        h.m_compressed = false;
+        h.m_has_hash   = true;
+    } else {
+        h.m_compressed = strncmp(magic, g_olean_lz_header, magic_size) == 0;
+        h.m_has_hash   = h.m_compressed || strncmp(magic, g_olean_hash_header, magic_size) == 0;
+        if (!h.m_has_hash && strncmp(magic, g_olean_header, magic_size) != 0)
+            return false;
+    }
+    in.read(reinterpret_cast<char *>(&h.m_base_addr), sizeof(h.m_base_addr));
+    h.m_size = magic_size + sizeof(h.m_base_addr);
+    if (h.m_has_hash) {
+        in.read(reinterpret_cast<char *>(h.m_hash), sizeof(h.m_hash));
+        h.m_size += sizeof(h.m_hash);
+    }
+    return static_cast<bool>(in);
+}
+/* Uncompressed size of the blocks of compressed .olean files */
+#define LEAN_OLEAN_BLOCK_SIZE (256 * 1024)
+
+/* Apply `fn` to `0, ..., n-1` using up to `hardware_concurrency()` tasks. */
+struct olean_blocks_job {
+    std::atomic<size_t>                 m_next{0};
+    size_t                              m_num_blocks;
+    std::function<void(size_t)> const * m_fn;
+};
+
+static void olean_blocks_core(olean_blocks_job & job) {
+    while (true) {
+        size_t i = job.m_next++;
+        if (i >= job.m_num_blocks)
+            return;
+        (*job.m_fn)(i);
+    }
+}
+
+static obj_res olean_blocks_fn(obj_arg job, obj_arg) {
+    olean_blocks_core(*reinterpret_cast<olean_blocks_job *>(lean_unbox_usize(job)));
+    lean_dec(job);
+    return lean_box(0);
+}
+
+static void for_each_olean_block(size_t n, std::function<void(size_t)> const & fn) {
+    olean_blocks_job job;
+    job.m_num_blocks = n;
+    job.m_fn         = &fn;
+    std::vector<object *> tasks;
+    size_t num_tasks = std::min<size_t>(hardware_concurrency(), n);
+    for (size_t i = 1; i < num_tasks; i++) {
+        object * c = lean_alloc_closure(reinterpret_cast<void *>(olean_blocks_fn), 2, 1);
+        lean_closure_set(c, 0, lean_box_usize(reinterpret_cast<size_t>(&job)));
+        tasks.push_back(lean_task_spawn_core(c, 0, false));
+    }
+    olean_blocks_core(job);
+    for (object * t : tasks) {
+        lean_task_get(t);
+        lean_dec(t);
+    }
+}
+
+static void write_uint64(std::ostream & out, uint64 v) {
+    out.write(reinterpret_cast<char const *>(&v), sizeof(v));
+}
+
+/* Write `data` as independently compressed blocks in the format described at `g_olean_lz_header`. */
+static void write_olean_blocks(std::ostream & out, std::string const & data) {
+    size_t num_blocks = (data.size() + LEAN_OLEAN_BLOCK_SIZE - 1) / LEAN_OLEAN_BLOCK_SIZE;
+    std::vector<std::string> blocks(num_blocks);
+    for_each_olean_block(num_blocks, [&](size_t i) {
+        size_t begin = i * LEAN_OLEAN_BLOCK_SIZE;
+        lz_compress(data.data() + begin, std::min<size_t>(LEAN_OLEAN_BLOCK_SIZE, data.size() - begin), blocks[i]);
+    });
+    write_uint64(out, data.size());
+    write_uint64(out, LEAN_OLEAN_BLOCK_SIZE);
+    write_uint64(out, num_blocks);
+    uint64 end = 0;
+    for (std::string const & block : blocks) {
+        end += block.size();
+        write_uint64(out, end);
+    }
+    for (std::string const & block : blocks)
+        out.write(block.data(), block.size());
+}
+
+/* Decompress the blocks `data[0..size)` written by `write_olean_blocks` into a new buffer allocated using `malloc`,
+   and set `out_size` to its size. Return `nullptr` if the data is malformed. */
+static char * read_olean_blocks(char const * data, size_t size, size_t & out_size) {
+    uint64 hdr[3];
+    if (size < sizeof(hdr))
+        return nullptr;
+    memcpy(hdr, data, sizeof(hdr));
+    uint64 data_size = hdr[0], block_size = hdr[1], num_blocks = hdr[2];
+    if (block_size == 0 || num_blocks != (data_size + block_size - 1) / block_size ||
+        num_blocks > (size - sizeof(hdr)) / sizeof(uint64))
+        return nullptr;
+    std::vector<uint64> ends(num_blocks);
+    memcpy(ends.data(), data + sizeof(hdr), num_blocks * sizeof(uint64));
+    char const * blocks = data + sizeof(hdr) + num_blocks * sizeof(uint64);
+    size_t blocks_size  = size - sizeof(hdr) - num_blocks * sizeof(uint64);
+    for (size_t i = 0; i < num_blocks; i++) {
+        if (ends[i] > blocks_size || (i > 0 && ends[i] < ends[i - 1]))
+            return nullptr;
+    }
+    char * buffer = static_cast<char *>(malloc(data_size));
+    if (!buffer)
+        return nullptr;
+    std::atomic<bool> ok(true);
+    for_each_olean_block(num_blocks, [&](size_t i) {
+        size_t begin = i > 0 ? ends[i - 1] : 0;
+        size_t out_begin = i * block_size;
+        if (!lz_decompress(blocks + begin, ends[i] - begin, buffer + out_begin, std::min<size_t>(block_size, data_size - out_begin)))
+            ok = false;
+    });
+    if (!ok) {
+        free(buffer);
+        return nullptr;
+    }
+    out_size = data_size;
+    return buffer;
+}
+
+/* Return true if `footer` (the last bytes of the `size` bytes following the header) marks a relocation bitmap, and set
+   `data_size` to the size of the compacted objects preceding it. */
+static bool read_relocs_footer(char const * footer, size_t size, size_t & data_size) {
+    uint64 sz;
+    memcpy(&sz, footer, sizeof(sz));
+    size_t footer_size = sizeof(uint64) + strlen(g_olean_relocs_footer);
+    if (strncmp(footer + sizeof(sz), g_olean_relocs_footer, strlen(g_olean_relocs_footer)) == 0 &&
+        sz % sizeof(void*) == 0 &&
+        sz + (sz / sizeof(void*) + 63) / 64 * sizeof(uint64) + footer_size == size) {
+        data_size = sz;
+        return true;
+    }
+    return false;
+}
+
+/* Save `mdata` to `fname`, as an import image with `g_import_image_header` if `image` is true. Images are never
+   compressed. The data is compacted using up to `num_tasks` tasks, or one per hardware thread if it is 0. */
+static object * save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, bool compress, unsigned num_tasks, bool image) {
     std::string olean_fn(string_cstr(fname));
     // we first write to a temp file and then move it to the correct path (possibly deleting an older file)
     // so that we neither expose partially-written files nor modify possibly memory-mapped files
@@ -73,11 +245,42 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
         // `MapViewOfFileEx` addresses must be aligned to the "memory allocation granularity", which is 64KB.
         base_addr = base_addr & ~((1LL<<16) - 1);
 
-        object_compactor compactor(reinterpret_cast<void *>(base_addr + strlen(g_olean_header) + sizeof(base_addr)));
+        uint64 hash[2] = {0, 0};
+        size_t header_size = strlen(g_olean_hash_header) + sizeof(base_addr) + sizeof(hash);
+
+        // large modules are compacted using multiple tasks, which does not affect the resulting file
+        if (num_tasks == 0)
+            num_tasks = hardware_concurrency();
+        object_compactor compactor(reinterpret_cast<void *>(base_addr + header_size), num_tasks);
         compactor(mdata);
-        out.write(g_olean_header, strlen(g_olean_header));
-        out.write(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
-        out.write(static_cast<char const *>(compactor.data()), compactor.size());
+        std::vector<uint64> relocs = compactor.get_relocations();
+        uint64 data_size = compactor.size();
+        // hash the data following the header in an uncompressed file, which is also stored in compressed files
+        hash128(compactor.data(), compactor.size(), hash[0], hash[1]);
+        hash128(relocs.data(), relocs.size() * sizeof(uint64), hash[0], hash[1]);
+        hash128(&data_size, sizeof(data_size), hash[0], hash[1]);
+        hash128(g_olean_relocs_footer, strlen(g_olean_relocs_footer), hash[0], hash[1]);
+        if (compress) {
+            // compressed files contain the same data, which is decompressed into a buffer when reading
+            std::string data;
+            data.reserve(compactor.size() + relocs.size() * sizeof(uint64) + sizeof(data_size) + strlen(g_olean_relocs_footer));
+            data.append(static_cast<char const *>(compactor.data()), compactor.size());
+            data.append(reinterpret_cast<char const *>(relocs.data()), relocs.size() * sizeof(uint64));
+            data.append(reinterpret_cast<char const *>(&data_size), sizeof(data_size));
+            data.append(g_olean_relocs_footer, strlen(g_olean_relocs_footer));
+            out.write(g_olean_lz_header, strlen(g_olean_lz_header));
+            out.write(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
+            out.write(reinterpret_cast<char *>(hash), sizeof(hash));
+            write_olean_blocks(out, data);
+        } else {
+            out.write(image ? g_import_image_header : g_olean_hash_header, strlen(g_olean_hash_header));
+            out.write(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
+            out.write(reinterpret_cast<char *>(hash), sizeof(hash));
+            out.write(static_cast<char const *>(compactor.data()), compactor.size());
+            out.write(reinterpret_cast<char const *>(relocs.data()), relocs.size() * sizeof(uint64));
+            out.write(reinterpret_cast<char const *>(&data_size), sizeof(data_size));
+            out.write(g_olean_relocs_footer, strlen(g_olean_relocs_footer));
+        }
         out.close();
         while (std::rename(olean_tmp_fn.c_str(), olean_fn.c_str()) != 0) {
 #ifdef LEAN_WINDOWS
@@ -105,7 +308,17 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
     }
 }
 
-extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *) {
+extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, uint8 compress, uint32 num_tasks, object *) {
+    return save_module_data(fname, mod, mdata, compress, num_tasks, false);
+}
+
+/* saveImportImageCore (fname : @& FilePath) (key : @& Name) (img : @& ImportImage) : IO Unit */
+extern "C" LEAN_EXPORT object * lean_save_import_image(b_obj_arg fname, b_obj_arg key, b_obj_arg img, object *) {
+    return save_module_data(fname, key, img, false, 0, true);
+}
+
+/* Read the module data, or the import image if `image` is true, stored in `fname`. */
+static object * read_module_data(object * fname, bool image) {
     std::string olean_fn(string_cstr(fname));
     try {
         std::ifstream in(olean_fn, std::ios_base::binary);
@@ -116,74 +329,96 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
         in.seekg(0, in.end);
         size_t size = in.tellg();
         in.seekg(0);
-        size_t header_size = strlen(g_olean_header);
-        if (size < header_size) {
-            return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
-        }
-        char * header = new char[header_size];
-        in.read(header, header_size);
-        if (strncmp(header, g_olean_header, header_size) != 0) {
+        olean_header header;
+        if (!read_olean_header(in, header, image)) {
             return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
         }
-        delete[] header;
-        char * base_addr;
-        in.read(reinterpret_cast<char *>(&base_addr), sizeof(base_addr));
-        header_size += sizeof(base_addr);
+        char * base_addr   = header.m_base_addr;
+        size_t header_size = header.m_size;
+        bool is_lz         = header.m_compressed;
+        size_t data_size = size - header_size;
+        bool has_relocs  = false;
+        size_t footer_size = sizeof(uint64) + strlen(g_olean_relocs_footer);
         char * buffer = nullptr;
         bool is_mmap = false;
         std::function<void()> free_data;
+        if (is_lz) {
+            // compressed files cannot be mapped, so we decompress them into a buffer and relocate it if necessary
+            std::string blocks(size - header_size, '\0');
+            in.read(&blocks[0], blocks.size());
+            size_t uncompressed_size;
+            if (!in || !(buffer = read_olean_blocks(blocks.data(), blocks.size(), uncompressed_size))) {
+                return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid compressed data").str());
+            }
+            free_data = [=]() {
+                free(buffer);
+            };
+            data_size  = uncompressed_size;
+            has_relocs = uncompressed_size >= footer_size &&
+                read_relocs_footer(buffer + uncompressed_size - footer_size, uncompressed_size, data_size);
+        } else {
+            if (size >= header_size + footer_size) {
+                char footer[16];
+                in.seekg(size - footer_size);
+                in.read(footer, footer_size);
+                has_relocs = read_relocs_footer(footer, size - header_size, data_size);
+                in.seekg(header_size);
+            }
 #ifdef LEAN_WINDOWS
-        // `FILE_SHARE_DELETE` is necessary to allow the file to (be marked to) be deleted while in use
-        HANDLE h_olean_fn = CreateFile(olean_fn.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (h_olean_fn == INVALID_HANDLE_VALUE) {
-            return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << GetLastError()).str());
-        }
-        HANDLE h_map = CreateFileMapping(h_olean_fn, NULL, PAGE_READONLY, 0, 0, NULL);
-        if (h_olean_fn == NULL) {
-            return io_result_mk_error((sstream() << "failed to map '" << olean_fn << "': " << GetLastError()).str());
-        }
-        buffer = static_cast<char *>(MapViewOfFileEx(h_map, FILE_MAP_READ, 0, 0, 0, base_addr));
-        free_data = [=]() {
-            if (buffer) {
-                lean_always_assert(UnmapViewOfFile(base_addr));
+            // `FILE_SHARE_DELETE` is necessary to allow the file to (be marked to) be deleted while in use
+            HANDLE h_olean_fn = CreateFile(olean_fn.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (h_olean_fn == INVALID_HANDLE_VALUE) {
+                return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << GetLastError()).str());
             }
-            lean_always_assert(CloseHandle(h_map));
-            lean_always_assert(CloseHandle(h_olean_fn));
-        };
+            HANDLE h_map = CreateFileMapping(h_olean_fn, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (h_olean_fn == NULL) {
+                return io_result_mk_error((sstream() << "failed to map '" << olean_fn << "': " << GetLastError()).str());
+            }
+            buffer = static_cast<char *>(MapViewOfFileEx(h_map, FILE_MAP_READ, 0, 0, 0, base_addr));
+            free_data = [=]() {
+                if (buffer) {
+                    lean_always_assert(UnmapViewOfFile(base_addr));
+                }
+                lean_always_assert(CloseHandle(h_map));
+                lean_always_assert(CloseHandle(h_olean_fn));
+            };
 #else
-        int fd = open(olean_fn.c_str(), O_RDONLY);
-        if (fd == -1) {
-            return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << strerror(errno)).str());
-        }
-#ifdef LEAN_MMAP
-        buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
-#endif
-        close(fd);
-        free_data = [=]() {
-            if (buffer != MAP_FAILED) {
-                lean_always_assert(munmap(buffer, size) == 0);
+            int fd = open(olean_fn.c_str(), O_RDONLY);
+            if (fd == -1) {
+                return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << strerror(errno)).str());
             }
-        };
-#endif
-        if (buffer && buffer == base_addr) {
-            buffer += header_size;
-            is_mmap = true;
-        } else {
 #ifdef LEAN_MMAP
-            free_data();
+            buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
 #endif
-            buffer = static_cast<char *>(malloc(size - header_size));
+            close(fd);
             free_data = [=]() {
-                free(buffer);
+                if (buffer != MAP_FAILED) {
+                    lean_always_assert(munmap(buffer, size) == 0);
+                }
             };
-            in.read(buffer, size - header_size);
-            if (!in) {
-                return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "'").str());
+#endif
+            if (buffer && buffer == base_addr) {
+                buffer += header_size;
+                is_mmap = true;
+            } else {
+#ifdef LEAN_MMAP
+                free_data();
+#endif
+                buffer = static_cast<char *>(malloc(size - header_size));
+                free_data = [=]() {
+                    free(buffer);
+                };
+                in.read(buffer, size - header_size);
+                if (!in) {
+                    return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "'").str());
+                }
             }
         }
         in.close();
 
-        compacted_region * region = new compacted_region(size - header_size, buffer, base_addr + header_size, is_mmap, free_data);
+        // the relocation bitmap follows the compacted objects
+        uint64 const * relocs = has_relocs ? reinterpret_cast<uint64 const *>(buffer + data_size) : nullptr;
+        compacted_region * region = new compacted_region(data_size, buffer, base_addr + header_size, is_mmap, free_data, relocs);
 #if defined(__has_feature)
 #if __has_feature(address_sanitizer)
         // do not report as leak
@@ -200,12 +435,209 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
     }
 }
 
+extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *) {
+    return read_module_data(fname, false);
+}
+
+/* readImportImageCore (fname : @& FilePath) : IO (ImportImage × CompactedRegion) */
+extern "C" LEAN_EXPORT object * lean_read_import_image(object * fname, object *) {
+    return read_module_data(fname, true);
+}
+
+/*
+  Constant index: a sorted table from the hashes of the constant names of a module to their positions in
+  `ModuleData.constants`. It is stored in `ModuleData.constIndex`, and the indices of all imported modules are merged
+  when importing modules with `lazyImport`, so that imported constants can be found without inserting them in
+  the environment. Only the pages of the table and of the constants actually found are touched.
+*/
+struct const_index_entry {
+    uint64   m_hash;
+    // index in the array of imported modules (always 0 in `ModuleData.constIndex`)
+    unsigned m_module;
+    // index in `ModuleData.constants`
+    unsigned m_idx;
+};
+
+static bool operator<(const_index_entry const & e1, const_index_entry const & e2) {
+    if (e1.m_hash != e2.m_hash) return e1.m_hash < e2.m_hash;
+    if (e1.m_module != e2.m_module) return e1.m_module < e2.m_module;
+    return e1.m_idx < e2.m_idx;
+}
+
+static size_t const_index_size(b_obj_arg index) {
+    return sarray_size(index) / sizeof(const_index_entry);
+}
+
+static const_index_entry const * const_index_begin(b_obj_arg index) {
+    return reinterpret_cast<const_index_entry const *>(sarray_cptr(index));
+}
+
+static obj_res mk_const_index(std::vector<const_index_entry> const & entries) {
+    size_t sz = entries.size() * sizeof(const_index_entry);
+    object * r = alloc_sarray(1, sz, sz);
+    memcpy(sarray_cptr(r), entries.data(), sz);
+    return r;
+}
+
+static void add_const_index_entries(b_obj_arg const_names, unsigned module, std::vector<const_index_entry> & entries) {
+    for (size_t i = 0; i < array_size(const_names); i++)
+        entries.push_back({ lean_name_hash(array_get(const_names, i)), module, static_cast<unsigned>(i) });
+}
+
+/* The fields of `ModuleData` used by the constant index */
+static b_obj_res module_data_const_names(b_obj_arg mod) { return cnstr_get(mod, 1); }
+static b_obj_res module_data_constants(b_obj_arg mod) { return cnstr_get(mod, 2); }
+/* Return `ModuleData.constIndex`, or `nullptr` if `mod` was created by a version of Lean without constant indices. */
+static b_obj_res module_data_const_index(b_obj_arg mod) {
+    if (lean_ctor_num_objs(mod) < 6)
+        return nullptr;
+    object * index = cnstr_get(mod, 5);
+    if (const_index_size(index) != array_size(module_data_const_names(mod)))
+        return nullptr;
+    return index;
+}
+
+/* mkConstIndex (constNames : @& Array Name) : ByteArray */
+extern "C" LEAN_EXPORT obj_res lean_mk_const_index(b_obj_arg const_names) {
+    std::vector<const_index_entry> entries;
+    entries.reserve(array_size(const_names));
+    add_const_index_entries(const_names, 0, entries);
+    std::sort(entries.begin(), entries.end());
+    return mk_const_index(entries);
+}
+
+/* Position in the constant index of an imported module, see `lean_mk_imported_const_index` */
+struct const_index_cursor {
+    const_index_entry const * m_it;
+    const_index_entry const * m_end;
+    unsigned                  m_module;
+    const_index_entry entry() const { return { m_it->m_hash, m_module, m_it->m_idx }; }
+    // reversed for `std::push_heap`, which creates a max-heap
+    bool operator<(const_index_cursor const & c) const { return c.entry() < entry(); }
+};
+
+static bool const_index_entry_name_eq(b_obj_arg mods, const_index_entry const & e, b_obj_arg n) {
+    object * mod = array_get(mods, e.m_module);
+    return lean_name_eq(array_get(module_data_const_names(mod), e.m_idx), n);
+}
+
+/* mkImportedConstIndex (mods : @& Array ModuleData) : Except (ModuleIdx × Nat) ByteArray
+
+   Merge the constant indices of `mods`. If a constant is declared by two modules, return the index of the second
+   module and the position of the constant in it. */
+extern "C" LEAN_EXPORT obj_res lean_mk_imported_const_index(b_obj_arg mods) {
+    size_t num_mods   = array_size(mods);
+    size_t num_consts = 0;
+    std::vector<const_index_cursor> heap;
+    // indices of modules written by previous versions of Lean
+    std::vector<std::vector<const_index_entry>> tmp_indices;
+    for (size_t i = 0; i < num_mods; i++) {
+        object * mod = array_get(mods, i);
+        const_index_cursor c;
+        c.m_module = i;
+        if (object * index = module_data_const_index(mod)) {
+            c.m_it  = const_index_begin(index);
+            c.m_end = c.m_it + const_index_size(index);
+        } else {
+            tmp_indices.emplace_back();
+            add_const_index_entries(module_data_const_names(mod), 0, tmp_indices.back());
+            std::sort(tmp_indices.back().begin(), tmp_indices.back().end());
+            c.m_it  = tmp_indices.back().data();
+            c.m_end = c.m_it + tmp_indices.back().size();
+        }
+        num_consts += c.m_end - c.m_it;
+        if (c.m_it != c.m_end)
+            heap.push_back(c);
+    }
+    std::make_heap(heap.begin(), heap.end());
+    std::vector<const_index_entry> entries;
+    entries.reserve(num_consts);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        const_index_cursor & c = heap.back();
+        const_index_entry e = c.entry();
+        /* Entries with the same hash are sorted by module, so the first module declaring a constant comes first.
+           Names are only compared on hash collisions. */
+        for (size_t j = entries.size(); j > 0 && entries[j-1].m_hash == e.m_hash; j--) {
+            if (const_index_entry_name_eq(mods, entries[j-1], array_get(module_data_const_names(array_get(mods, e.m_module)), e.m_idx))) {
+                object * p = alloc_cnstr(0, 2, 0);
+                cnstr_set(p, 0, usize_to_nat(e.m_module));
+                cnstr_set(p, 1, usize_to_nat(e.m_idx));
+                object * r = alloc_cnstr(0, 1, 0);
+                cnstr_set(r, 0, p);
+                return r;
+            }
+        }
+        entries.push_back(e);
+        c.m_it++;
+        if (c.m_it == c.m_end)
+            heap.pop_back();
+        else
+            std::push_heap(heap.begin(), heap.end());
+    }
+    object * r = alloc_cnstr(1, 1, 0);
+    cnstr_set(r, 0, mk_const_index(entries));
+    return r;
+}
+
+/* Return the entry of `n` in the merged constant index, or `nullptr` if `n` was not imported. */
+static const_index_entry const * find_imported_const(b_obj_arg index, b_obj_arg mods, b_obj_arg n) {
+    const_index_entry const * begin = const_index_begin(index);
+    const_index_entry const * end   = begin + const_index_size(index);
+    uint64 h = lean_name_hash(n);
+    const_index_entry const * it = std::lower_bound(begin, end, h, [](const_index_entry const & e, uint64 h) { return e.m_hash < h; });
+    for (; it != end && it->m_hash == h; it++) {
+        if (const_index_entry_name_eq(mods, *it, n))
+            return it;
+    }
+    return nullptr;
+}
+
+/* findImportedConst? (index : @& ByteArray) (mods : @& Array ModuleData) (n : @& Name) : Option ConstantInfo */
+extern "C" LEAN_EXPORT obj_res lean_find_imported_const(b_obj_arg index, b_obj_arg mods, b_obj_arg n) {
+    const_index_entry const * e = find_imported_const(index, mods, n);
+    if (!e)
+        return mk_option_none();
+    object * c = array_get(module_data_constants(array_get(mods, e->m_module)), e->m_idx);
+    inc(c);
+    return mk_option_some(c);
+}
+
+/* findImportedConstModuleIdx? (index : @& ByteArray) (mods : @& Array ModuleData) (n : @& Name) : Option ModuleIdx */
+extern "C" LEAN_EXPORT obj_res lean_find_imported_const_module_idx(b_obj_arg index, b_obj_arg mods, b_obj_arg n) {
+    const_index_entry const * e = find_imported_const(index, mods, n);
+    if (!e)
+        return mk_option_none();
+    return mk_option_some(usize_to_nat(e->m_module));
+}
+
+/* Return the hash stored in the header of an .olean file without reading the rest of the file, or `none` if the file
+   does not contain a hash. */
+extern "C" LEAN_EXPORT object * lean_read_module_data_hash(b_obj_arg fname, object *) {
+    std::string olean_fn(string_cstr(fname));
+    std::ifstream in(olean_fn, std::ios_base::binary);
+    if (in.fail()) {
+        return io_result_mk_error((sstream() << "failed to open file '" << olean_fn << "'").str());
+    }
+    olean_header header;
+    if (!read_olean_header(in, header)) {
+        return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
+    }
+    if (!header.m_has_hash) {
+        return io_result_mk_ok(mk_option_none());
+    }
+    object * hash = alloc_cnstr(0, 2, 0);
+    cnstr_set(hash, 0, box_uint64(header.m_hash[0]));
+    cnstr_set(hash, 1, box_uint64(header.m_hash[1]));
+    return io_result_mk_ok(mk_option_some(hash));
+}
+
 /*
-@[export lean.write_module_core]
-def writeModule (env : Environment) (fname : String) : IO Unit := */
-extern "C" object * lean_write_module(object * env, object * fname, object *);
+@[export lean_write_module]
+def writeModule (env : Environment) (fname : System.FilePath) (compress := false) : IO Unit := */
+extern "C" object * lean_write_module(object * env, object * fname, uint8 compress, object *);
 
-void write_module(environment const & env, std::string const & olean_fn) {
-    consume_io_result(lean_write_module(env.to_obj_arg(), mk_string(olean_fn), io_mk_world()));
+void write_module(environment const & env, std::string const & olean_fn, bool compress) {
+    consume_io_result(lean_write_module(env.to_obj_arg(), mk_string(olean_fn), compress, io_mk_world()));
 }
 }
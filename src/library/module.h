@@ -13,6 +13,6 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 #include "kernel/environment.h"
 
 namespace lean {
-/** \brief Store module using \c env. */
-void write_module(environment const & env, std::string const & olean_fn);
+/** \brief Store module using \c env, as a compressed .olean file if \c compress is true. */
+void write_module(environment const & env, std::string const & olean_fn, bool compress = false);
 }
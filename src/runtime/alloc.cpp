@@ -4,11 +4,19 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
-#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <lean/lean.h>
+#if defined(LEAN_WINDOWS)
+#include <windows.h>
+#elif !defined(LEAN_EMSCRIPTEN)
+#include <sys/mman.h>
+#endif
 #include "runtime/thread.h"
 #include "runtime/debug.h"
 #include "runtime/alloc.h"
+#include "runtime/heapprof.h"
 
 #ifdef LEAN_RUNTIME_STATS
 #define LEAN_RUNTIME_STAT_CODE(c) c
@@ -23,53 +31,188 @@ Author: Leonardo de Moura
 #endif
 
 #define LEAN_PAGE_SIZE             8192        // 8 Kb
-#define LEAN_SEGMENT_SIZE          8*1024*1024 // 8 Mb
+#define LEAN_SEGMENT_SIZE          (8*1024*1024) // 8 Mb
 #define LEAN_NUM_SLOTS             (LEAN_MAX_SMALL_OBJECT_SIZE / LEAN_OBJECT_SIZE_DELTA)
-#define LEAN_MAX_TO_EXPORT_OBJS    1024
+#define LEAN_SEGMENT_MAX_PAGES     (LEAN_SEGMENT_SIZE / LEAN_PAGE_SIZE)
+#define LEAN_HUGE_PAGE_SIZE        (2*1024*1024) // 2 Mb
+#define LEAN_MAX_MEDIUM_OBJECT_SIZE (1024*1024) // 1 Mb
+/* Number of medium size classes: 4 classes for each power of two in (LEAN_MAX_SMALL_OBJECT_SIZE, LEAN_MAX_MEDIUM_OBJECT_SIZE] */
+#define LEAN_NUM_MEDIUM_SLOTS      32
+/* Maximum number of objects in a medium page */
+#define LEAN_MEDIUM_PAGE_MAX_OBJS  8
+/* Number of bytes allocated by a heap between checks for whether the heap profiler has been enabled */
+#define LEAN_HEAP_PROFILE_CHECK_INTERVAL (1024*1024)
+/* Default value for `g_release_threshold`, see `lean_set_release_free_memory_threshold` */
+#define LEAN_DEFAULT_RELEASE_THRESHOLD (1u << 24)
 
 LEAN_CASSERT(LEAN_PAGE_SIZE > LEAN_MAX_SMALL_OBJECT_SIZE);
 LEAN_CASSERT(LEAN_SEGMENT_SIZE > LEAN_PAGE_SIZE);
+LEAN_CASSERT(LEAN_SEGMENT_SIZE % LEAN_HUGE_PAGE_SIZE == 0);
+LEAN_CASSERT(LEAN_MAX_SMALL_OBJECT_SIZE == 4096 && LEAN_MAX_MEDIUM_OBJECT_SIZE == LEAN_MAX_SMALL_OBJECT_SIZE << (LEAN_NUM_MEDIUM_SLOTS / 4));
+LEAN_CASSERT(LEAN_SEGMENT_SIZE > 4 * LEAN_MAX_MEDIUM_OBJECT_SIZE);
 
 namespace lean {
 
 #ifdef LEAN_SMALL_ALLOCATOR
 
 namespace allocator {
+/* Huge pages can be used for segments by setting the environment variable `LEAN_HUGE_PAGES` to
+   - `thp`: segments are aligned to `LEAN_HUGE_PAGE_SIZE` and marked with `MADV_HUGEPAGE`, i.e.,
+     the kernel backs them with transparent huge pages when available.
+   - `hugetlb`: segments are allocated with `MAP_HUGETLB`, which requires huge pages to be reserved
+     by the system administrator. If it fails, we fall back to `thp`.
+   Huge pages reduce TLB misses when traversing large object graphs. They are only supported on Linux. */
+enum class huge_pages_mode { none, thp, hugetlb };
+static huge_pages_mode g_huge_pages_mode = huge_pages_mode::none;
+/* Number of segments backed by `MAP_HUGETLB` pages. */
+static atomic<uint64_t> g_num_hugetlb_segments(0);
+/* Number of segments marked with `MADV_HUGEPAGE`. */
+static atomic<uint64_t> g_num_thp_segments(0);
+/* Number of segments for which huge pages were requested but regular pages were used. */
+static atomic<uint64_t> g_num_huge_page_fallbacks(0);
+
 #ifdef LEAN_RUNTIME_STATS
 static atomic<uint64> g_num_alloc(0);
 static atomic<uint64> g_num_small_alloc(0);
 static atomic<uint64> g_num_dealloc(0);
 static atomic<uint64> g_num_small_dealloc(0);
+static atomic<uint64> g_num_medium_alloc(0);
+static atomic<uint64> g_num_medium_dealloc(0);
 static atomic<uint64> g_num_segments(0);
 static atomic<uint64> g_num_pages(0);
-static atomic<uint64> g_num_exports(0);
+static atomic<uint64> g_num_remote_frees(0);
 static atomic<uint64> g_num_recycled_pages(0);
+static atomic<uint64> g_num_freed_pages(0);
+static atomic<uint64> g_num_decommitted_pages(0);
+static atomic<uint64> g_num_released_segments(0);
 struct alloc_stats {
     ~alloc_stats() {
         std::cerr << "num. alloc.:         " << g_num_alloc << "\n";
         std::cerr << "num. small alloc.:   " << g_num_small_alloc << "\n";
         std::cerr << "num. dealloc.:       " << g_num_dealloc << "\n";
         std::cerr << "num. small dealloc.: " << g_num_small_dealloc << "\n";
+        std::cerr << "num. medium alloc.:  " << g_num_medium_alloc << "\n";
+        std::cerr << "num. medium dealloc.: " << g_num_medium_dealloc << "\n";
         std::cerr << "num. segments:       " << g_num_segments << "\n";
         std::cerr << "num. pages:          " << g_num_pages << "\n";
         std::cerr << "num. recycled pages: " << g_num_recycled_pages << "\n";
-        std::cerr << "num. exports:        " << g_num_exports << "\n";
+        std::cerr << "num. remote frees:   " << g_num_remote_frees << "\n";
+        std::cerr << "num. freed pages:    " << g_num_freed_pages << "\n";
+        std::cerr << "num. decommitted pages: " << g_num_decommitted_pages << "\n";
+        std::cerr << "num. released segments: " << g_num_released_segments << "\n";
+        std::cerr << "num. hugetlb segments:  " << g_num_hugetlb_segments << "\n";
+        std::cerr << "num. thp segments:      " << g_num_thp_segments << "\n";
+        std::cerr << "num. huge page fallbacks: " << g_num_huge_page_fallbacks << "\n";
     }
 };
 static alloc_stats g_alloc_stats;
 #endif
 
+/* Number of small allocations after which unused memory of a heap is returned to the OS.
+   See `lean_set_release_free_memory_threshold`. */
+static uint64_t g_release_threshold = LEAN_DEFAULT_RELEASE_THRESHOLD;
+/* Incremented by `lean_release_free_memory` to request all heaps to release their unused memory. */
+static atomic<unsigned> g_release_epoch(0);
+/* The heap profiler samples one allocation every `g_heap_profile_rate` bytes. It is 0 if the profiler is disabled. */
+static atomic<size_t> g_heap_profile_rate(0);
+
+inline char * align_ptr(char * p, size_t a) {
+    return reinterpret_cast<char*>(lean_align(reinterpret_cast<size_t>(p), a));
+}
+
+/* Wrappers for obtaining and returning memory to the OS. */
+static void * os_alloc(size_t sz) {
+#if defined(LEAN_WINDOWS)
+    void * r = VirtualAlloc(nullptr, sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(LEAN_EMSCRIPTEN)
+    void * r = malloc(sz);
+#else
+    void * r = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED) r = nullptr;
+#endif
+    if (r == nullptr) lean_internal_panic_out_of_memory();
+    return r;
+}
+
+static void os_free(void * p, size_t sz) {
+#if defined(LEAN_WINDOWS)
+    VirtualFree(p, 0, MEM_RELEASE);
+#elif defined(LEAN_EMSCRIPTEN)
+    free(p);
+#else
+    munmap(p, sz);
+#endif
+}
+
+/* Allocate memory for a segment. `huge` is set to true if huge pages have been requested for it. */
+static void * os_alloc_segment(bool & huge) {
+    huge = false;
+#if defined(__linux__)
+    if (g_huge_pages_mode == huge_pages_mode::hugetlb) {
+        void * r = mmap(nullptr, LEAN_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (r != MAP_FAILED) {
+            g_num_hugetlb_segments++;
+            huge = true;
+            return r;
+        }
+    }
+    if (g_huge_pages_mode != huge_pages_mode::none) {
+        /* Allocate `LEAN_HUGE_PAGE_SIZE` more bytes than needed, and trim the unaligned prefix and suffix. */
+        size_t sz = LEAN_SEGMENT_SIZE + LEAN_HUGE_PAGE_SIZE;
+        char * r  = static_cast<char*>(os_alloc(sz));
+        char * a  = align_ptr(r, LEAN_HUGE_PAGE_SIZE);
+        if (a > r)
+            munmap(r, a - r);
+        munmap(a + LEAN_SEGMENT_SIZE, (r + sz) - (a + LEAN_SEGMENT_SIZE));
+        if (madvise(a, LEAN_SEGMENT_SIZE, MADV_HUGEPAGE) == 0) {
+            g_num_thp_segments++;
+            huge = true;
+        } else {
+            g_num_huge_page_fallbacks++;
+        }
+        return a;
+    }
+#endif
+    return os_alloc(LEAN_SEGMENT_SIZE);
+}
+
+/* Tell the OS that the contents of the given memory region are not needed anymore.
+   The region remains valid, and it is zero-filled (or keeps its old contents) on next access. */
+static void os_decommit(void * p, size_t sz) {
+#if defined(LEAN_WINDOWS)
+    VirtualAlloc(p, sz, MEM_RESET, PAGE_READWRITE);
+#elif defined(LEAN_EMSCRIPTEN)
+    (void)p; (void)sz;
+#elif defined(__APPLE__)
+    /* On macOS, `MADV_DONTNEED` does not reduce the resident set size. */
+    madvise(p, sz, MADV_FREE);
+#else
+    madvise(p, sz, MADV_DONTNEED);
+#endif
+}
+
 struct heap;
 struct page;
+struct segment;
 struct page_header {
     atomic<heap *>   m_heap;
+    segment *        m_segment;
     page *           m_next;
     page *           m_prev;
     void *           m_free_list;
+    /* Objects of this page deallocated by other threads. It is a lock-free stack:
+       any thread may push, only the owner heap pops (by taking the whole list). */
+    atomic<void *>   m_thread_free;
+    /* Next page in the owner heap's `m_delayed_pages` stack. */
+    page *           m_next_delayed;
     unsigned         m_obj_size;
     unsigned         m_max_free;
     unsigned         m_num_free;
     unsigned         m_slot_idx;
+    /* Number of `LEAN_PAGE_SIZE` blocks used by this page. It is greater than 1 only for medium pages. */
+    unsigned         m_num_pages;
+    /* Number of objects in this page sampled by the heap profiler. It is only modified while holding the profiler lock. */
+    atomic<unsigned> m_num_samples;
     bool             m_in_page_free_list;
 };
 
@@ -85,55 +228,173 @@ struct page {
     bool has_many_free() const { return m_header.m_num_free > m_header.m_max_free / 4; }
     bool in_page_free_list() const { return m_header.m_in_page_free_list; }
     unsigned get_slot_idx() const { return m_header.m_slot_idx; }
+    bool is_medium() const { return m_header.m_slot_idx >= LEAN_NUM_SLOTS; }
     void push_free_obj(void * o);
+    void push_thread_free_obj(void * o);
+    void import_thread_free_objs();
 };
 
-inline char * align_ptr(char * p, size_t a) {
-    return reinterpret_cast<char*>(lean_align(reinterpret_cast<size_t>(p), a));
-}
-
+/* A segment is a block of `LEAN_SEGMENT_SIZE` bytes obtained from the OS.
+   It starts with this header, and the rest is used for pages.
+   Pages are carved from the segment on demand. When all objects in a page are freed,
+   the page is stored in `m_free_pages`, and can be reused for any object size.
+   Medium pages consist of `m_num_pages` contiguous `LEAN_PAGE_SIZE` blocks.
+   The memory of free pages and segments without used pages is eventually returned to the OS,
+   see `heap::release_free_memory`. */
 struct segment {
+    /* All segments of a heap are in a doubly linked list. */
     segment *    m_next{nullptr};
+    segment *    m_prev{nullptr};
+    /* Next segment in the heap `m_free_page_segments` list. */
+    segment *    m_next_free_page_segment{nullptr};
     char *       m_next_page_mem;
-    char         m_data[LEAN_SEGMENT_SIZE];
+    /* Number of pages carved from this segment that are not in `m_free_pages`. */
+    unsigned     m_num_used_pages{0};
+    unsigned     m_num_free_pages{0};
+    /* The memory of the first `m_num_decommitted_pages` pages in `m_free_pages` has been returned to the OS. */
+    unsigned     m_num_decommitted_pages{0};
+    bool         m_in_free_page_segments{false};
+    /* Whether the segment is backed by huge pages. */
+    bool         m_huge_pages{false};
+    /* Value of the owner heap `m_alloc_clock` when a page of this segment was freed for the last time. */
+    uint64_t     m_last_free{0};
+    /* Stack of indices of free pages. */
+    uint16_t     m_free_pages[LEAN_SEGMENT_MAX_PAGES];
+
+    segment() {
+        m_next_page_mem = get_first_page_mem();
+    }
 
     char * get_first_page_mem() {
-        lean_assert(align_ptr(m_data, LEAN_PAGE_SIZE) >= m_data);
-        lean_assert(align_ptr(m_data, LEAN_PAGE_SIZE) > reinterpret_cast<char*>(this));
-        return align_ptr(m_data, LEAN_PAGE_SIZE);
+        return align_ptr(reinterpret_cast<char*>(this + 1), LEAN_PAGE_SIZE);
     }
 
-    segment() {
-        m_next_page_mem = get_first_page_mem();
+    char * get_end() {
+        return reinterpret_cast<char*>(this) + LEAN_SEGMENT_SIZE;
+    }
+
+    bool is_full(unsigned num_pages = 1) {
+        return m_next_page_mem + static_cast<size_t>(num_pages) * LEAN_PAGE_SIZE > get_end();
     }
 
-    bool is_full() const {
-        return m_next_page_mem + LEAN_PAGE_SIZE > m_data + LEAN_SEGMENT_SIZE;
+    page * get_page(unsigned idx) {
+        return reinterpret_cast<page*>(get_first_page_mem() + static_cast<size_t>(idx) * LEAN_PAGE_SIZE);
     }
+
+    unsigned get_page_idx(page * p) {
+        return (reinterpret_cast<char*>(p) - get_first_page_mem()) / LEAN_PAGE_SIZE;
+    }
+
+    page * alloc_page_mem(unsigned num_pages) {
+        lean_assert(!is_full(num_pages));
+        page * p = reinterpret_cast<page*>(m_next_page_mem);
+        m_next_page_mem += static_cast<size_t>(num_pages) * LEAN_PAGE_SIZE;
+        m_num_used_pages += num_pages;
+        return p;
+    }
+
+    void push_free_page(page * p, unsigned num_pages) {
+        lean_assert(m_num_used_pages >= num_pages);
+        unsigned idx = get_page_idx(p);
+        for (unsigned i = 0; i < num_pages; i++) {
+            m_free_pages[m_num_free_pages] = idx + i;
+            m_num_free_pages++;
+        }
+        m_num_used_pages -= num_pages;
+    }
+
+    page * pop_free_page() {
+        lean_assert(m_num_free_pages > 0);
+        m_num_free_pages--;
+        if (m_num_decommitted_pages > m_num_free_pages)
+            m_num_decommitted_pages = m_num_free_pages;
+        m_num_used_pages++;
+        return get_page(m_free_pages[m_num_free_pages]);
+    }
+
+    page * pop_free_pages(unsigned num_pages);
+
+    bool has_committed_free_pages() const {
+        return m_num_decommitted_pages < m_num_free_pages;
+    }
+
+    void decommit_free_pages();
+};
+
+LEAN_CASSERT(sizeof(segment) < LEAN_SEGMENT_SIZE / 64);
+
+/* Statistics of a heap. They are always enabled, and are only updated by the thread owning the heap (or
+   while holding the heap manager mutex if the heap is an orphan). See `lean_get_alloc_stats`.
+   The fast paths only pay one non-atomic increment of a counter in the thread's own heap (`m_num_alloc` or
+   `m_num_dealloc`), do not add more work to them. */
+struct heap_stats {
+    uint64_t m_num_alloc[LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS]{};
+    uint64_t m_num_dealloc[LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS]{};
+    /* Objects bigger than `LEAN_MAX_MEDIUM_OBJECT_SIZE`. Remark: the counters of a heap may be negative
+       when its thread deallocates objects allocated by other threads. */
+    uint64_t m_num_big_alloc{0};
+    uint64_t m_num_big_dealloc{0};
+    int64_t  m_big_live_bytes{0};
+    int64_t  m_num_segments{0};
+    int64_t  m_num_pages{0};
+    uint64_t m_num_remote_frees{0};
 };
 
 struct heap {
+    /* All segments of this heap */
+    segment * m_segments{nullptr};
+    /* Segment used to carve new pages */
     segment * m_curr_segment{nullptr};
+    /* Segments containing free pages */
+    segment * m_free_page_segments{nullptr};
     heap *    m_next_orphan{nullptr};
-    page *    m_curr_page[LEAN_NUM_SLOTS];
-    page *    m_page_free_list[LEAN_NUM_SLOTS];
-    /* Objects that must be sent to other heaps. */
-    void *    m_to_export_list{nullptr};
-    unsigned  m_to_export_list_size{0};
-    mutex     m_mutex; /* for the following fields */
-    /* The following list contains object by this heap that were deallocated
-       by other heaps. */
-    void *    m_to_import_list{nullptr};
+    /* Next heap in the list of all heaps, see `heap_manager::m_heaps`. */
+    heap *    m_next_heap{nullptr};
+    /* The last `LEAN_NUM_MEDIUM_SLOTS` entries are used for medium objects, and their pages are allocated on demand. */
+    page *    m_curr_page[LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS];
+    page *    m_page_free_list[LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS];
+    /* Lock-free stack of pages owned by this heap whose `m_thread_free` list is not empty.
+       A page is pushed by the thread that makes its `m_thread_free` list non-empty, and
+       the whole stack is taken by the owner at `import_objs`. Thus, a page occurs at most once in it. */
+    atomic<page *> m_delayed_pages{nullptr};
     uint64_t  m_heartbeat{0}; /* Counter for implementing "deterministic timeouts". It is currently the number of small allocations */
+    /* Number of small and medium allocations. Unlike `m_heartbeat`, it is never reset, and it is used to decide
+       whether free pages have been idle for `g_release_threshold` allocations. */
+    uint64_t  m_alloc_clock{0};
+    /* Value of `m_alloc_clock` at which `release_free_memory` should be executed again */
+    uint64_t  m_next_release{UINT64_MAX};
+    /* Last value of `g_release_epoch` processed by this heap */
+    unsigned  m_release_epoch{0};
+    heap_stats m_stats;
+    /* Number of bytes to be allocated before the next heap profiler sample */
+    int64_t   m_sample_countdown{LEAN_HEAP_PROFILE_CHECK_INTERVAL};
     void import_objs();
-    void export_objs();
     void alloc_segment();
+    void free_segment(segment * s);
+    page * alloc_page_mem(segment * & s, unsigned num_pages);
+    void free_page(page * p);
+    void schedule_release(uint64_t when) {
+        if (g_release_threshold > 0 && when < m_next_release)
+            m_next_release = when;
+    }
+    void release_free_memory(bool force);
+    bool should_release_free_memory() const {
+        return m_alloc_clock >= m_next_release || m_release_epoch != g_release_epoch;
+    }
 };
 
 struct heap_manager {
     /* The mutex protects the list of orphan segments. */
     mutex             m_mutex;
     heap *            m_orphans{nullptr};
+    /* All heaps ever created. Remark: heaps are never deleted, they are reused after their thread finishes. */
+    heap *            m_heaps{nullptr};
+
+    void register_heap(heap * h) {
+        lock_guard<mutex> lock(m_mutex);
+        h->m_next_heap = m_heaps;
+        m_heaps = h;
+    }
 
     void push_orphan(heap * h) {
         /* TODO(Leo): avoid mutex */
@@ -153,12 +414,33 @@ struct heap_manager {
             return nullptr;
         }
     }
+
+    void release_orphans_free_memory() {
+        /* Remark: orphan heaps are not owned by any thread. Other threads may only push
+           objects into their `m_delayed_pages` stacks, which is safe. */
+        lock_guard<mutex> lock(m_mutex);
+        for (heap * h = m_orphans; h != nullptr; h = h->m_next_orphan) {
+            h->release_free_memory(true);
+        }
+    }
 };
 
 static inline page * get_page_of(void * o) {
     return reinterpret_cast<page*>((reinterpret_cast<size_t>(o)/LEAN_PAGE_SIZE)*LEAN_PAGE_SIZE);
 }
 
+/* Medium objects span multiple `LEAN_PAGE_SIZE` blocks, so their page cannot be obtained
+   by masking their address. Instead, each medium object is preceded by a pointer to its page. */
+#define LEAN_MEDIUM_OBJECT_HEADER_SIZE sizeof(page *)
+
+static inline page * get_medium_page_of(void * o) {
+    return *(reinterpret_cast<page**>(o) - 1);
+}
+
+static inline bool page_contains(page * p, void * o) {
+    return p->is_medium() ? get_medium_page_of(o) == p : get_page_of(o) == p;
+}
+
 LEAN_THREAD_GLOBAL_PTR(page *, g_curr_pages);
 LEAN_THREAD_PTR(heap, g_heap);
 static heap_manager * g_heap_manager = nullptr;
@@ -175,37 +457,46 @@ static inline void page_list_insert(page * & head, page * new_head) {
     if (head)
         head->set_prev(new_head);
     new_head->set_next(head);
+    new_head->set_prev(nullptr);
     head = new_head;
 }
 
 static inline void page_list_remove(page * & head, page * to_remove) {
-    if (head == to_remove) {
-        /* First element */
-        head = to_remove->get_next();
-    }
     page * prev = to_remove->get_prev();
-    lean_assert(prev);
-    if (page * next = to_remove->get_next()) {
+    page * next = to_remove->get_next();
+    if (prev) {
         prev->set_next(next);
-        next->set_prev(prev);
     } else {
-        /* Last element */
-        prev->set_next(nullptr);
+        /* First element */
+        lean_assert(head == to_remove);
+        head = next;
     }
+    if (next)
+        next->set_prev(prev);
 }
 
 static inline page * page_list_pop(page * & head) {
     lean_assert(head);
     page * r = head;
     head = head->get_next();
+    if (head)
+        head->set_prev(nullptr);
     return r;
 }
 
 void page::push_free_obj(void * o) {
-    lean_assert(get_page_of(o) == this);
+    lean_assert(page_contains(this, o));
     set_next_obj(o, m_header.m_free_list);
     m_header.m_free_list = o;
     m_header.m_num_free++;
+    if (LEAN_UNLIKELY(m_header.m_num_free == m_header.m_max_free)) {
+        /* All objects in this page are free. Remark: we never free the page objects are being allocated from. */
+        heap * h = get_heap();
+        if (this != h->m_curr_page[m_header.m_slot_idx]) {
+            h->free_page(this);
+            return;
+        }
+    }
     if (!in_page_free_list() && has_many_free()) {
         heap * h = get_heap();
         unsigned slot_idx = m_header.m_slot_idx;
@@ -218,79 +509,291 @@ void page::push_free_obj(void * o) {
     }
 }
 
-void heap::import_objs() {
-    void * to_import = nullptr;
-    {   // TODO(Leo): avoid mutex using compare and swap
-        lock_guard<mutex> lock(m_mutex);
-        to_import = m_to_import_list;
-        m_to_import_list = nullptr;
+/* Executed by a thread that does not own this page.
+   This is similar to the "delayed free" lists used in mimalloc: the object is pushed
+   into the page `m_thread_free` stack, and if the stack was empty, the page itself is pushed
+   into the owner heap `m_delayed_pages` stack. No locks are used. */
+LEAN_NOINLINE
+void page::push_thread_free_obj(void * o) {
+    lean_assert(page_contains(this, o));
+    LEAN_RUNTIME_STAT_CODE(g_num_remote_frees++);
+    void * head = m_header.m_thread_free.load();
+    do {
+        set_next_obj(o, head);
+    } while (!m_header.m_thread_free.compare_exchange_strong(head, o));
+    if (head == nullptr) {
+        /* `m_thread_free` was empty. Thus, this page is not in the owner's `m_delayed_pages`,
+           and we are the only thread that may push it there. */
+        heap * h = get_heap();
+        page * next = h->m_delayed_pages.load();
+        do {
+            m_header.m_next_delayed = next;
+        } while (!h->m_delayed_pages.compare_exchange_strong(next, this));
     }
-    while (to_import) {
-        page * p = get_page_of(to_import);
-        void * n = get_next_obj(to_import);
-        p->push_free_obj(to_import);
-        to_import = n;
+}
+
+/* Executed by the owner of this page. */
+void page::import_thread_free_objs() {
+    void * o = m_header.m_thread_free.exchange(nullptr);
+    while (o) {
+        void * n = get_next_obj(o);
+        push_free_obj(o);
+        o = n;
     }
 }
 
-struct export_entry {
-    heap * m_heap;
-    void * m_head;
-    void * m_tail;
-};
+void heap::import_objs() {
+    page * p = m_delayed_pages.exchange(nullptr);
+    while (p) {
+        /* Remark: we must read `m_next_delayed` before emptying `m_thread_free`,
+           since another thread may push `p` again as soon as `m_thread_free` is empty. */
+        page * n = p->m_header.m_next_delayed;
+        p->import_thread_free_objs();
+        p = n;
+    }
+}
 
-void heap::export_objs() {
-    std::vector<export_entry> to_export;
-    void * o = m_to_export_list;
-    while (o != nullptr) {
-        void * n   = get_next_obj(o);
-        heap * h   = get_page_of(o)->get_heap();
-        bool found = false;
-        for (export_entry & e : to_export) {
-            if (e.m_heap == h) {
-                set_next_obj(o, e.m_head);
-                e.m_head = o;
-                found = true;
-                break;
-            }
+void segment::decommit_free_pages() {
+    if (!has_committed_free_pages())
+        return;
+    /* Sort the pages that have not been decommitted yet to return contiguous pages to the OS using a single call. */
+    uint16_t * begin = m_free_pages + m_num_decommitted_pages;
+    uint16_t * end   = m_free_pages + m_num_free_pages;
+    std::sort(begin, end);
+    uint16_t * it    = begin;
+    while (it != end) {
+        uint16_t * run_end = it + 1;
+        while (run_end != end && *run_end == *(run_end - 1) + 1)
+            run_end++;
+        char * run_mem_begin = reinterpret_cast<char*>(get_page(*it));
+        char * run_mem_end   = run_mem_begin + static_cast<size_t>(run_end - it) * LEAN_PAGE_SIZE;
+        if (m_huge_pages) {
+            /* Decommitting part of a huge page would split it. So, we only decommit whole huge pages. */
+            run_mem_begin = align_ptr(run_mem_begin, LEAN_HUGE_PAGE_SIZE);
+            run_mem_end   = reinterpret_cast<char*>((reinterpret_cast<size_t>(run_mem_end) / LEAN_HUGE_PAGE_SIZE) * LEAN_HUGE_PAGE_SIZE);
         }
-        if (!found) {
-            set_next_obj(o, nullptr);
-            to_export.push_back(export_entry{h, o, o});
+        if (run_mem_begin < run_mem_end) {
+            LEAN_RUNTIME_STAT_CODE(g_num_decommitted_pages += (run_mem_end - run_mem_begin) / LEAN_PAGE_SIZE);
+            os_decommit(run_mem_begin, run_mem_end - run_mem_begin);
         }
-        o = n;
+        it = run_end;
     }
-    m_to_export_list      = nullptr;
-    m_to_export_list_size = 0;
-    for (export_entry const & e : to_export) {
-        unique_lock<mutex> lock(e.m_heap->m_mutex);
-        set_next_obj(e.m_tail, e.m_heap->m_to_import_list);
-        e.m_heap->m_to_import_list = e.m_head;
+    m_num_decommitted_pages = m_num_free_pages;
+}
+
+/* Remove `num_pages` contiguous pages from `m_free_pages`, and return the first one.
+   Return `nullptr` if there is no such run. */
+page * segment::pop_free_pages(unsigned num_pages) {
+    if (num_pages == 1)
+        return pop_free_page();
+    if (m_num_free_pages < num_pages)
+        return nullptr;
+    std::sort(m_free_pages, m_free_pages + m_num_free_pages);
+    /* After sorting, we do not know anymore which free pages have been decommitted.
+       Remark: decommitting a page twice is harmless. */
+    m_num_decommitted_pages = 0;
+    unsigned begin = 0;
+    for (unsigned i = 1; i <= m_num_free_pages; i++) {
+        if (i == m_num_free_pages || m_free_pages[i] != m_free_pages[i-1] + 1) {
+            begin = i;
+        } else if (i + 1 - begin == num_pages) {
+            page * p = get_page(m_free_pages[begin]);
+            std::copy(m_free_pages + i + 1, m_free_pages + m_num_free_pages, m_free_pages + begin);
+            m_num_free_pages -= num_pages;
+            m_num_used_pages += num_pages;
+            return p;
+        }
     }
+    return nullptr;
 }
 
 void heap::alloc_segment() {
     LEAN_RUNTIME_STAT_CODE(g_num_segments++);
-    segment * s = new segment();
-    s->m_next   = m_curr_segment;
+    m_stats.m_num_segments++;
+    bool huge;
+    segment * s = new (os_alloc_segment(huge)) segment();
+    s->m_huge_pages = huge;
+    s->m_next   = m_segments;
+    if (m_segments)
+        m_segments->m_prev = s;
+    m_segments     = s;
     m_curr_segment = s;
 }
 
-static page * alloc_page(heap * h, unsigned obj_size) {
-    lean_assert(lean_align(obj_size, LEAN_OBJECT_SIZE_DELTA) == obj_size);
-    segment * s = h->m_curr_segment;
-    LEAN_RUNTIME_STAT_CODE(g_num_pages++);
-    page * p    = new (s->m_next_page_mem) page();
-    s->m_next_page_mem += LEAN_PAGE_SIZE;
-    if (s->is_full()) {
-        /* s is full, we need to allocate a new one. */
-        h->alloc_segment();
+void heap::free_segment(segment * s) {
+    lean_assert(s != m_curr_segment);
+    lean_assert(s->m_num_used_pages == 0);
+    LEAN_RUNTIME_STAT_CODE(g_num_released_segments++);
+    m_stats.m_num_segments--;
+    if (s->m_prev)
+        s->m_prev->m_next = s->m_next;
+    else
+        m_segments = s->m_next;
+    if (s->m_next)
+        s->m_next->m_prev = s->m_prev;
+    s->~segment();
+    os_free(s, LEAN_SEGMENT_SIZE);
+}
+
+/* Return the memory for a new page of `num_pages` contiguous blocks, and store its segment in `s`.
+   Free pages are preferred over carving a new page from `m_curr_segment`. */
+page * heap::alloc_page_mem(segment * & s, unsigned num_pages) {
+    if (LEAN_UNLIKELY(should_release_free_memory())) {
+        release_free_memory(m_release_epoch != g_release_epoch);
+    }
+    segment * prev = nullptr;
+    s = m_free_page_segments;
+    while (s != nullptr) {
+        page * p = s->pop_free_pages(num_pages);
+        if (s->m_num_free_pages == 0) {
+            segment * next = s->m_next_free_page_segment;
+            if (prev)
+                prev->m_next_free_page_segment = next;
+            else
+                m_free_page_segments = next;
+            s->m_in_free_page_segments = false;
+            if (p == nullptr) {
+                s = next;
+                continue;
+            }
+        }
+        if (p != nullptr)
+            return p;
+        prev = s;
+        s    = s->m_next_free_page_segment;
+    }
+    if (m_curr_segment->is_full(num_pages)) {
+        alloc_segment();
+    }
+    s = m_curr_segment;
+    return s->alloc_page_mem(num_pages);
+}
+
+/* Remove `p` from the page lists, and store it in the free pages of its segment. */
+void heap::free_page(page * p) {
+    lean_assert(p->m_header.m_num_free == p->m_header.m_max_free);
+    lean_assert(p->m_header.m_thread_free.load() == nullptr);
+    LEAN_RUNTIME_STAT_CODE(g_num_freed_pages++);
+    unsigned slot_idx = p->get_slot_idx();
+    if (p->in_page_free_list())
+        page_list_remove(m_page_free_list[slot_idx], p);
+    else
+        page_list_remove(m_curr_page[slot_idx], p);
+    segment * s = p->m_header.m_segment;
+    m_stats.m_num_pages -= p->m_header.m_num_pages;
+    s->push_free_page(p, p->m_header.m_num_pages);
+    s->m_last_free = m_alloc_clock;
+    if (!s->m_in_free_page_segments) {
+        s->m_in_free_page_segments   = true;
+        s->m_next_free_page_segment  = m_free_page_segments;
+        m_free_page_segments         = s;
+    }
+    schedule_release(m_alloc_clock + g_release_threshold);
+}
+
+/* Return the memory of free pages and segments without used pages to the OS.
+   If `force == false`, then only the memory of segments where no page has been freed
+   in the last `g_release_threshold` allocations is released. */
+void heap::release_free_memory(bool force) {
+    m_release_epoch      = g_release_epoch;
+    m_next_release       = UINT64_MAX;
+    if (force) {
+        import_objs();
+        /* The current page of a medium slot is not freed when it becomes empty, but it may be big. */
+        for (unsigned i = LEAN_NUM_SLOTS; i < LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS; i++) {
+            page * p = m_curr_page[i];
+            if (p != nullptr && p->m_header.m_num_free == p->m_header.m_max_free)
+                free_page(p);
+        }
+    }
+    /* `m_free_page_segments` is reconstructed while traversing all segments */
+    m_free_page_segments = nullptr;
+    segment * s = m_segments;
+    while (s != nullptr) {
+        segment * next = s->m_next;
+        bool idle = force || (g_release_threshold > 0 && m_alloc_clock - s->m_last_free >= g_release_threshold);
+        s->m_in_free_page_segments = false;
+        if (s->m_num_used_pages == 0 && s != m_curr_segment) {
+            if (idle) {
+                free_segment(s);
+                s = next;
+                continue;
+            }
+            schedule_release(s->m_last_free + g_release_threshold);
+        }
+        if (idle)
+            s->decommit_free_pages();
+        else if (s->has_committed_free_pages())
+            schedule_release(s->m_last_free + g_release_threshold);
+        if (s->m_num_free_pages > 0) {
+            s->m_in_free_page_segments  = true;
+            s->m_next_free_page_segment = m_free_page_segments;
+            m_free_page_segments        = s;
+        }
+        s = next;
     }
-    unsigned slot_idx        = lean_get_slot_idx(obj_size);
+}
+
+/* Medium size classes: each power of two interval (2^k, 2^(k+1)] is split into 4 classes.
+   Thus, the internal fragmentation is at most 25%. */
+static inline unsigned get_medium_slot_idx(size_t sz) {
+    lean_assert(sz > LEAN_MAX_SMALL_OBJECT_SIZE && sz <= LEAN_MAX_MEDIUM_OBJECT_SIZE);
+    size_t s   = sz - 1;
+    unsigned k = 12; /* log2(LEAN_MAX_SMALL_OBJECT_SIZE) */
+    while ((s >> (k + 1)) != 0)
+        k++;
+    unsigned sub = (s >> (k - 2)) & 3;
+    return LEAN_NUM_SLOTS + (k - 12) * 4 + sub;
+}
+
+static inline unsigned get_medium_obj_size(unsigned slot_idx) {
+    lean_assert(slot_idx >= LEAN_NUM_SLOTS && slot_idx < LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS);
+    unsigned i = slot_idx - LEAN_NUM_SLOTS;
+    return (5 + i % 4) << (i / 4 + 10);
+}
+
+/* Number of `LEAN_PAGE_SIZE` blocks used by pages of the given medium size class. */
+static inline unsigned get_medium_num_pages(unsigned obj_size) {
+    unsigned num_objs = std::max(1u, std::min(static_cast<unsigned>(LEAN_MEDIUM_PAGE_MAX_OBJS), LEAN_MAX_MEDIUM_OBJECT_SIZE / obj_size));
+    size_t sz = sizeof(page_header) + num_objs * (obj_size + LEAN_MEDIUM_OBJECT_HEADER_SIZE);
+    return (sz + LEAN_PAGE_SIZE - 1) / LEAN_PAGE_SIZE;
+}
+
+static page * alloc_page(heap * h, unsigned slot_idx) {
+    LEAN_RUNTIME_STAT_CODE(g_num_pages++);
+    bool medium              = slot_idx >= LEAN_NUM_SLOTS;
+    unsigned obj_size        = medium ? get_medium_obj_size(slot_idx) : (slot_idx + 1) * LEAN_OBJECT_SIZE_DELTA;
+    unsigned num_pages       = medium ? get_medium_num_pages(obj_size) : 1;
+    segment * s;
+    page * p    = new (h->alloc_page_mem(s, num_pages)) page();
     p->m_header.m_heap       = h;
+    p->m_header.m_segment    = s;
     page_list_insert(h->m_curr_page[slot_idx], p);
     p->m_header.m_slot_idx   = slot_idx;
     p->m_header.m_obj_size   = obj_size;
+    p->m_header.m_num_pages  = num_pages;
+    h->m_stats.m_num_pages  += num_pages;
+    p->m_header.m_thread_free = nullptr;
+    p->m_header.m_next_delayed = nullptr;
+    if (medium) {
+        char * end      = reinterpret_cast<char*>(p) + static_cast<size_t>(num_pages) * LEAN_PAGE_SIZE;
+        unsigned stride = obj_size + LEAN_MEDIUM_OBJECT_HEADER_SIZE;
+        void * free_list  = nullptr;
+        unsigned num_free = 0;
+        for (char * it = p->m_data; it + stride <= end; it += stride) {
+            *reinterpret_cast<page**>(it) = p;
+            void * o = it + LEAN_MEDIUM_OBJECT_HEADER_SIZE;
+            set_next_obj(o, free_list);
+            free_list = o;
+            num_free++;
+        }
+        lean_assert(num_free > 0);
+        p->m_header.m_free_list  = free_list;
+        p->m_header.m_max_free   = num_free;
+        p->m_header.m_num_free   = num_free;
+        p->m_header.m_in_page_free_list = false;
+        return p;
+    }
     char * curr_free         = p->m_data;
     set_next_obj(curr_free, nullptr);
     char * end               = p->m_data + (LEAN_PAGE_SIZE - sizeof(page_header));
@@ -323,7 +826,6 @@ static page * alloc_page(heap * h, unsigned obj_size) {
 
 static void finalize_heap(void * _h) {
     heap * h = static_cast<heap*>(_h);
-    h->export_objs();
     h->import_objs();
     g_heap_manager->push_orphan(h);
 }
@@ -336,18 +838,17 @@ static void init_heap(bool main) {
         g_heap = h;
     } else {
         g_heap = new heap();
+        g_heap_manager->register_heap(g_heap);
         g_curr_pages = g_heap->m_curr_page;
-        for (unsigned i = 0; i < LEAN_NUM_SLOTS; i++) {
+        for (unsigned i = 0; i < LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS; i++) {
             g_heap->m_curr_page[i] = nullptr;
             g_heap->m_page_free_list[i] = nullptr;
         }
         g_heap->alloc_segment();
-        unsigned obj_size = LEAN_OBJECT_SIZE_DELTA;
         for (unsigned i = 0; i < LEAN_NUM_SLOTS; i++) {
             if (g_heap->m_curr_page[i] == nullptr) {
-                alloc_page(g_heap, obj_size);
+                alloc_page(g_heap, i);
             }
-            obj_size += LEAN_OBJECT_SIZE_DELTA;
         }
     }
     if (!main)
@@ -360,37 +861,87 @@ void init_thread_heap() {
     init_heap(false);
 }
 
-LEAN_NOINLINE
-void * lean_alloc_small_cold(unsigned sz, unsigned slot_idx, page * p) {
-    if (g_heap->m_page_free_list[slot_idx] == nullptr) {
-        g_heap->import_objs();
-        lean_assert(g_heap->m_curr_page[slot_idx] == p);
-        /* g_heap->import_objs() may add objects to p->m_header.m_free_list */
-        if (p->m_header.m_free_list == nullptr)
-            p = alloc_page(g_heap, sz);
-    } else {
-        p = page_list_pop(g_heap->m_page_free_list[slot_idx]);
-        p->m_header.m_in_page_free_list = false;
-        page_list_insert(g_heap->m_curr_page[slot_idx], p);
+/* Slow path for allocating an object in the given slot. `p` is the current page of the slot,
+   and it is `nullptr` for medium slots that have not been used yet. */
+static void * alloc_cold(heap * h, unsigned slot_idx, page * p) {
+    if (h->m_page_free_list[slot_idx] == nullptr) {
+        h->import_objs();
+        lean_assert(h->m_curr_page[slot_idx] == p);
+    }
+    /* h->import_objs() may add objects to p->m_header.m_free_list */
+    if (p == nullptr || p->m_header.m_free_list == nullptr) {
+        if (h->m_page_free_list[slot_idx] == nullptr) {
+            p = alloc_page(h, slot_idx);
+        } else {
+            p = page_list_pop(h->m_page_free_list[slot_idx]);
+            p->m_header.m_in_page_free_list = false;
+            page_list_insert(h->m_curr_page[slot_idx], p);
+        }
     }
     void * r = p->m_header.m_free_list;
     lean_assert(r);
     p->m_header.m_free_list = get_next_obj(r);
     p->m_header.m_num_free--;
-    lean_assert(get_page_of(r) == p);
+    lean_assert(page_contains(p, r));
+    return r;
+}
+
+LEAN_NOINLINE
+void * lean_alloc_small_cold(unsigned, unsigned slot_idx, page * p) {
+    return alloc_cold(g_heap, slot_idx, p);
+}
+
+namespace allocator {
+/* Executed when `h->m_sample_countdown` becomes negative after allocating the object `o` of size `sz` in page `p`.
+   `p` is `nullptr` if `o` was allocated using `malloc`. */
+LEAN_NOINLINE
+void sample_alloc(heap * h, void * o, size_t sz, page * p) {
+    size_t rate = g_heap_profile_rate;
+    if (rate == 0) {
+        h->m_sample_countdown = LEAN_HEAP_PROFILE_CHECK_INTERVAL;
+        return;
+    }
+    h->m_sample_countdown = rate;
+    heap_profiler_sample(o, sz, p ? &p->m_header.m_num_samples : nullptr);
+}
+}
+
+static void * alloc_medium(size_t sz) {
+    LEAN_RUNTIME_STAT_CODE(g_num_medium_alloc++);
+    unsigned slot_idx = get_medium_slot_idx(sz);
+    page * p = g_heap->m_curr_page[slot_idx];
+    /* `m_heartbeat` only counts small allocations, see `maxHeartbeats` */
+    g_heap->m_alloc_clock++;
+    g_heap->m_stats.m_num_alloc[slot_idx]++;
+    void * r;
+    if (LEAN_UNLIKELY(p == nullptr || p->m_header.m_free_list == nullptr)) {
+        r = alloc_cold(g_heap, slot_idx, p);
+    } else {
+        r = p->m_header.m_free_list;
+        p->m_header.m_free_list = get_next_obj(r);
+        p->m_header.m_num_free--;
+        lean_assert(get_medium_page_of(r) == p);
+    }
+    if (LEAN_UNLIKELY((g_heap->m_sample_countdown -= sz) < 0))
+        sample_alloc(g_heap, r, sz, get_medium_page_of(r));
     return r;
 }
 
 extern "C" LEAN_EXPORT void * lean_alloc_small(unsigned sz, unsigned slot_idx) {
     page * p = g_heap->m_curr_page[slot_idx];
     g_heap->m_heartbeat++;
+    g_heap->m_alloc_clock++;
+    g_heap->m_stats.m_num_alloc[slot_idx]++;
     void * r = p->m_header.m_free_list;
     if (LEAN_UNLIKELY(r == nullptr)) {
-        return lean_alloc_small_cold(sz, slot_idx, p);
+        r = lean_alloc_small_cold(sz, slot_idx, p);
+    } else {
+        p->m_header.m_free_list = get_next_obj(r);
+        p->m_header.m_num_free--;
+        lean_assert(get_page_of(r) == p);
     }
-    p->m_header.m_free_list = get_next_obj(r);
-    p->m_header.m_num_free--;
-    lean_assert(get_page_of(r) == p);
+    if (LEAN_UNLIKELY((g_heap->m_sample_countdown -= sz) < 0))
+        sample_alloc(g_heap, r, sz, get_page_of(r));
     return r;
 }
 
@@ -398,8 +949,18 @@ void * alloc(size_t sz) {
     sz = lean_align(sz, LEAN_OBJECT_SIZE_DELTA);
     LEAN_RUNTIME_STAT_CODE(g_num_alloc++);
     if (LEAN_UNLIKELY(sz > LEAN_MAX_SMALL_OBJECT_SIZE)) {
+        if (sz <= LEAN_MAX_MEDIUM_OBJECT_SIZE) {
+            lean_assert(g_heap);
+            return alloc_medium(sz);
+        }
         void * r = malloc(sz);
         if (r == nullptr) lean_internal_panic_out_of_memory();
+        if (g_heap) {
+            g_heap->m_stats.m_num_big_alloc++;
+            g_heap->m_stats.m_big_live_bytes += sz;
+            if (LEAN_UNLIKELY((g_heap->m_sample_countdown -= sz) < 0))
+                sample_alloc(g_heap, r, sz, nullptr);
+        }
         return r;
     }
     lean_assert(g_heap);
@@ -408,35 +969,41 @@ void * alloc(size_t sz) {
     return lean_alloc_small(sz, slot_idx);
 }
 
-LEAN_NOINLINE
-static void dealloc_small_core_cold(void * o) {
-    set_next_obj(o, g_heap->m_to_export_list);
-    g_heap->m_to_export_list = o;
-    g_heap->m_to_export_list_size++;
-    if (g_heap->m_to_export_list_size > LEAN_MAX_TO_EXPORT_OBJS) {
-        LEAN_RUNTIME_STAT_CODE(g_num_exports++);
-        g_heap->export_objs();
-    }
-}
-
-static inline void dealloc_small_core(void * o) {
-    LEAN_RUNTIME_STAT_CODE(g_num_small_dealloc++);
+static inline void dealloc_core(void * o, page * p) {
     if (LEAN_UNLIKELY(g_heap == nullptr)) {
         init_heap(false);
     }
     lean_assert(g_heap);
-    page * p = get_page_of(o);
+    g_heap->m_stats.m_num_dealloc[p->get_slot_idx()]++;
+    if (LEAN_UNLIKELY(p->m_header.m_num_samples.load() != 0))
+        heap_profiler_free(o, &p->m_header.m_num_samples);
     if (LEAN_LIKELY(p->get_heap() == g_heap)) {
         p->push_free_obj(o);
     } else {
-        dealloc_small_core_cold(o);
+        g_heap->m_stats.m_num_remote_frees++;
+        p->push_thread_free_obj(o);
     }
 }
 
+static inline void dealloc_small_core(void * o) {
+    LEAN_RUNTIME_STAT_CODE(g_num_small_dealloc++);
+    dealloc_core(o, get_page_of(o));
+}
+
 void dealloc(void * o, size_t sz) {
     LEAN_RUNTIME_STAT_CODE(g_num_dealloc++);
     sz = lean_align(sz, LEAN_OBJECT_SIZE_DELTA);
     if (LEAN_UNLIKELY(sz > LEAN_MAX_SMALL_OBJECT_SIZE)) {
+        if (sz <= LEAN_MAX_MEDIUM_OBJECT_SIZE) {
+            LEAN_RUNTIME_STAT_CODE(g_num_medium_dealloc++);
+            return dealloc_core(o, get_medium_page_of(o));
+        }
+        if (g_heap) {
+            g_heap->m_stats.m_num_big_dealloc++;
+            g_heap->m_stats.m_big_live_bytes -= sz;
+        }
+        if (LEAN_UNLIKELY(g_heap_profile_rate.load() != 0))
+            heap_profiler_free(o, nullptr);
         return free(o);
     }
     dealloc_small_core(o);
@@ -453,8 +1020,111 @@ extern "C" LEAN_EXPORT unsigned lean_small_mem_size(void * o) {
 
 #endif
 
+extern "C" LEAN_EXPORT void lean_release_free_memory() {
+#ifdef LEAN_SMALL_ALLOCATOR
+    /* Other heaps are owned by other threads, we just ask them to release their free memory
+       the next time they need a new page. */
+    g_release_epoch++;
+    if (g_heap)
+        g_heap->release_free_memory(true);
+    g_heap_manager->release_orphans_free_memory();
+#endif
+}
+
+extern "C" LEAN_EXPORT void lean_get_huge_page_stats(uint64_t * num_hugetlb, uint64_t * num_thp, uint64_t * num_fallbacks) {
+#ifdef LEAN_SMALL_ALLOCATOR
+    *num_hugetlb   = g_num_hugetlb_segments;
+    *num_thp       = g_num_thp_segments;
+    *num_fallbacks = g_num_huge_page_fallbacks;
+#else
+    *num_hugetlb = *num_thp = *num_fallbacks = 0;
+#endif
+}
+
+extern "C" LEAN_EXPORT unsigned lean_get_alloc_num_slots() {
+#ifdef LEAN_SMALL_ALLOCATOR
+    return LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS;
+#else
+    return 0;
+#endif
+}
+
+extern "C" LEAN_EXPORT unsigned lean_get_alloc_slot_size(unsigned slot_idx) {
+#ifdef LEAN_SMALL_ALLOCATOR
+    if (slot_idx < LEAN_NUM_SLOTS)
+        return (slot_idx + 1) * LEAN_OBJECT_SIZE_DELTA;
+    else if (slot_idx < LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS)
+        return get_medium_obj_size(slot_idx);
+#else
+    (void)slot_idx;
+#endif
+    return 0;
+}
+
+extern "C" LEAN_EXPORT void lean_get_alloc_stats(lean_alloc_stats * r, uint64_t * slot_num_alloc, uint64_t * slot_num_dealloc) {
+    memset(r, 0, sizeof(lean_alloc_stats));
+#ifdef LEAN_SMALL_ALLOCATOR
+    unsigned num_slots = LEAN_NUM_SLOTS + LEAN_NUM_MEDIUM_SLOTS;
+    if (slot_num_alloc)
+        std::fill(slot_num_alloc, slot_num_alloc + num_slots, 0);
+    if (slot_num_dealloc)
+        std::fill(slot_num_dealloc, slot_num_dealloc + num_slots, 0);
+    int64_t live_bytes = 0, num_segments = 0, num_pages = 0;
+    lock_guard<mutex> lock(g_heap_manager->m_mutex);
+    for (heap * h = g_heap_manager->m_heaps; h != nullptr; h = h->m_next_heap) {
+        heap_stats const & s = h->m_stats;
+        for (unsigned i = 0; i < num_slots; i++) {
+            uint64_t obj_size = lean_get_alloc_slot_size(i);
+            r->m_num_alloc   += s.m_num_alloc[i];
+            r->m_num_dealloc += s.m_num_dealloc[i];
+            live_bytes       += static_cast<int64_t>((s.m_num_alloc[i] - s.m_num_dealloc[i]) * obj_size);
+            if (slot_num_alloc)
+                slot_num_alloc[i] += s.m_num_alloc[i];
+            if (slot_num_dealloc)
+                slot_num_dealloc[i] += s.m_num_dealloc[i];
+        }
+        r->m_num_alloc       += s.m_num_big_alloc;
+        r->m_num_dealloc     += s.m_num_big_dealloc;
+        live_bytes           += s.m_big_live_bytes;
+        num_segments         += s.m_num_segments;
+        num_pages            += s.m_num_pages;
+        r->m_num_remote_frees += s.m_num_remote_frees;
+    }
+    r->m_live_bytes   = std::max<int64_t>(live_bytes, 0);
+    r->m_num_segments = std::max<int64_t>(num_segments, 0);
+    r->m_num_pages    = std::max<int64_t>(num_pages, 0);
+#else
+    (void)slot_num_alloc; (void)slot_num_dealloc;
+#endif
+}
+
+void set_heap_profile_rate(size_t rate) {
+#ifdef LEAN_SMALL_ALLOCATOR
+    g_heap_profile_rate = rate;
+#else
+    (void)rate;
+#endif
+}
+
+extern "C" LEAN_EXPORT void lean_set_release_free_memory_threshold(uint64_t n) {
+#ifdef LEAN_SMALL_ALLOCATOR
+    g_release_threshold = n;
+#endif
+}
+
 void initialize_alloc() {
 #ifdef LEAN_SMALL_ALLOCATOR
+#ifndef LEAN_EMSCRIPTEN
+    if (char const * threshold = std::getenv("LEAN_RELEASE_FREE_MEMORY_THRESHOLD")) {
+        g_release_threshold = std::strtoull(threshold, nullptr, 10);
+    }
+    if (char const * mode = std::getenv("LEAN_HUGE_PAGES")) {
+        if (strcmp(mode, "thp") == 0)
+            g_huge_pages_mode = huge_pages_mode::thp;
+        else if (strcmp(mode, "hugetlb") == 0)
+            g_huge_pages_mode = huge_pages_mode::hugetlb;
+    }
+#endif
     g_heap_manager = new heap_manager();
     init_heap(true);
 #endif
@@ -488,4 +1158,13 @@ uint64_t get_num_heartbeats() {
 #endif
 }
 
+void set_num_heartbeats(uint64_t n) {
+#ifdef LEAN_SMALL_ALLOCATOR
+    if (g_heap)
+        g_heap->m_heartbeat = n;
+#else
+    g_heartbeat = n;
+#endif
+}
+
 }
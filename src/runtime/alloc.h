@@ -13,6 +13,9 @@ void init_thread_heap();
 void * alloc(size_t sz);
 void dealloc(void * o, size_t sz);
 uint64_t get_num_heartbeats();
+void set_num_heartbeats(uint64_t n);
+/* Sample one allocation every `rate` bytes for the heap profiler, see `heapprof.h`. */
+void set_heap_profile_rate(size_t rate);
 void initialize_alloc();
 void finalize_alloc();
 }
@@ -9,8 +9,10 @@ Author: Leonardo de Moura
 #include <string>
 #include <vector>
 #include <cstring>
+#include <limits>
 #include <lean/lean.h>
 #include "runtime/hash.h"
+#include "runtime/thread.h"
 #include "runtime/compact.h"
 
 #ifndef LEAN_WINDOWS
@@ -18,46 +20,234 @@ Author: Leonardo de Moura
 #endif
 
 #define LEAN_COMPACTOR_INIT_SZ 1024*1024
-#define LEAN_MAX_SHARING_TABLE_INITIAL_SIZE 1024*1024
+#define LEAN_MAX_SHARING_TABLE_INITIAL_SIZE 1024
+// Arrays up to this depth, and constructors above it, are split into partitions, see `collect_partition_roots`
+#define LEAN_COMPACTOR_PARTITION_DEPTH 3
+// Minimum number of partition roots for compacting an object graph concurrently
+#define LEAN_COMPACTOR_MIN_PARALLEL_ROOTS 256
+// Minimum number of roots in a partition
+#define LEAN_COMPACTOR_MIN_PARTITION_SIZE 16
 
 // uncomment to track the number of each kind of object in an .olean file
 // #define LEAN_TAG_COUNTERS
 
 namespace lean {
 
-struct max_sharing_key {
-    size_t m_offset;
-    size_t m_size;
-    max_sharing_key(size_t offset, size_t sz):m_offset(offset), m_size(sz) {}
-};
+/*
+  Remark: g_null_offset must NOT be a valid Lean scalar value (e.g., static_cast<size_t>(-1)).
+  Recall that Lean scalar are odd size_t values. So, we use (static_cast<size_t>(-1) - 1) which is an even number.
+  In the past we used `static_cast<size_t>(-1)`, and it caused nontermination in the object compactor.
+*/
+object_offset g_null_offset = reinterpret_cast<object_offset>(static_cast<size_t>(-1) - 1);
 
-struct max_sharing_hash {
-    object_compactor * m;
-    max_sharing_hash(object_compactor * manager):m(manager) {}
-    unsigned operator()(max_sharing_key const & k) const {
-        return hash_str(k.m_size, reinterpret_cast<unsigned char const *>(m->m_begin) + k.m_offset, 17);
+/* Table of the objects that have been compacted, indexed by their representation (i.e., their bytes in the region) */
+struct object_compactor::max_sharing_table {
+    struct entry {
+        // offset of the object in the region
+        uint64   m_offset;
+        // size of the object, 0 if the entry is empty
+        unsigned m_size;
+        unsigned m_hash;
+    };
+    std::vector<entry> m_entries;
+    size_t             m_size = 0;
+
+    max_sharing_table() { resize(LEAN_MAX_SHARING_TABLE_INITIAL_SIZE); }
+
+    size_t mask() const { return m_entries.size() - 1; }
+
+    void resize(size_t capacity) {
+        std::vector<entry> entries(capacity, entry{0, 0, 0});
+        std::swap(entries, m_entries);
+        for (entry const & e : entries) {
+            if (e.m_size) {
+                size_t i = e.m_hash & mask();
+                while (m_entries[i].m_size) i = (i + 1) & mask();
+                m_entries[i] = e;
+            }
+        }
+    }
+
+    void reserve(size_t n) {
+        size_t capacity = m_entries.size();
+        while (capacity < 2 * n) capacity *= 2;
+        if (capacity != m_entries.size())
+            resize(capacity);
     }
-};
 
-struct max_sharing_eq {
-    object_compactor * m;
-    max_sharing_eq(object_compactor * manager):m(manager) {}
-    bool operator()(max_sharing_key const & k1, max_sharing_key const & k2) const {
-        if (k1.m_size != k2.m_size) return false;
-        return memcmp(reinterpret_cast<char*>(m->m_begin) + k1.m_offset, reinterpret_cast<char*>(m->m_begin) + k2.m_offset, k1.m_size) == 0;
+    /* Return the offset of an object whose representation is equal to the `sz` bytes at `begin + offset`,
+       or insert them and return `offset` if there is none. */
+    size_t find_or_insert(char const * begin, size_t offset, size_t sz) {
+        if (sz > std::numeric_limits<unsigned>::max())
+            return offset;
+        unsigned h = hash_str(sz, reinterpret_cast<unsigned char const *>(begin) + offset, 17);
+        if (2 * (m_size + 1) > m_entries.size())
+            resize(2 * m_entries.size());
+        for (size_t i = h & mask();; i = (i + 1) & mask()) {
+            entry & e = m_entries[i];
+            if (e.m_size == 0) {
+                e.m_offset = offset;
+                e.m_size   = sz;
+                e.m_hash   = h;
+                m_size++;
+                return offset;
+            }
+            if (e.m_hash == h && e.m_size == sz && memcmp(begin + e.m_offset, begin + offset, sz) == 0)
+                return e.m_offset;
+        }
     }
 };
 
+/*
+  A partition is a list of roots whose reachable objects are copied into a separate buffer, concurrently with
+  the other partitions. The objects are recorded in the order in which they are first completed by a depth-first
+  traversal of the roots in order, i.e., the order in which the sequential compactor places them. Pointers to other
+  objects are replaced with their index in `m_objs` (shifted so that they cannot be confused with scalars).
+  Scalar arrays, strings, and big numbers are not copied, they are copied directly from the original object
+  when merged.
+
+  When the sequential traversal reaches the root `m_roots[i]`, and all roots before it have already been compacted
+  (which is the case unless objects are shared between partitions), the objects reachable from `m_roots[i]` that are
+  not reachable from the previous roots are exactly `m_objs[m_root_end[i-1]:m_root_end[i]]` (minus those already
+  compacted), in the right order. So they can be merged into the final region without traversing them again. */
+struct object_compactor::partition {
+    std::vector<object *>             m_roots;
+    // `m_root_end[i]` is the size of `m_objs` after copying `m_roots[i]`. Roots reaching objects that cannot be
+    // copied concurrently, such as thunks, (and the following roots) have no entry and are compacted sequentially.
+    std::vector<size_t>               m_root_end;
+    std::vector<object *>             m_objs;
+    // offset of the copy of `m_objs[i]` in `m_buffer`
+    std::vector<size_t>               m_offsets;
+    // true if `m_objs[i]` has a single reference, i.e., it can only be reached through the object referencing it
+    std::vector<bool>                 m_single_ref;
+    // offset of `m_objs[i]` in the final region, set when it is merged or needed by another merged object
+    std::vector<object_offset>        m_new_offsets;
+    // whether `m_objs[i]` is known to have been compacted or not when merging, see `merge_partition`
+    std::vector<uint8>                m_status;
+    std::vector<char>                 m_buffer;
+    object_map<size_t>                m_obj_table;
+    std::vector<object *>             m_todo;
+    // the roots before `m_num_compacted_roots` are known to have been compacted, see `merge_partition`
+    unsigned                          m_num_compacted_roots = 0;
+
+    object * get_copy(size_t i) { return reinterpret_cast<object *>(m_buffer.data() + m_offsets[i]); }
+
+    static object * to_ref(size_t i) { return reinterpret_cast<object *>(i << 1); }
+    static size_t of_ref(object * o) { return reinterpret_cast<size_t>(o) >> 1; }
+
+    object * alloc(object * o, size_t sz) {
+        size_t rem = sz % sizeof(void*);
+        if (rem != 0)
+            sz = sz + sizeof(void*) - rem;
+        size_t offset = m_buffer.size();
+        m_buffer.resize(offset + sz);
+        save(o, offset);
+        return get_copy(m_objs.size() - 1);
+    }
 
-struct object_compactor::max_sharing_table {
-    std::unordered_set<max_sharing_key, max_sharing_hash, max_sharing_eq> m_table;
-    max_sharing_table(object_compactor * manager):
-        m_table(LEAN_MAX_SHARING_TABLE_INITIAL_SIZE, max_sharing_hash(manager), max_sharing_eq(manager)) {
+    void save(object * o, size_t offset) {
+        m_objs.push_back(o);
+        m_offsets.push_back(offset);
+        m_single_ref.push_back(o->m_rc == 1 || o->m_rc == -1);
+        m_obj_table.insert(o, m_objs.size() - 1);
+    }
+
+    /* Return true if all children of `o` have been copied, otherwise push the missing ones in the same order
+       as `object_compactor::to_offset`. */
+    bool check_children(object ** begin, object ** end) {
+        bool missing_children = false;
+        while (end != begin) {
+            end--;
+            object * c = *end;
+            if (!lean_is_scalar(c) && !m_obj_table.find(c)) {
+                m_todo.push_back(c);
+                missing_children = true;
+            }
+        }
+        return !missing_children;
+    }
+
+    void fix_children(object ** begin, object ** end) {
+        for (; begin != end; begin++) {
+            if (!lean_is_scalar(*begin))
+                *begin = to_ref(*m_obj_table.find(*begin));
+        }
+    }
+
+    bool copy_constructor(object * o) {
+        if (!check_children(lean_ctor_obj_cptr(o), lean_ctor_obj_cptr(o) + lean_ctor_num_objs(o)))
+            return false;
+        size_t sz    = lean_object_byte_size(o);
+        object * r   = alloc(o, sz);
+        memcpy(r, o, sz);
+        lean_set_non_heap_header(r, sz, lean_ptr_tag(o), lean_ptr_other(o));
+        fix_children(lean_ctor_obj_cptr(r), lean_ctor_obj_cptr(r) + lean_ctor_num_objs(r));
+        return true;
+    }
+
+    bool copy_array(object * o) {
+        if (!check_children(lean_array_cptr(o), lean_array_cptr(o) + lean_array_size(o)))
+            return false;
+        size_t sz = lean_array_size(o);
+        lean_array_object * r = reinterpret_cast<lean_array_object *>(alloc(o, sizeof(lean_array_object) + sizeof(void*)*sz));
+        lean_set_non_heap_header_for_big(reinterpret_cast<object *>(r), LeanArray, 0);
+        r->m_size     = sz;
+        r->m_capacity = sz;
+        memcpy(r->m_data, lean_array_cptr(o), sizeof(void*)*sz);
+        fix_children(r->m_data, r->m_data + sz);
+        return true;
+    }
+
+    /* Copy the objects reachable from `o`. Return false if `o` reaches an object that must be compacted
+       sequentially. */
+    bool copy(object * o) {
+        m_todo.push_back(o);
+        while (!m_todo.empty()) {
+            object * curr = m_todo.back();
+            if (m_obj_table.find(curr)) {
+                m_todo.pop_back();
+                continue;
+            }
+            uint8 tag = lean_ptr_tag(curr);
+            if (tag <= LeanMaxCtorTag) {
+                if (!copy_constructor(curr))
+                    continue;
+            } else {
+                switch (tag) {
+                case LeanArray:
+                    if (!copy_array(curr))
+                        continue;
+                    break;
+                case LeanScalarArray: case LeanString: case LeanMPZ:
+                    save(curr, 0);
+                    break;
+                default:
+                    /* thunks and tasks may have to be evaluated, and closures and external objects are reported
+                       by the sequential compactor */
+                    m_todo.clear();
+                    return false;
+                }
+            }
+            m_todo.pop_back();
+        }
+        return true;
+    }
+
+    void compact() {
+        for (object * r : m_roots) {
+            if (!copy(r))
+                break;
+            m_root_end.push_back(m_objs.size());
+        }
+        m_obj_table.clear();
+        m_new_offsets.resize(m_objs.size(), g_null_offset);
+        m_status.resize(m_objs.size(), 0);
     }
 };
 
-object_compactor::object_compactor(void * base_addr):
-    m_max_sharing_table(new max_sharing_table(this)),
+object_compactor::object_compactor(void * base_addr, unsigned num_tasks):
+    m_max_sharing_table(new max_sharing_table()),
+    m_num_tasks(num_tasks),
     m_base_addr(base_addr),
     m_begin(malloc(LEAN_COMPACTOR_INIT_SZ)),
     m_end(m_begin),
@@ -68,13 +258,6 @@ object_compactor::~object_compactor() {
     free(m_begin);
 }
 
-/*
-  Remark: g_null_offset must NOT be a valid Lean scalar value (e.g., static_cast<size_t>(-1)).
-  Recall that Lean scalar are odd size_t values. So, we use (static_cast<size_t>(-1) - 1) which is an even number.
-  In the past we used `static_cast<size_t>(-1)`, and it caused nontermination in the object compactor.
-*/
-object_offset g_null_offset = reinterpret_cast<object_offset>(static_cast<size_t>(-1) - 1);
-
 void * object_compactor::alloc(size_t sz) {
     size_t rem = sz % sizeof(void*);
     if (rem != 0)
@@ -95,33 +278,43 @@ void * object_compactor::alloc(size_t sz) {
     return r;
 }
 
-void object_compactor::save(object * o, object * new_o) {
+object_offset object_compactor::to_offset_of_copy(object * new_o) {
     lean_assert(m_begin <= new_o && new_o < m_end);
-    m_obj_table.insert(std::make_pair(o, reinterpret_cast<object_offset>(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin) + reinterpret_cast<size_t>(m_base_addr))));
+    return reinterpret_cast<object_offset>(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin) + reinterpret_cast<size_t>(m_base_addr));
 }
 
-void object_compactor::save_max_sharing(object * o, object * new_o, size_t new_o_sz) {
-    max_sharing_key k(reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin), new_o_sz);
-    auto it = m_max_sharing_table->m_table.find(k);
-    if (it != m_max_sharing_table->m_table.end()) {
+object_offset object_compactor::save(object * o, object * new_o) {
+    object_offset r = to_offset_of_copy(new_o);
+    m_obj_table.insert(o, r);
+    return r;
+}
+
+/* If an object with the same representation as the object `new_o` that was just copied has already been compacted,
+   free `new_o` and return the existing object. */
+object * object_compactor::max_sharing(object * new_o, size_t new_o_sz) {
+    size_t offset = reinterpret_cast<char*>(new_o) - reinterpret_cast<char*>(m_begin);
+    size_t existing = m_max_sharing_table->find_or_insert(static_cast<char*>(m_begin), offset, new_o_sz);
+    if (existing != offset) {
         m_end = new_o;
-        new_o = reinterpret_cast<lean_object*>(reinterpret_cast<char*>(m_begin) + it->m_offset);
-    } else {
-        m_max_sharing_table->m_table.insert(k);
+        return reinterpret_cast<lean_object*>(reinterpret_cast<char*>(m_begin) + existing);
     }
-    save(o, new_o);
+    return new_o;
+}
+
+object_offset object_compactor::save_max_sharing(object * o, object * new_o, size_t new_o_sz) {
+    return save(o, max_sharing(new_o, new_o_sz));
 }
 
 object_offset object_compactor::to_offset(object * o) {
     if (lean_is_scalar(o)) {
         return o;
     } else {
-        auto it = m_obj_table.find(o);
-        if (it == m_obj_table.end()) {
+        object_offset * r = m_obj_table.find(o);
+        if (r == nullptr) {
             m_todo.push_back(o);
             return g_null_offset;
         } else {
-            return it->second;
+            return *r;
         }
     }
 }
@@ -139,7 +332,7 @@ object * object_compactor::copy_object(object * o) {
     return r;
 }
 
-void object_compactor::insert_sarray(object * o) {
+object_offset object_compactor::insert_sarray(object * o) {
     size_t sz        = lean_sarray_size(o);
     unsigned elem_sz = lean_sarray_elem_size(o);
     size_t obj_sz = sizeof(lean_sarray_object) + elem_sz*sz;
@@ -148,10 +341,10 @@ void object_compactor::insert_sarray(object * o) {
     new_o->m_size     = sz;
     new_o->m_capacity = sz;
     memcpy(new_o->m_data, lean_to_sarray(o)->m_data, elem_sz*sz);
-    save_max_sharing(o, (lean_object*)new_o, obj_sz);
+    return save_max_sharing(o, (lean_object*)new_o, obj_sz);
 }
 
-void object_compactor::insert_string(object * o) {
+object_offset object_compactor::insert_string(object * o) {
     size_t sz        = lean_string_size(o);
     size_t len       = lean_string_len(o);
     size_t obj_sz = sizeof(lean_string_object) + sz;
@@ -161,7 +354,7 @@ void object_compactor::insert_string(object * o) {
     new_o->m_capacity = sz;
     new_o->m_length   = len;
     memcpy(new_o->m_data, lean_to_string(o)->m_data, sz);
-    save_max_sharing(o, (lean_object*)new_o, obj_sz);
+    return save_max_sharing(o, (lean_object*)new_o, obj_sz);
 }
 
 // #define ShowCtors
@@ -259,7 +452,7 @@ bool object_compactor::insert_task(object * o) {
     return true;
 }
 
-void object_compactor::insert_mpz(object * o) {
+object_offset object_compactor::insert_mpz(object * o) {
 #ifdef LEAN_USE_GMP
     size_t nlimbs = mpz_size(to_mpz(o)->m_value.m_val);
     size_t data_sz = sizeof(mp_limb_t) * nlimbs;
@@ -273,7 +466,7 @@ void object_compactor::insert_mpz(object * o) {
     memcpy(data, m._mp_d, data_sz);
     m._mp_d = reinterpret_cast<mp_limb_t *>(reinterpret_cast<char *>(data) - reinterpret_cast<char *>(m_begin) + reinterpret_cast<ptrdiff_t>(m_base_addr));
     m._mp_alloc = nlimbs;
-    save(o, (lean_object*)new_o);
+    return save(o, (lean_object*)new_o);
 #else
     size_t data_sz = sizeof(mpn_digit) * to_mpz(o)->m_value.m_size;
     size_t sz      = sizeof(mpz_object) + data_sz;
@@ -283,7 +476,7 @@ void object_compactor::insert_mpz(object * o) {
     void * data = reinterpret_cast<char*>(new_o) + sizeof(mpz_object);
     memcpy(data, to_mpz(o)->m_value.m_digits, data_sz);
     new_o->m_value.m_digits = reinterpret_cast<mpn_digit *>(reinterpret_cast<char *>(data) - reinterpret_cast<char *>(m_begin) + reinterpret_cast<ptrdiff_t>(m_base_addr));
-    save(o, (lean_object*)new_o);
+    return save(o, (lean_object*)new_o);
 #endif
 }
 
@@ -324,18 +517,196 @@ tag_counter_manager g_tag_counter_manager;
 
 #endif
 
+/* Collect the roots of the partitions of the graph reachable from `o` in depth-first order: arrays (e.g., the
+   constants of a module) are split into their elements, and so are the constructors near the root (e.g., the
+   fields of `ModuleData` and the pairs of an extension name and its entries). */
+static void collect_partition_roots(object * o, unsigned depth, std::unordered_set<object *> & visited, std::vector<object *> & roots) {
+    if (lean_is_scalar(o) || !visited.insert(o).second)
+        return;
+    if (lean_is_array(o) && depth <= LEAN_COMPACTOR_PARTITION_DEPTH) {
+        for (size_t i = 0; i < lean_array_size(o); i++)
+            collect_partition_roots(lean_array_get_core(o, i), depth + 1, visited, roots);
+    } else if (lean_is_ctor(o) && depth < LEAN_COMPACTOR_PARTITION_DEPTH) {
+        for (unsigned i = 0; i < lean_ctor_num_objs(o); i++)
+            collect_partition_roots(lean_ctor_get(o, i), depth + 1, visited, roots);
+    } else {
+        roots.push_back(o);
+    }
+}
+
+struct compact_partitions_job {
+    std::vector<std::unique_ptr<object_compactor::partition>> * m_partitions;
+    atomic<size_t> m_next{0};
+};
+
+static void compact_partitions_core(compact_partitions_job & job) {
+    while (true) {
+        size_t i = job.m_next++;
+        if (i >= job.m_partitions->size())
+            return;
+        (*job.m_partitions)[i]->compact();
+    }
+}
+
+static obj_res compact_partitions_fn(obj_arg job, obj_arg) {
+    compact_partitions_core(*reinterpret_cast<compact_partitions_job *>(lean_unbox_usize(job)));
+    lean_dec(job);
+    return lean_box(0);
+}
+
+void object_compactor::compact_partitions(object * o) {
+    std::unordered_set<object *> visited;
+    std::vector<object *> roots;
+    collect_partition_roots(o, 0, visited, roots);
+    if (roots.size() < LEAN_COMPACTOR_MIN_PARALLEL_ROOTS)
+        return;
+    // create more partitions than tasks since their sizes vary
+    size_t partition_size = std::max<size_t>(LEAN_COMPACTOR_MIN_PARTITION_SIZE, roots.size() / (8 * m_num_tasks));
+    for (size_t i = 0; i < roots.size(); i += partition_size) {
+        partition * p = new partition();
+        m_partitions.emplace_back(p);
+        for (size_t j = i; j < std::min(roots.size(), i + partition_size); j++) {
+            m_partition_roots.insert(roots[j], std::make_pair(m_partitions.size() - 1, p->m_roots.size()));
+            p->m_roots.push_back(roots[j]);
+        }
+    }
+    compact_partitions_job job;
+    job.m_partitions = &m_partitions;
+    std::vector<object *> tasks;
+    size_t num_tasks = std::min<size_t>(m_num_tasks, m_partitions.size());
+    for (size_t i = 1; i < num_tasks; i++) {
+        object * c = lean_alloc_closure(reinterpret_cast<void *>(compact_partitions_fn), 2, 1);
+        lean_closure_set(c, 0, lean_box_usize(reinterpret_cast<size_t>(&job)));
+        tasks.push_back(lean_task_spawn_core(c, 0, false));
+    }
+    compact_partitions_core(job);
+    for (object * t : tasks) {
+        lean_task_get(t);
+        lean_dec(t);
+    }
+    // pre-size the tables using the number of objects copied into partitions, which is an upper bound on the objects
+    // they contribute
+    size_t num_objs = 0;
+    for (auto const & p : m_partitions)
+        num_objs += p->m_objs.size();
+    m_obj_table.reserve(m_obj_table.size() + num_objs);
+    m_max_sharing_table->reserve(m_max_sharing_table->m_size + num_objs);
+}
+
+enum class partition_obj_status : uint8 { Unknown, New, Compacted };
+
+/* Merge the objects of `p` first reached from its `i`-th root. Return false if they must be compacted sequentially
+   instead. */
+bool object_compactor::merge_partition(partition & p, unsigned i) {
+    if (i >= p.m_root_end.size())
+        return false;
+    /* The objects copied from `p.m_roots[i]` exclude those reachable from the previous roots,
+       so they must have been compacted already. */
+    while (p.m_num_compacted_roots < i) {
+        if (!m_obj_table.find(p.m_roots[p.m_num_compacted_roots]))
+            return false;
+        p.m_num_compacted_roots++;
+    }
+    size_t begin = i == 0 ? 0 : p.m_root_end[i - 1];
+    size_t end   = p.m_root_end[i];
+    /* Find the objects that have already been compacted (because they are shared with objects compacted before).
+       An object with a single reference has been compacted iff the object referencing it has, so we only need to
+       look up the other ones. Parents are visited before their children by traversing the objects backwards. */
+    for (size_t j = end; j-- > begin;) {
+        partition_obj_status st = static_cast<partition_obj_status>(p.m_status[j]);
+        if (st == partition_obj_status::Unknown) {
+            if (object_offset * r = m_obj_table.find(p.m_objs[j])) {
+                st = partition_obj_status::Compacted;
+                p.m_new_offsets[j] = *r;
+            } else {
+                st = partition_obj_status::New;
+            }
+            p.m_status[j] = static_cast<uint8>(st);
+        }
+        object * o = p.m_objs[j];
+        object ** it; object ** it_end;
+        if (lean_is_ctor(o)) {
+            it = lean_ctor_obj_cptr(p.get_copy(j)); it_end = it + lean_ctor_num_objs(o);
+        } else if (lean_is_array(o)) {
+            it = lean_array_cptr(p.get_copy(j)); it_end = it + lean_array_size(o);
+        } else {
+            continue;
+        }
+        for (; it != it_end; it++) {
+            if (!lean_is_scalar(*it)) {
+                size_t k = partition::of_ref(*it);
+                if (k >= begin && p.m_single_ref[k])
+                    p.m_status[k] = static_cast<uint8>(st);
+            }
+        }
+    }
+    auto get_offset = [&](object * c) {
+        if (lean_is_scalar(c))
+            return c;
+        size_t j = partition::of_ref(c);
+        if (p.m_new_offsets[j] == g_null_offset)
+            p.m_new_offsets[j] = *m_obj_table.find(p.m_objs[j]);
+        return p.m_new_offsets[j];
+    };
+    for (size_t j = begin; j < end; j++) {
+        if (static_cast<partition_obj_status>(p.m_status[j]) == partition_obj_status::Compacted)
+            continue;
+        object * o = p.m_objs[j];
+        object * new_o;
+        size_t sz;
+        if (lean_is_ctor(o)) {
+            object * c = p.get_copy(j);
+            sz    = lean_object_byte_size(c);
+            new_o = static_cast<object *>(alloc(sz));
+            memcpy(new_o, c, sz);
+            for (unsigned k = 0; k < lean_ctor_num_objs(new_o); k++)
+                lean_ctor_set(new_o, k, get_offset(lean_ctor_get(new_o, k)));
+        } else if (lean_is_array(o)) {
+            object * c = p.get_copy(j);
+            sz    = lean_object_byte_size(c);
+            new_o = static_cast<object *>(alloc(sz));
+            memcpy(new_o, c, sz);
+            for (size_t k = 0; k < lean_array_size(new_o); k++)
+                lean_array_set_core(new_o, k, get_offset(lean_array_get_core(new_o, k)));
+        } else {
+            switch (lean_ptr_tag(o)) {
+            case LeanScalarArray: p.m_new_offsets[j] = insert_sarray(o); break;
+            case LeanString:      p.m_new_offsets[j] = insert_string(o); break;
+            case LeanMPZ:         p.m_new_offsets[j] = insert_mpz(o); break;
+            default:              lean_unreachable();
+            }
+            continue;
+        }
+        new_o = max_sharing(new_o, sz);
+        p.m_new_offsets[j] = to_offset_of_copy(new_o);
+        /* Objects with a single reference cannot be reached again, except for the root */
+        if (!p.m_single_ref[j] || j == end - 1)
+            m_obj_table.insert(o, p.m_new_offsets[j]);
+    }
+    return true;
+}
+
 void object_compactor::operator()(object * o) {
     lean_assert(m_todo.empty());
     // allocate for root address, see end of function
     alloc(sizeof(object_offset));
     if (!lean_is_scalar(o)) {
+        if (m_num_tasks > 1)
+            compact_partitions(o);
         m_todo.push_back(o);
         while (!m_todo.empty()) {
             object * curr = m_todo.back();
-            if (m_obj_table.find(curr) != m_obj_table.end()) {
+            if (m_obj_table.find(curr)) {
                 m_todo.pop_back();
                 continue;
             }
+            if (!m_partition_roots.empty()) {
+                std::pair<unsigned, unsigned> * r = m_partition_roots.find(curr);
+                if (r && merge_partition(*m_partitions[r->first], r->second)) {
+                    m_todo.pop_back();
+                    continue;
+                }
+            }
             lean_assert(!lean_is_scalar(curr));
             bool r = true;
 #ifdef LEAN_TAG_COUNTERS
@@ -357,20 +728,88 @@ void object_compactor::operator()(object * o) {
             if (r) m_todo.pop_back();
         }
         m_tmp.clear();
+        m_partitions.clear();
+        m_partition_roots.clear();
     }
     *static_cast<object_offset *>(m_begin) = to_offset(o);
 }
 
-compacted_region::compacted_region(size_t sz, void * data, void * base_addr, bool is_mmap, std::function<void()> free_data):
+template<typename F> void compacted_region::for_each_pointer_field(char * begin, char * end, F && f) {
+    char * it = begin;
+    while (it < end) {
+        object * o = reinterpret_cast<object*>(it);
+        uint8 tag  = lean_ptr_tag(o);
+        size_t sz;
+        if (tag <= LeanMaxCtorTag) {
+            object ** fs = lean_ctor_obj_cptr(o);
+            for (unsigned i = 0; i < lean_ctor_num_objs(o); i++)
+                f(reinterpret_cast<void **>(fs + i));
+            sz = lean_object_byte_size(o);
+        } else {
+            switch (tag) {
+            case LeanArray:
+                for (size_t i = 0; i < lean_array_size(o); i++)
+                    f(reinterpret_cast<void **>(lean_array_cptr(o) + i));
+                sz = lean_object_byte_size(o);
+                break;
+            case LeanScalarArray: sz = lean_sarray_byte_size(o); break;
+            case LeanString:      sz = lean_string_byte_size(o); break;
+            case LeanMPZ:
+#ifdef LEAN_USE_GMP
+                f(reinterpret_cast<void **>(&to_mpz(o)->m_value.m_val[0]._mp_d));
+                sz = sizeof(mpz_object) + sizeof(mp_limb_t) * mpz_size(to_mpz(o)->m_value.m_val);
+#else
+                f(reinterpret_cast<void **>(&to_mpz(o)->m_value.m_digits));
+                sz = sizeof(mpz_object) + sizeof(mpn_digit) * to_mpz(o)->m_value.m_size;
+#endif
+                break;
+            case LeanThunk:
+                f(reinterpret_cast<void **>(&lean_to_thunk(o)->m_value));
+                sz = sizeof(lean_thunk_object);
+                break;
+            case LeanRef:
+                f(reinterpret_cast<void **>(&lean_to_ref(o)->m_value));
+                sz = sizeof(lean_ref_object);
+                break;
+            case LeanTask:
+                f(reinterpret_cast<void **>(&lean_to_task(o)->m_value));
+                sz = sizeof(lean_task_object);
+                break;
+            default: lean_unreachable();
+            }
+        }
+        it += lean_align(sz, sizeof(void*));
+    }
+}
+
+std::vector<uint64> object_compactor::get_relocations() const {
+    char * begin = static_cast<char*>(m_begin);
+    std::vector<uint64> relocs((size() / sizeof(void*) + 63) / 64, 0);
+    auto mark = [&](void ** field) {
+        if (!lean_is_scalar(static_cast<object *>(*field))) {
+            size_t i = (reinterpret_cast<char*>(field) - begin) / sizeof(void*);
+            relocs[i / 64] |= static_cast<uint64>(1) << (i % 64);
+        }
+    };
+    // root address, see `operator()`
+    mark(static_cast<void **>(m_begin));
+    compacted_region::for_each_pointer_field(begin + sizeof(object_offset), static_cast<char*>(m_end), mark);
+    return relocs;
+}
+
+compacted_region::compacted_region(size_t sz, void * data, void * base_addr, bool is_mmap, std::function<void()> free_data,
+                                   uint64 const * relocs):
     m_base_addr(base_addr),
     m_is_mmap(is_mmap),
     m_free_data(free_data),
+    m_relocs(relocs),
     m_begin(data),
     m_next(data),
     m_end(static_cast<char*>(data)+sz) {
 }
 
 compacted_region::compacted_region(object_compactor const & c):
+    m_relocs(nullptr),
     m_begin(malloc(c.size())),
     m_next(m_begin),
     m_end(static_cast<char*>(m_begin) + c.size()) {
@@ -381,102 +820,51 @@ compacted_region::~compacted_region() {
     m_free_data();
 }
 
-inline object * compacted_region::fix_object_ptr(object * o) {
-    if (lean_is_scalar(o)) return o;
-    return reinterpret_cast<object*>(static_cast<char*>(m_begin) + (reinterpret_cast<size_t>(o) - reinterpret_cast<size_t>(m_base_addr)));
-}
-
-inline void compacted_region::move(size_t d) {
-    lean_assert(m_next < m_end);
-    size_t rem = d % sizeof(void*);
-    if (rem != 0)
-        d = d + sizeof(void*) - rem;
-    m_next = static_cast<char*>(m_next) + d;
-}
-
-inline void compacted_region::move(object * o) {
-    return move(lean_object_byte_size(o));
-}
-
-inline void compacted_region::fix_constructor(object * o) {
-    lean_assert(!lean_has_rc(o));
-    object ** it  = lean_ctor_obj_cptr(o);
-    object ** end = it + lean_ctor_num_objs(o);
-    for (; it != end; it++) {
-        *it = fix_object_ptr(*it);
+inline void * compacted_region::fix_ptr(void * p) {
+    if (lean_is_scalar(static_cast<object *>(p))) return p;
+    return static_cast<char*>(m_begin) + (static_cast<char*>(p) - static_cast<char*>(m_base_addr));
+}
+
+/* Relocate the words marked in `m_relocs`. Words are processed in blocks of 64 so that the inner loop
+   can be vectorized, and blocks without pointers are not touched. */
+void compacted_region::apply_relocations() {
+    size_t delta  = static_cast<char*>(m_begin) - static_cast<char*>(m_base_addr);
+    size_t * words = static_cast<size_t *>(m_begin);
+    size_t n = (static_cast<char*>(m_end) - static_cast<char*>(m_begin)) / sizeof(size_t);
+    for (size_t i = 0; i < n; i += 64) {
+        uint64 bits = m_relocs[i / 64];
+        if (bits == 0)
+            continue;
+        size_t * block = words + i;
+        unsigned block_sz = std::min<size_t>(64, n - i);
+        for (unsigned j = 0; j < block_sz; j++)
+            block[j] += delta & (0 - ((bits >> j) & 1));
     }
-    lean_assert(lean_object_byte_size(o) < 4192);
-    move(o);
-}
-
-inline void compacted_region::fix_array(object * o) {
-    object ** it  = lean_array_cptr(o);
-    object ** end = it + lean_array_size(o);
-    for (; it != end; it++) {
-        *it = fix_object_ptr(*it);
-    }
-    move(o);
-}
-
-inline void compacted_region::fix_thunk(object * o) {
-    lean_to_thunk(o)->m_value = fix_object_ptr(lean_to_thunk(o)->m_value);
-    move(sizeof(lean_thunk_object));
-}
-
-inline void compacted_region::fix_ref(object * o) {
-    lean_to_ref(o)->m_value = fix_object_ptr(lean_to_ref(o)->m_value);
-    move(sizeof(lean_ref_object));
-}
-
-inline void compacted_region::fix_task(object * o) {
-    lean_to_task(o)->m_value = fix_object_ptr(lean_to_task(o)->m_value);
-    move(sizeof(lean_task_object));
-}
-
-void compacted_region::fix_mpz(object * o) {
-#ifdef LEAN_USE_GMP
-    __mpz_struct & m = to_mpz(o)->m_value.m_val[0];
-    m._mp_d = reinterpret_cast<mp_limb_t *>(static_cast<char *>(m_begin) + reinterpret_cast<size_t>(m._mp_d) - reinterpret_cast<size_t>(m_base_addr));
-    move(sizeof(mpz_object) + sizeof(mp_limb_t) * mpz_size(to_mpz(o)->m_value.m_val));
-#else
-    to_mpz(o)->m_value.m_digits = reinterpret_cast<mpn_digit*>(reinterpret_cast<char*>(o) + sizeof(mpz_object));
-    move(sizeof(mpz_object) + sizeof(mpn_digit) * to_mpz(o)->m_value.m_size);
-#endif
 }
 
 object * compacted_region::read() {
     if (m_next == m_end)
         return nullptr; /* all objects have been read */
 
-    object * root = fix_object_ptr(*static_cast<object_offset *>(m_next));
-    move(sizeof(object_offset));
     if (m_begin == m_base_addr) {
         // no relocations needed
-        m_end = m_next;
+        object * root = *static_cast<object_offset *>(m_next);
+        m_next = static_cast<char*>(m_next) + sizeof(object_offset);
+        m_end  = m_next;
         return root;
     }
     lean_assert(!m_is_mmap);
 
-    while (m_next < m_end) {
-        object * curr = reinterpret_cast<object*>(m_next);
-        uint8 tag = lean_ptr_tag(curr);
-        if (tag <= LeanMaxCtorTag) {
-            fix_constructor(curr);
-        } else {
-            switch (tag) {
-            case LeanClosure:         lean_unreachable();
-            case LeanArray:           fix_array(curr); break;
-            case LeanScalarArray:     move(lean_sarray_byte_size(curr)); break;
-            case LeanString:          move(lean_string_byte_size(curr)); break;
-            case LeanMPZ:             fix_mpz(curr); break;
-            case LeanThunk:           fix_thunk(curr); break;
-            case LeanRef:             fix_ref(curr); break;
-            case LeanTask:            fix_task(curr); break;
-            case LeanExternal:        lean_unreachable();
-            default:                  lean_unreachable();
-            }
-        }
+    if (m_relocs) {
+        apply_relocations();
+    } else {
+        *static_cast<void **>(m_next) = fix_ptr(*static_cast<void **>(m_next));
+        for_each_pointer_field(static_cast<char*>(m_next) + sizeof(object_offset), static_cast<char*>(m_end), [&](void ** field) {
+                *field = fix_ptr(*field);
+            });
     }
+    object * root = *static_cast<object_offset *>(m_next);
+    m_next = m_end;
     return root;
 }
 
@@ -7,20 +7,91 @@ Author: Leonardo de Moura
 #pragma once
 #include <functional>
 #include <vector>
-#include <unordered_map>
 #include "runtime/object.h"
 
 namespace lean {
 typedef lean_object * object_offset;
 
+/* Hash table from objects to `V` using open addressing and linear probing. It does not support removals. */
+template<typename V> class object_map {
+    struct entry {
+        object * m_key;
+        V        m_value;
+    };
+    std::vector<entry> m_entries;
+    size_t             m_size;
+    unsigned           m_shift;
+    size_t mask() const { return m_entries.size() - 1; }
+    size_t index(object * o) const {
+        // Fibonacci hashing, objects are aligned so we must use the high bits of the product
+        return static_cast<size_t>((static_cast<uint64>(reinterpret_cast<size_t>(o)) * 11400714819323198485ull) >> m_shift);
+    }
+    void resize(size_t capacity) {
+        std::vector<entry> entries(capacity, entry{nullptr, V()});
+        std::swap(entries, m_entries);
+        m_shift = 64;
+        while (capacity > 1) { capacity >>= 1; m_shift--; }
+        for (entry const & e : entries) {
+            if (e.m_key) {
+                size_t i = index(e.m_key);
+                while (m_entries[i].m_key) i = (i + 1) & mask();
+                m_entries[i] = e;
+            }
+        }
+    }
+public:
+    object_map(size_t capacity = 1024):m_size(0) { resize(capacity); }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    /* Make sure that `n` objects can be stored without resizing the table. */
+    void reserve(size_t n) {
+        size_t capacity = m_entries.size();
+        while (capacity < 2 * n) capacity *= 2;
+        if (capacity != m_entries.size())
+            resize(capacity);
+    }
+    V * find(object * o) {
+        for (size_t i = index(o);; i = (i + 1) & mask()) {
+            entry & e = m_entries[i];
+            if (e.m_key == o) return &e.m_value;
+            if (!e.m_key) return nullptr;
+        }
+    }
+    /* Associate `v` with `o` unless `o` is already in the table. Return true if `o` was inserted. */
+    bool insert(object * o, V const & v) {
+        if (2 * (m_size + 1) > m_entries.size())
+            resize(2 * m_entries.size());
+        for (size_t i = index(o);; i = (i + 1) & mask()) {
+            entry & e = m_entries[i];
+            if (e.m_key == o) return false;
+            if (!e.m_key) {
+                e.m_key   = o;
+                e.m_value = v;
+                m_size++;
+                return true;
+            }
+        }
+    }
+    void clear() {
+        m_entries.clear();
+        m_size = 0;
+        resize(1024);
+    }
+};
+
 class object_compactor {
     struct max_sharing_table;
-    friend struct max_sharing_hash;
-    friend struct max_sharing_eq;
-    std::unordered_map<object*, object_offset, std::hash<object*>, std::equal_to<object*>> m_obj_table;
+    struct partition;
+    friend struct compact_partitions_job;
+    object_map<object_offset> m_obj_table;
     std::unique_ptr<max_sharing_table> m_max_sharing_table;
     std::vector<object*> m_todo;
     std::vector<object_offset> m_tmp;
+    // Maximum number of tasks used to compact partitions of the object graph concurrently, see `compact_partitions`
+    unsigned m_num_tasks;
+    std::vector<std::unique_ptr<partition>> m_partitions;
+    // partition root ==> (index in `m_partitions`, index in `partition::m_roots`)
+    object_map<std::pair<unsigned, unsigned>> m_partition_roots;
     // On-disk base address used for `mmap`ing compacted regions without relocations
     // References within the compacted region are rewritten by subtracting `m_begin` and adding `m_base_addr`
     // In the simplest case `base_addr == nullptr`, we get region-relative pointers
@@ -29,22 +100,28 @@ class object_compactor {
     void * m_end;
     void * m_capacity;
     size_t capacity() const { return static_cast<char*>(m_capacity) - static_cast<char*>(m_begin); }
-    void save(object * o, object * new_o);
-    void save_max_sharing(object * o, object * new_o, size_t new_o_sz);
+    object_offset to_offset_of_copy(object * new_o);
+    object_offset save(object * o, object * new_o);
+    object * max_sharing(object * new_o, size_t new_o_sz);
+    object_offset save_max_sharing(object * o, object * new_o, size_t new_o_sz);
     void * alloc(size_t sz);
     object_offset to_offset(object * o);
     void insert_terminator(object * o);
     object * copy_object(object * o);
     bool insert_constructor(object * o);
     bool insert_array(object * o);
-    void insert_sarray(object * o);
-    void insert_string(object * o);
+    object_offset insert_sarray(object * o);
+    object_offset insert_string(object * o);
     bool insert_thunk(object * o);
     bool insert_task(object * o);
     bool insert_ref(object * o);
-    void insert_mpz(object * o);
+    object_offset insert_mpz(object * o);
+    void compact_partitions(object * o);
+    bool merge_partition(partition & p, unsigned i);
 public:
-    object_compactor(void * base_addr = nullptr);
+    /* If `num_tasks > 1`, large object graphs are split into partitions that are first compacted concurrently
+       using up to `num_tasks` tasks, and then merged. The result is identical to the one produced sequentially. */
+    object_compactor(void * base_addr = nullptr, unsigned num_tasks = 1);
     object_compactor(object_compactor const &) = delete;
     object_compactor(object_compactor &&) = delete;
     ~object_compactor();
@@ -53,6 +130,10 @@ public:
     void operator()(object * o);
     size_t size() const { return static_cast<char*>(m_end) - static_cast<char*>(m_begin); }
     void const * data() const { return m_begin; }
+    /* Return a bitmap of the words of the compacted region containing pointers, which must be relocated if the
+       region is loaded at an address different from `base_addr`. Bit `i % 64` of element `i / 64` is set if
+       the `i`-th word is a pointer. It assumes that a single object graph has been compacted. */
+    std::vector<uint64> get_relocations() const;
 };
 
 class compacted_region {
@@ -60,22 +141,21 @@ class compacted_region {
     void * m_base_addr;
     bool m_is_mmap;
     std::function<void()> m_free_data;
+    // see `object_compactor::get_relocations`
+    uint64 const * m_relocs;
     void * m_begin;
     void * m_next;
     void * m_end;
-    void move(size_t d);
-    void move(object * o);
-    object * fix_object_ptr(object * o);
-    void fix_constructor(object * o);
-    void fix_array(object * o);
-    void fix_thunk(object * o);
-    void fix_ref(object * o);
-    void fix_task(object * o);
-    void fix_mpz(object * o);
+    void * fix_ptr(void * p);
+    void apply_relocations();
 public:
+    /* Invoke `f` on the address of each field that may contain a pointer of the compacted objects stored in `[begin, end)`. */
+    template<typename F> static void for_each_pointer_field(char * begin, char * end, F && f);
     /* Creates a compacted object region using the given region in memory.
-       This object takes ownership of the region. */
-    compacted_region(size_t sz, void * data, void * base_addr, bool is_mmap, std::function<void()> free_data);
+       This object takes ownership of the region. If the region is not at `base_addr`, the pointers it contains
+       are relocated when it is read, using `relocs` if it is not null (it must remain valid until then). */
+    compacted_region(size_t sz, void * data, void * base_addr, bool is_mmap, std::function<void()> free_data,
+                     uint64 const * relocs = nullptr);
     /* Creates a compacted object region using the object_compactor current state.
        It creates a copy of the compacted region generated by the object compactor. */
     explicit compacted_region(object_compactor const & c);
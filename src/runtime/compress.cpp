@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "runtime/compress.h"
+
+namespace lean {
+static constexpr size_t LZ_MIN_MATCH    = 4;
+static constexpr size_t LZ_MAX_OFFSET   = 65535;
+static constexpr unsigned LZ_HASH_BITS  = 16;
+/* As required by the LZ4 block format, the last 5 bytes are always literals, and the last match starts at least
+   12 bytes before the end of the input. */
+static constexpr size_t LZ_LAST_LITERALS = 5;
+static constexpr size_t LZ_MF_LIMIT      = 12;
+/* After `2^LZ_SKIP_TRIGGER` consecutive positions without a match, the compressor starts skipping positions in
+   incompressible data. */
+static constexpr unsigned LZ_SKIP_TRIGGER = 6;
+/* Number of bytes copied at once by the decompressor when there is enough space in the input and output */
+static constexpr size_t LZ_WILD_COPY = 16;
+
+static inline uint32 lz_read32(char const * p) {
+    uint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32 lz_hash(uint32 v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static void lz_write_length(std::string & out, size_t len) {
+    while (len >= 255) {
+        out.push_back(static_cast<char>(255));
+        len -= 255;
+    }
+    out.push_back(static_cast<char>(len));
+}
+
+/* Emit a sequence of `lit_len` literals followed by a match, or only the literals if `match_len == 0`. */
+static void lz_emit(std::string & out, char const * lit, size_t lit_len, size_t offset, size_t match_len) {
+    size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+    out.push_back(static_cast<char>((std::min<size_t>(lit_len, 15) << 4) | std::min<size_t>(ml, 15)));
+    if (lit_len >= 15)
+        lz_write_length(out, lit_len - 15);
+    out.append(lit, lit_len);
+    if (match_len) {
+        out.push_back(static_cast<char>(offset & 0xff));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (ml >= 15)
+            lz_write_length(out, ml - 15);
+    }
+}
+
+void lz_compress(char const * src, size_t size, std::string & out) {
+    size_t anchor = 0;
+    if (size >= LZ_MF_LIMIT) {
+        std::vector<uint32> table(1u << LZ_HASH_BITS, 0);
+        size_t match_limit = size - LZ_LAST_LITERALS;
+        size_t i_limit     = size - LZ_MF_LIMIT;
+        size_t i           = 0;
+        size_t misses      = 0;
+        while (i <= i_limit) {
+            uint32 v    = lz_read32(src + i);
+            uint32 h    = lz_hash(v);
+            size_t cand = table[h];
+            table[h]    = static_cast<uint32>(i);
+            if (cand >= i || i - cand > LZ_MAX_OFFSET || lz_read32(src + cand) != v) {
+                i += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+            size_t len = LZ_MIN_MATCH;
+            while (i + len + sizeof(uint64) <= match_limit) {
+                uint64 a, b;
+                memcpy(&a, src + cand + len, sizeof(a));
+                memcpy(&b, src + i + len, sizeof(b));
+                if (a != b)
+                    break;
+                len += sizeof(uint64);
+            }
+            while (i + len < match_limit && src[cand + len] == src[i + len])
+                len++;
+            while (i > anchor && cand > 0 && src[i - 1] == src[cand - 1]) {
+                i--; cand--; len++;
+            }
+            lz_emit(out, src + anchor, i - anchor, i - cand, len);
+            i += len;
+            anchor = i;
+            misses = 0;
+            table[lz_hash(lz_read32(src + i - 2))] = static_cast<uint32>(i - 2);
+        }
+    }
+    lz_emit(out, src + anchor, size - anchor, 0, 0);
+}
+
+static inline bool lz_read_length(unsigned char const * & ip, unsigned char const * iend, size_t & len) {
+    unsigned char b;
+    do {
+        if (ip == iend)
+            return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+bool lz_decompress(char const * src, size_t size, char * dst, size_t dst_size) {
+    unsigned char const * ip   = reinterpret_cast<unsigned char const *>(src);
+    unsigned char const * iend = ip + size;
+    char * op   = dst;
+    char * oend = dst + dst_size;
+    while (ip < iend) {
+        unsigned token = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !lz_read_length(ip, iend, lit_len))
+            return false;
+        if (lit_len > static_cast<size_t>(iend - ip) || lit_len > static_cast<size_t>(oend - op))
+            return false;
+        if (lit_len <= LZ_WILD_COPY && iend - ip >= static_cast<ptrdiff_t>(LZ_WILD_COPY) &&
+            oend - op >= static_cast<ptrdiff_t>(LZ_WILD_COPY)) {
+            // short runs are copied using a fixed size, overwriting bytes that are written later
+            memcpy(op, ip, LZ_WILD_COPY);
+        } else {
+            memcpy(op, ip, lit_len);
+        }
+        op += lit_len;
+        ip += lit_len;
+        if (ip == iend) // the last sequence has no match
+            break;
+        if (iend - ip < 2)
+            return false;
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst))
+            return false;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !lz_read_length(ip, iend, match_len))
+            return false;
+        match_len += LZ_MIN_MATCH;
+        if (match_len > static_cast<size_t>(oend - op))
+            return false;
+        char const * m = op - offset;
+        if (offset >= sizeof(uint64) && oend - op >= static_cast<ptrdiff_t>(match_len + sizeof(uint64))) {
+            // each word only reads bytes already written
+            for (size_t k = 0; k < match_len; k += sizeof(uint64))
+                memcpy(op + k, m + k, sizeof(uint64));
+        } else if (offset >= match_len) {
+            memcpy(op, m, match_len);
+        } else {
+            // overlapping match repeating the last `offset` bytes
+            for (size_t k = 0; k < match_len; k++)
+                op[k] = m[k];
+        }
+        op += match_len;
+    }
+    return op == oend;
+}
+}
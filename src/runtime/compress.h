@@ -0,0 +1,22 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#pragma once
+#include <string>
+#include "runtime/object.h"
+
+namespace lean {
+/* A fast byte-oriented LZ77 codec using the LZ4 block format: a sequence of literal runs each followed by a
+   back-reference of at least 4 bytes at an offset of less than 64KB. It trades compression ratio for
+   decompression speed, which is close to that of `memcpy`. */
+
+/* Append the compressed form of `src[0..size)` to `out`. */
+void lz_compress(char const * src, size_t size, std::string & out);
+
+/* Decompress `src[0..size)` into `dst`, which must be exactly `dst_size` bytes long. Return false if the input
+   is malformed or does not decompress to `dst_size` bytes. */
+bool lz_decompress(char const * src, size_t size, char * dst, size_t dst_size);
+}
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <cstring>
 #include "runtime/hash.h"
 
 namespace lean {
@@ -55,4 +56,70 @@ uint64 hash_str(size_t len, unsigned char const * str, uint64 init_value) {
     return MurmurHash64A(str, len, init_value);
 }
 
+//-----------------------------------------------------------------------------
+// MurmurHash3, 128-bit version for x64, by Austin Appleby
+// https://github.com/aappleby/smhasher
+static inline uint64 rotl64(uint64 x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64 fmix64(uint64 k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccd;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53;
+    k ^= k >> 33;
+    return k;
+}
+
+void hash128(void const * data, size_t len, uint64 & h1, uint64 & h2) {
+    const uint64 c1 = 0x87c37b91114253d5;
+    const uint64 c2 = 0x4cf5ad432745937f;
+    const unsigned char * bytes = static_cast<const unsigned char *>(data);
+    size_t nblocks = len / 16;
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint64 k1, k2;
+        memcpy(&k1, bytes + i * 16, sizeof(k1));
+        memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char * tail = bytes + nblocks * 16;
+    uint64 k1 = 0;
+    uint64 k2 = 0;
+
+    switch (len & 15) {
+    case 15: k2 ^= uint64(tail[14]) << 48;
+    case 14: k2 ^= uint64(tail[13]) << 40;
+    case 13: k2 ^= uint64(tail[12]) << 32;
+    case 12: k2 ^= uint64(tail[11]) << 24;
+    case 11: k2 ^= uint64(tail[10]) << 16;
+    case 10: k2 ^= uint64(tail[9]) << 8;
+    case  9: k2 ^= uint64(tail[8]);
+             k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    case  8: k1 ^= uint64(tail[7]) << 56;
+    case  7: k1 ^= uint64(tail[6]) << 48;
+    case  6: k1 ^= uint64(tail[5]) << 40;
+    case  5: k1 ^= uint64(tail[4]) << 32;
+    case  4: k1 ^= uint64(tail[3]) << 24;
+    case  3: k1 ^= uint64(tail[2]) << 16;
+    case  2: k1 ^= uint64(tail[1]) << 8;
+    case  1: k1 ^= uint64(tail[0]);
+             k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    };
+
+    h1 ^= len; h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+}
+
 }
@@ -12,6 +12,11 @@ namespace lean {
 
 uint64 hash_str(size_t len, unsigned char const * str, uint64 init_value);
 
+/* Compute the 128-bit hash (MurmurHash3 x64) of `len` bytes at `data` using `(h1, h2)` as the seed, and store it in
+   `(h1, h2)`. Each call finalizes the hash, so hashing several pieces by passing the hash of the previous pieces as
+   the seed of the next one yields a chained hash, which differs from the hash of the concatenated pieces. */
+void hash128(void const * data, size_t len, uint64 & h1, uint64 & h2);
+
 inline uint64 hash(uint64 h, uint64 k) {
     uint64 m = 0xc6a4a7935bd1e995;
     uint64 r = 47;
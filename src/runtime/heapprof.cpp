@@ -0,0 +1,468 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <fstream>
+#ifdef __GLIBC__
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+#include "runtime/alloc.h"
+#include "runtime/heapprof.h"
+
+/* Maximum number of frames recorded for a sample */
+#define LEAN_HEAP_PROFILE_MAX_FRAMES 64
+/* Number of frames of the profiler itself at the top of every sample */
+#define LEAN_HEAP_PROFILE_SKIP_FRAMES 1
+#define LEAN_HEAP_PROFILE_MAX_ALLOCATOR_FRAMES 8
+#define LEAN_HEAP_PROFILE_DEFAULT_RATE (512*1024)
+
+namespace lean {
+static bool is_hex_digit(char c) {
+    return ('0' <= c && c <= '9') || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F');
+}
+
+static void push_utf8(std::string & r, unsigned c) {
+    if (c < 0x80) {
+        r.push_back(static_cast<char>(c));
+    } else if (c < 0x800) {
+        r.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        r.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+        r.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        r.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        r.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    } else {
+        r.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        r.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        r.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        r.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+/* Try to decode an escape sequence `_x<2 hex digits>`, `_u<4 hex digits>`, or `_U<8 hex digits>` starting at `s`. */
+static bool demangle_escape(char const * s, std::string & r, size_t & len) {
+    unsigned num_digits;
+    switch (s[1]) {
+    case 'x': num_digits = 2; break;
+    case 'u': num_digits = 4; break;
+    case 'U': num_digits = 8; break;
+    default: return false;
+    }
+    unsigned c = 0;
+    for (unsigned i = 0; i < num_digits; i++) {
+        char d = s[2 + i];
+        if (!is_hex_digit(d))
+            return false;
+        c = 16 * c + static_cast<unsigned>(d <= '9' ? d - '0' : (d | 0x20) - 'a' + 10);
+    }
+    push_utf8(r, c);
+    len = 2 + num_digits;
+    return true;
+}
+
+/* Inverse of `Lean.Name.mangle` (see `src/Lean/Compiler/NameMangling.lean`).
+   Remark: the mangling is not injective, e.g., `x.ab` and `«x\xab»` are both mangled to `l_x_xab`.
+   We prefer escape sequences, and components containing only digits are numeric. The result is only used for display purposes. */
+std::string demangle_lean_name(char const * s) {
+    if (strncmp(s, "l_", 2) != 0)
+        return std::string();
+    s += 2;
+    std::string r;
+    std::string comp;
+    bool first = true;
+    auto push_comp = [&]() {
+        if (!first) r.push_back('.');
+        r += comp;
+        comp.clear();
+        first = false;
+    };
+    while (*s) {
+        char c = *s;
+        if (c != '_') {
+            if (!isalnum(static_cast<unsigned char>(c)))
+                return std::string();
+            comp.push_back(c);
+            s++;
+            continue;
+        }
+        size_t len;
+        size_t num_underscores = strspn(s, "_");
+        if (!comp.empty() && strspn(comp.c_str(), "0123456789") == comp.size()) {
+            /* `Name.num p n` is mangled as `p_n_` */
+            push_comp();
+            s++;
+            if (*s == '_') s++;
+        } else if (num_underscores == 1 && demangle_escape(s, comp, len)) {
+            s += len;
+        } else {
+            /* An odd number of underscores is a separator followed by escaped underscores.
+               We assume the separator comes first since auxiliary declarations (e.g., `_lambda_1`) start with an underscore. */
+            if (num_underscores % 2 == 1)
+                push_comp();
+            comp.append(num_underscores / 2, '_');
+            s += num_underscores;
+        }
+    }
+    if (!comp.empty() || first)
+        push_comp();
+    return r;
+}
+
+#ifdef __GLIBC__
+struct heap_sample {
+    unsigned m_stack;
+    /* Estimated number of objects and bytes represented by this sample */
+    size_t   m_num_objs;
+    size_t   m_num_bytes;
+};
+
+struct stack_hash {
+    size_t operator()(std::vector<void *> const & s) const {
+        size_t h = 31;
+        for (void * p : s)
+            h = h * 1000003 ^ reinterpret_cast<size_t>(p);
+        return h;
+    }
+};
+
+class heap_profiler {
+    mutex                    m_mutex;
+    std::string              m_fname;
+    size_t                   m_rate;
+    std::vector<std::vector<void *>> m_stacks;
+    std::unordered_map<std::vector<void *>, unsigned, stack_hash> m_stack_ids;
+    std::unordered_map<void *, heap_sample> m_samples;
+    /* Estimated number of objects and bytes that are live for each stack */
+    std::vector<size_t>      m_live_objs;
+    std::vector<size_t>      m_live_bytes;
+    size_t                   m_total_live_bytes{0};
+    /* Snapshot of `m_live_objs` and `m_live_bytes` at the peak of `m_total_live_bytes`.
+       To avoid copying on every sample while memory usage grows, it is only updated
+       when the live bytes exceed the previous peak by more than 5%. */
+    std::vector<size_t>      m_peak_objs;
+    std::vector<size_t>      m_peak_bytes;
+    size_t                   m_total_peak_bytes{0};
+
+    unsigned get_stack_id(std::vector<void *> && stack) {
+        auto it = m_stack_ids.find(stack);
+        if (it != m_stack_ids.end())
+            return it->second;
+        unsigned id = m_stacks.size();
+        m_stacks.push_back(stack);
+        m_stack_ids.emplace(std::move(stack), id);
+        m_live_objs.push_back(0);
+        m_live_bytes.push_back(0);
+        return id;
+    }
+
+    void remove_core(std::unordered_map<void *, heap_sample>::iterator const & it) {
+        heap_sample const & s = it->second;
+        m_live_objs[s.m_stack]  -= s.m_num_objs;
+        m_live_bytes[s.m_stack] -= s.m_num_bytes;
+        m_total_live_bytes      -= s.m_num_bytes;
+    }
+
+public:
+    heap_profiler(char const * fname, size_t rate):m_fname(fname), m_rate(rate) {}
+
+    std::string const & get_fname() const { return m_fname; }
+
+    void sample(void * o, size_t sz, atomic<unsigned> * num_samples) {
+        void * frames[LEAN_HEAP_PROFILE_MAX_FRAMES + LEAN_HEAP_PROFILE_SKIP_FRAMES];
+        int n = backtrace(frames, LEAN_HEAP_PROFILE_MAX_FRAMES + LEAN_HEAP_PROFILE_SKIP_FRAMES);
+        int skip = std::min(n, LEAN_HEAP_PROFILE_SKIP_FRAMES);
+        std::vector<void *> stack(frames + skip, frames + n);
+        heap_sample s;
+        s.m_num_bytes = std::max(sz, m_rate);
+        s.m_num_objs  = s.m_num_bytes / sz;
+        lock_guard<mutex> lock(m_mutex);
+        s.m_stack = get_stack_id(std::move(stack));
+        auto it = m_samples.find(o);
+        if (it != m_samples.end()) {
+            /* The object has been freed without notifying the profiler, so the previous sample is stale. */
+            remove_core(it);
+            it->second = s;
+        } else {
+            m_samples.emplace(o, s);
+            if (num_samples)
+                num_samples->store(num_samples->load() + 1);
+        }
+        m_live_objs[s.m_stack]  += s.m_num_objs;
+        m_live_bytes[s.m_stack] += s.m_num_bytes;
+        m_total_live_bytes      += s.m_num_bytes;
+        if (m_total_live_bytes > m_total_peak_bytes + m_total_peak_bytes / 20) {
+            m_total_peak_bytes = m_total_live_bytes;
+            m_peak_objs        = m_live_objs;
+            m_peak_bytes       = m_live_bytes;
+        }
+    }
+
+    void remove(void * o, atomic<unsigned> * num_samples) {
+        lock_guard<mutex> lock(m_mutex);
+        auto it = m_samples.find(o);
+        if (it == m_samples.end())
+            return;
+        remove_core(it);
+        m_samples.erase(it);
+        if (num_samples)
+            num_samples->store(num_samples->load() - 1);
+    }
+
+    bool write(char const * fname);
+};
+
+/* Minimal protocol buffer encoder for the pprof format,
+   see https://github.com/google/pprof/blob/main/proto/profile.proto */
+class proto_writer {
+    std::string m_buf;
+public:
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            m_buf.push_back(static_cast<char>((v & 0x7F) | 0x80));
+            v >>= 7;
+        }
+        m_buf.push_back(static_cast<char>(v));
+    }
+    void field_varint(unsigned field, uint64_t v) {
+        varint(field << 3);
+        varint(v);
+    }
+    void field_bytes(unsigned field, std::string const & v) {
+        varint((field << 3) | 2);
+        varint(v.size());
+        m_buf += v;
+    }
+    void field_packed(unsigned field, std::vector<uint64_t> const & vs) {
+        proto_writer w;
+        for (uint64_t v : vs) w.varint(v);
+        field_bytes(field, w.m_buf);
+    }
+    std::string const & str() const { return m_buf; }
+};
+
+class string_table {
+    std::vector<std::string> m_strings;
+    std::unordered_map<std::string, uint64_t> m_ids;
+public:
+    string_table() { get(""); }
+    uint64_t get(std::string const & s) {
+        auto it = m_ids.find(s);
+        if (it != m_ids.end())
+            return it->second;
+        uint64_t id = m_strings.size();
+        m_strings.push_back(s);
+        m_ids.emplace(s, id);
+        return id;
+    }
+    std::vector<std::string> const & strings() const { return m_strings; }
+};
+
+struct frame_info {
+    /* Lean declaration name, demangled C++ name, or address */
+    std::string m_name;
+    /* Native symbol name */
+    std::string m_system_name;
+};
+
+/* Lean declaration name or demangled C++ name of a native symbol */
+static std::string demangle_symbol(char const * sym) {
+    std::string r = demangle_lean_name(sym);
+    if (r.empty()) {
+        int status;
+        if (char * cpp = abi::__cxa_demangle(sym, nullptr, nullptr, &status)) {
+            r = cpp;
+            ::free(cpp);
+        } else {
+            r = sym;
+        }
+    }
+    return r;
+}
+
+static frame_info symbolize(void * addr) {
+    frame_info r;
+    Dl_info info;
+    /* `addr` is a return address, we use `addr - 1` to get the call instruction. */
+    void * call = static_cast<char *>(addr) - 1;
+    if (dladdr(call, &info) && info.dli_sname) {
+        r.m_system_name = info.dli_sname;
+        r.m_name = demangle_symbol(info.dli_sname);
+    } else {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%p", addr);
+        r.m_name = r.m_system_name = buf;
+    }
+    return r;
+}
+
+std::string get_function_name(void * fn) {
+    Dl_info info;
+    if (dladdr(fn, &info) && info.dli_sname)
+        return demangle_symbol(info.dli_sname);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%p", fn);
+    return buf;
+}
+
+/* Frames of the allocator and the profiler itself are removed from the top of the stack traces.
+   Remark: static functions cannot be symbolized, so we remove all frames up to the outermost allocator frame
+   among the first `LEAN_HEAP_PROFILE_MAX_ALLOCATOR_FRAMES` ones. */
+static bool is_allocator_frame(std::string const & name) {
+    for (char const * prefix : {"lean::heap_profiler", "lean::allocator::", "lean::alloc(", "lean_alloc_small", "lean_alloc_object"}) {
+        if (name.compare(0, strlen(prefix), prefix) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool heap_profiler::write(char const * fname) {
+    lock_guard<mutex> lock(m_mutex);
+    string_table strings;
+    proto_writer prof;
+    /* sample_type */
+    char const * sample_types[4][2] = {
+        {"peak_objects", "count"}, {"peak_space", "bytes"}, {"inuse_objects", "count"}, {"inuse_space", "bytes"}
+    };
+    for (auto const & t : sample_types) {
+        proto_writer vt;
+        vt.field_varint(1, strings.get(t[0]));
+        vt.field_varint(2, strings.get(t[1]));
+        prof.field_bytes(1, vt.str());
+    }
+    /* sample */
+    std::unordered_map<void *, uint64_t> location_ids;
+    std::vector<void *> locations;
+    std::vector<uint64_t> location_functions;
+    std::unordered_map<std::string, uint64_t> function_ids;
+    std::vector<frame_info> functions;
+    for (unsigned i = 0; i < m_stacks.size(); i++) {
+        uint64_t peak_objs  = i < m_peak_objs.size() ? m_peak_objs[i] : 0;
+        uint64_t peak_bytes = i < m_peak_bytes.size() ? m_peak_bytes[i] : 0;
+        if (peak_bytes == 0 && m_live_bytes[i] == 0)
+            continue;
+        std::vector<uint64_t> ids;
+        /* Index of the outermost allocator frame */
+        int top = -1;
+        for (void * addr : m_stacks[i]) {
+            auto it = location_ids.find(addr);
+            if (it == location_ids.end()) {
+                frame_info info = symbolize(addr);
+                auto fn_it = function_ids.find(info.m_name);
+                if (fn_it == function_ids.end()) {
+                    functions.push_back(info);
+                    fn_it = function_ids.emplace(info.m_name, functions.size()).first;
+                }
+                locations.push_back(addr);
+                location_functions.push_back(fn_it->second);
+                it = location_ids.emplace(addr, locations.size()).first;
+            }
+            if (ids.size() < LEAN_HEAP_PROFILE_MAX_ALLOCATOR_FRAMES &&
+                is_allocator_frame(functions[location_functions[it->second - 1] - 1].m_name))
+                top = static_cast<int>(ids.size());
+            ids.push_back(it->second);
+        }
+        ids.erase(ids.begin(), ids.begin() + (top + 1));
+        proto_writer s;
+        s.field_packed(1, ids);
+        s.field_packed(2, {peak_objs, peak_bytes, m_live_objs[i], m_live_bytes[i]});
+        prof.field_bytes(2, s.str());
+    }
+    /* location and function */
+    for (unsigned i = 0; i < locations.size(); i++) {
+        proto_writer line;
+        line.field_varint(1, location_functions[i]);
+        proto_writer loc;
+        loc.field_varint(1, i + 1);
+        loc.field_varint(3, reinterpret_cast<uint64_t>(locations[i]));
+        loc.field_bytes(4, line.str());
+        prof.field_bytes(4, loc.str());
+    }
+    for (unsigned i = 0; i < functions.size(); i++) {
+        proto_writer fn;
+        fn.field_varint(1, i + 1);
+        fn.field_varint(2, strings.get(functions[i].m_name));
+        fn.field_varint(3, strings.get(functions[i].m_system_name));
+        prof.field_bytes(5, fn.str());
+    }
+    /* period_type and period */
+    proto_writer pt;
+    pt.field_varint(1, strings.get("space"));
+    pt.field_varint(2, strings.get("bytes"));
+    uint64_t default_sample_type = strings.get("peak_space");
+    for (std::string const & s : strings.strings())
+        prof.field_bytes(6, s);
+    prof.field_bytes(11, pt.str());
+    prof.field_varint(12, m_rate);
+    prof.field_varint(14, default_sample_type);
+    std::ofstream out(fname, std::ios::binary);
+    out << prof.str();
+    return out.good();
+}
+
+static heap_profiler * g_heap_profiler = nullptr;
+
+static void write_heap_profile_at_exit() {
+    if (!write_heap_profile(g_heap_profiler->get_fname().c_str()))
+        std::cerr << "failed to write heap profile to '" << g_heap_profiler->get_fname() << "'\n";
+}
+
+void start_heap_profiler(char const * fname, size_t rate) {
+    if (g_heap_profiler)
+        return;
+    if (rate == 0)
+        rate = LEAN_HEAP_PROFILE_DEFAULT_RATE;
+    g_heap_profiler = new heap_profiler(fname, rate);
+    std::atexit(write_heap_profile_at_exit);
+    set_heap_profile_rate(rate);
+}
+
+bool write_heap_profile(char const * fname) {
+    return g_heap_profiler && g_heap_profiler->write(fname);
+}
+
+void heap_profiler_sample(void * o, size_t sz, atomic<unsigned> * num_samples) {
+    if (g_heap_profiler)
+        g_heap_profiler->sample(o, sz, num_samples);
+}
+
+void heap_profiler_free(void * o, atomic<unsigned> * num_samples) {
+    if (g_heap_profiler)
+        g_heap_profiler->remove(o, num_samples);
+}
+#else
+std::string get_function_name(void * fn) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%p", fn);
+    return buf;
+}
+void start_heap_profiler(char const *, size_t) {
+    std::cerr << "warning: heap profiler is not available on this platform\n";
+}
+bool write_heap_profile(char const *) { return false; }
+void heap_profiler_sample(void *, size_t, atomic<unsigned> *) {}
+void heap_profiler_free(void *, atomic<unsigned> *) {}
+#endif
+
+void initialize_heapprof() {
+#ifndef LEAN_EMSCRIPTEN
+    if (char const * fname = std::getenv("LEAN_HEAP_PROFILE")) {
+        size_t rate = 0;
+        if (char const * r = std::getenv("LEAN_HEAP_PROFILE_RATE"))
+            rate = std::strtoull(r, nullptr, 10);
+        start_heap_profiler(fname, rate);
+    }
+#endif
+}
+}
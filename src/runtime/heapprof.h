@@ -0,0 +1,39 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#pragma once
+#include <stddef.h>
+#include <string>
+#include "runtime/thread.h"
+
+namespace lean {
+/* Sampling heap profiler.
+   When enabled, the allocator records the stack trace of (approximately) one allocation every
+   `rate` bytes, and keeps the samples of objects that have not been freed yet. When the process exits,
+   the samples that are live at exit and at the peak of the sampled live bytes are written to a file
+   in pprof format. Native frames of Lean code are mapped back to Lean declaration names.
+
+   The profiler is enabled by setting the environment variable `LEAN_HEAP_PROFILE` to the output file name
+   (`LEAN_HEAP_PROFILE_RATE` sets the sampling rate in bytes, default: 512 Kb), or using the
+   `--heap-profile=file` option of the `lean` executable. It is only available on platforms using glibc. */
+
+/* Start the profiler. The profile is written to `fname` at exit. */
+void start_heap_profiler(char const * fname, size_t rate);
+/* Write the current profile to `fname`. Return false if the file could not be written. */
+bool write_heap_profile(char const * fname);
+/* Record a sample for the object `o` of `sz` bytes. It is invoked by the allocator.
+   If `num_samples` is not null, it is incremented when the sample is recorded. */
+void heap_profiler_sample(void * o, size_t sz, atomic<unsigned> * num_samples);
+/* Remove the sample for `o` if there is one, and decrement `num_samples` if it is not null. */
+void heap_profiler_free(void * o, atomic<unsigned> * num_samples);
+/* Decode a symbol produced by `Lean.Name.mangle`, e.g., `l_Lean_Elab_Term_elabTerm` ==> `Lean.Elab.Term.elabTerm`.
+   Return the empty string if `s` is not the name of a Lean declaration. */
+std::string demangle_lean_name(char const * s);
+/* Name of the function at address `fn` for display purposes: the Lean declaration name, the demangled C++ name,
+   or the address if the function cannot be symbolized. */
+std::string get_function_name(void * fn);
+void initialize_heapprof();
+}
@@ -5,6 +5,8 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #include "runtime/alloc.h"
+#include "runtime/heapprof.h"
+#include "runtime/tasktrace.h"
 #include "runtime/debug.h"
 #include "runtime/thread.h"
 #include "runtime/object.h"
@@ -16,6 +18,8 @@ Author: Leonardo de Moura
 namespace lean {
 extern "C" LEAN_EXPORT void lean_initialize_runtime_module() {
     initialize_alloc();
+    initialize_heapprof();
+    initialize_tasktrace();
     initialize_debug();
     initialize_object();
     initialize_io();
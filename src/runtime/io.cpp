@@ -35,6 +35,7 @@ Authors: Leonardo de Moura, Sebastian Ullrich
 #include <fstream>
 #include <iomanip>
 #include <string>
+#include <vector>
 #include <cstdlib>
 #include <cctype>
 #include <sys/stat.h>
@@ -44,6 +45,7 @@ Authors: Leonardo de Moura, Sebastian Ullrich
 #include "runtime/utf8.h"
 #include "runtime/object.h"
 #include "runtime/thread.h"
+#include "runtime/parking.h"
 #include "runtime/allocprof.h"
 
 #ifdef _MSC_VER
@@ -494,6 +496,60 @@ extern "C" LEAN_EXPORT obj_res lean_io_get_num_heartbeats(obj_arg /* w */) {
     return io_result_mk_ok(lean_uint64_to_nat(get_num_heartbeats()));
 }
 
+/* releaseFreeMemory : BaseIO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_release_free_memory(obj_arg /* w */) {
+    lean_release_free_memory();
+    return io_result_mk_ok(box(0));
+}
+
+/*
+structure AllocSlotStats where
+  objSize   : UInt64
+  numAllocs : UInt64
+  numFrees  : UInt64
+
+structure AllocStats where
+  numAllocs            : UInt64
+  numFrees             : UInt64
+  liveBytes            : UInt64
+  numSegments          : UInt64
+  numPages             : UInt64
+  numRemoteFrees       : UInt64
+  numHugetlbSegments   : UInt64
+  numThpSegments       : UInt64
+  numHugePageFallbacks : UInt64
+  slots                : Array AllocSlotStats
+
+getAllocStats : BaseIO AllocStats
+*/
+extern "C" LEAN_EXPORT obj_res lean_io_get_alloc_stats(obj_arg /* w */) {
+    unsigned num_slots = lean_get_alloc_num_slots();
+    std::vector<uint64> num_alloc(num_slots);
+    std::vector<uint64> num_dealloc(num_slots);
+    lean_alloc_stats s;
+    lean_get_alloc_stats(&s, num_alloc.data(), num_dealloc.data());
+    uint64_t num_hugetlb, num_thp, num_fallbacks;
+    lean_get_huge_page_stats(&num_hugetlb, &num_thp, &num_fallbacks);
+    object * slots = alloc_array(0, num_slots);
+    for (unsigned i = 0; i < num_slots; i++) {
+        /* Size classes that have never been used are omitted */
+        if (num_alloc[i] == 0 && num_dealloc[i] == 0)
+            continue;
+        object * slot = alloc_cnstr(0, 0, 3 * sizeof(uint64));
+        cnstr_set_uint64(slot, 0, lean_get_alloc_slot_size(i));
+        cnstr_set_uint64(slot, sizeof(uint64), num_alloc[i]);
+        cnstr_set_uint64(slot, 2 * sizeof(uint64), num_dealloc[i]);
+        slots = array_push(slots, slot);
+    }
+    object * r = alloc_cnstr(0, 1, 9 * sizeof(uint64));
+    cnstr_set(r, 0, slots);
+    uint64 vals[9] = { s.m_num_alloc, s.m_num_dealloc, s.m_live_bytes, s.m_num_segments, s.m_num_pages,
+                       s.m_num_remote_frees, num_hugetlb, num_thp, num_fallbacks };
+    for (unsigned i = 0; i < 9; i++)
+        cnstr_set_uint64(r, sizeof(object *) + i * sizeof(uint64), vals[i]);
+    return io_result_mk_ok(r);
+}
+
 extern "C" LEAN_EXPORT obj_res lean_io_getenv(b_obj_arg env_var, obj_arg) {
 #if defined(LEAN_EMSCRIPTEN)
     // HACK(WN): getenv doesn't seem to work in Emscripten even though it should
@@ -781,25 +837,41 @@ static inline atomic<object*> * mt_ref_val_addr(object * o) {
 */
 static inline bool ref_maybe_mt(b_obj_arg ref) { return lean_is_mt(ref) || lean_is_persistent(ref); }
 
+/* Take ownership of the value stored in the multi-threaded `ref`. If the value has been taken by another thread,
+   wait until it is put back. */
+static object * mt_ref_take(b_obj_arg ref) {
+    atomic<object *> * val_addr = mt_ref_val_addr(ref);
+    while (true) {
+        object * val = val_addr->exchange(nullptr);
+        if (val != nullptr)
+            return val;
+        park_until(val_addr, [&]() { return val_addr->load() != nullptr; });
+    }
+}
+
+/* Store `val` into the multi-threaded `ref`, and wake up the threads waiting for a value in `ref`.
+   Return the value that was overwritten (if any). */
+static object * mt_ref_put(b_obj_arg ref, object * val) {
+    atomic<object *> * val_addr = mt_ref_val_addr(ref);
+    object * old_val = val_addr->exchange(val);
+    unpark_all(val_addr);
+    return old_val;
+}
+
 extern "C" LEAN_EXPORT obj_res lean_st_ref_get(b_obj_arg ref, obj_arg) {
     if (ref_maybe_mt(ref)) {
-        atomic<object *> * val_addr = mt_ref_val_addr(ref);
-        while (true) {
-            /*
-              We cannot simply read `val` from the ref and `inc` it like in the `else` branch since someone else could
-              write to the ref in between and remove the last owning reference to the object. Instead, we must take
-              ownership of the RC token in the ref via `exchange`, duplicate it, then put one RC token back. */
-            object * val = val_addr->exchange(nullptr);
-            if (val != nullptr) {
-                inc(val);
-                object * tmp = val_addr->exchange(val);
-                if (tmp != nullptr) {
-                    /* this may happen if another thread wrote `ref` */
-                    dec(tmp);
-                }
-                return io_result_mk_ok(val);
-            }
+        /*
+          We cannot simply read `val` from the ref and `inc` it like in the `else` branch since someone else could
+          write to the ref in between and remove the last owning reference to the object. Instead, we must take
+          ownership of the RC token in the ref via `exchange`, duplicate it, then put one RC token back. */
+        object * val = mt_ref_take(ref);
+        inc(val);
+        object * tmp = mt_ref_put(ref, val);
+        if (tmp != nullptr) {
+            /* this may happen if another thread wrote `ref` */
+            dec(tmp);
         }
+        return io_result_mk_ok(val);
     } else {
         object * val = lean_to_ref(ref)->m_value;
         lean_assert(val != nullptr);
@@ -810,12 +882,7 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_get(b_obj_arg ref, obj_arg) {
 
 extern "C" LEAN_EXPORT obj_res lean_st_ref_take(b_obj_arg ref, obj_arg) {
     if (ref_maybe_mt(ref)) {
-        atomic<object *> * val_addr = mt_ref_val_addr(ref);
-        while (true) {
-            object * val = val_addr->exchange(nullptr);
-            if (val != nullptr)
-                return io_result_mk_ok(val);
-        }
+        return io_result_mk_ok(mt_ref_take(ref));
     } else {
         object * val = lean_to_ref(ref)->m_value;
         lean_assert(val != nullptr);
@@ -832,8 +899,7 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_set(b_obj_arg ref, obj_arg a, obj_arg
            Reason: our runtime relies on the fact that a single-threaded object
            cannot be reached from a multi-thread object. */
         mark_mt(a);
-        atomic<object *> * val_addr = mt_ref_val_addr(ref);
-        object * old_a = val_addr->exchange(a);
+        object * old_a = mt_ref_put(ref, a);
         if (old_a != nullptr)
             dec(old_a);
         return io_result_mk_ok(box(0));
@@ -849,12 +915,15 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_swap(b_obj_arg ref, obj_arg a, obj_ar
     if (ref_maybe_mt(ref)) {
         /* See io_ref_write */
         mark_mt(a);
-        atomic<object *> * val_addr = mt_ref_val_addr(ref);
-        while (true) {
-            object * old_a = val_addr->exchange(a);
-            if (old_a != nullptr)
-                return io_result_mk_ok(old_a);
+        /* We must take the old value before storing `a`: if we stored `a` into an empty `ref`, another thread could
+           take it, and we would not have a value to return. */
+        object * old_a = mt_ref_take(ref);
+        object * tmp   = mt_ref_put(ref, a);
+        if (tmp != nullptr) {
+            /* this may happen if another thread wrote `ref` */
+            dec(tmp);
         }
+        return io_result_mk_ok(old_a);
     } else {
         object * old_a = lean_to_ref(ref)->m_value;
         if (old_a == nullptr)
@@ -864,6 +933,95 @@ extern "C" LEAN_EXPORT obj_res lean_st_ref_swap(b_obj_arg ref, obj_arg a, obj_ar
     }
 }
 
+/* Update the value stored in the multi-threaded `ref` using `f` without taking it out of `ref` while `f` is running, so
+   that other threads reading `ref` are never blocked. `f` may be applied several times (to shared values) if other
+   threads write to `ref` concurrently. If `get` is true, `f` returns a pair of the result and the new value.
+
+   Remark: the value cannot be read using a plain atomic load followed by an `inc`, since another thread could
+   overwrite `ref` and release the value in between. Instead, it is pinned by taking it and putting it back with an
+   extra reference. Readers (`lean_st_ref_get`) also take the value and put the same value back, so if the
+   `compare_exchange` fails because `ref` is temporarily empty, we wait for the value to be put back and retry the
+   `compare_exchange` without applying `f` again. Thus, concurrent readers cannot starve the modifier, only
+   concurrent writes force `f` to be applied again. */
+static object * mt_ref_atomic_modify(b_obj_arg ref, b_obj_arg f, bool get) {
+    atomic<object *> * val_addr = mt_ref_val_addr(ref);
+    while (true) {
+        object * old_val = mt_ref_take(ref);
+        inc(old_val, 2);
+        object * tmp = mt_ref_put(ref, old_val);
+        if (tmp != nullptr)
+            dec(tmp);
+        /* We own two references to `old_val`: one is consumed by `f`, and the other one keeps `old_val` alive
+           until the `compare_exchange` below so that its address cannot be reused by another value stored in `ref`. */
+        inc(f);
+        object * r = apply_1(f, old_val);
+        object * new_val = r;
+        object * res = nullptr;
+        if (get) {
+            res     = cnstr_get(r, 0);
+            new_val = cnstr_get(r, 1);
+            inc(res);
+            inc(new_val);
+            dec(r);
+        }
+        mark_mt(new_val);
+        while (true) {
+            object * expected = old_val;
+            if (val_addr->compare_exchange_strong(expected, new_val)) {
+                unpark_all(val_addr);
+                /* release the reference kept alive above, and the one owned by `ref` */
+                dec(old_val);
+                dec(old_val);
+                return get ? res : box(0);
+            }
+            if (expected != nullptr)
+                break;
+            /* the value is being read by another thread, wait until it is put back */
+            park_until(val_addr, [&]() { return val_addr->load() != nullptr; });
+        }
+        /* `ref` has been written by another thread, try again */
+        dec(old_val);
+        dec(new_val);
+        if (res)
+            dec(res);
+    }
+}
+
+extern "C" LEAN_EXPORT obj_res lean_st_ref_atomic_modify(b_obj_arg ref, obj_arg f, obj_arg) {
+    if (ref_maybe_mt(ref)) {
+        mt_ref_atomic_modify(ref, f, false);
+        dec(f);
+        return io_result_mk_ok(box(0));
+    } else {
+        object * val = lean_to_ref(ref)->m_value;
+        lean_assert(val != nullptr);
+        /* `ref` does not own `val` while `f` is running, so that `f` can update it destructively */
+        lean_to_ref(ref)->m_value = nullptr;
+        object * new_val = apply_1(f, val);
+        lean_to_ref(ref)->m_value = new_val;
+        return io_result_mk_ok(box(0));
+    }
+}
+
+extern "C" LEAN_EXPORT obj_res lean_st_ref_atomic_modify_get(b_obj_arg ref, obj_arg f, obj_arg) {
+    if (ref_maybe_mt(ref)) {
+        object * res = mt_ref_atomic_modify(ref, f, true);
+        dec(f);
+        return io_result_mk_ok(res);
+    } else {
+        object * val = lean_to_ref(ref)->m_value;
+        lean_assert(val != nullptr);
+        lean_to_ref(ref)->m_value = nullptr;
+        object * r = apply_1(f, val);
+        object * res = cnstr_get(r, 0);
+        inc(res);
+        lean_to_ref(ref)->m_value = cnstr_get(r, 1);
+        inc(lean_to_ref(ref)->m_value);
+        dec(r);
+        return io_result_mk_ok(res);
+    }
+}
+
 extern "C" LEAN_EXPORT obj_res lean_st_ref_ptr_eq(b_obj_arg ref1, b_obj_arg ref2, obj_arg) {
     // TODO(Leo): ref_maybe_mt
     bool r = lean_to_ref(ref1)->m_value == lean_to_ref(ref2)->m_value;
@@ -919,6 +1077,10 @@ extern "C" LEAN_EXPORT obj_res lean_io_has_finished(b_obj_arg t, obj_arg) {
     return io_result_mk_ok(box(lean_io_has_finished_core(t)));
 }
 
+extern "C" LEAN_EXPORT obj_res lean_io_get_num_task_workers(obj_arg) {
+    return io_result_mk_ok(box(lean_io_get_num_task_workers_core()));
+}
+
 extern "C" LEAN_EXPORT obj_res lean_io_wait(obj_arg t, obj_arg) {
     return io_result_mk_ok(lean_task_get_own(t));
 }
@@ -18,6 +18,9 @@ Author: Leonardo de Moura
 #include "runtime/hash.h"
 #include "runtime/flet.h"
 #include "runtime/interrupt.h"
+#include "runtime/stackinfo.h"
+#include "runtime/tasktrace.h"
+#include "runtime/parking.h"
 #include "runtime/buffer.h"
 #include "runtime/io.h"
 #include "runtime/hash.h"
@@ -381,14 +384,13 @@ extern "C" LEAN_EXPORT b_obj_res lean_thunk_get_core(b_obj_arg t) {
         lean_assert(lean_to_thunk(t)->m_value == nullptr);
         mark_mt(r);
         lean_to_thunk(t)->m_value = r;
+        unpark_all(&lean_to_thunk(t)->m_value);
         return r;
     } else {
         lean_assert(c == nullptr);
-        /* There is another thread executing the closure. We keep waiting for the m_value to be
-           set by another thread. */
-        while (!lean_to_thunk(t)->m_value) {
-            this_thread::yield();
-        }
+        /* There is another thread executing the closure. We wait for the m_value to be
+           set by another thread, first by spinning for a short while and then by parking the current thread. */
+        park_until(&lean_to_thunk(t)->m_value, [&]() { return lean_to_thunk(t)->m_value.load() != nullptr; });
         return lean_to_thunk(t)->m_value;
     }
 }
@@ -573,56 +575,249 @@ static void free_task(lean_task_object * t) {
     lean_free_small_object((lean_object*)t);
 }
 
+static void * get_task_fn(object * c);
+
 struct scoped_current_task_object : flet<lean_task_object *> {
     scoped_current_task_object(lean_task_object * t):flet(g_current_task_object, t) {}
 };
 
+/* Work-stealing deque of Chase and Lev ("Dynamic Circular Work-Stealing Deque", SPAA 2005), using the
+   memory orders of Lê et al. ("Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013).
+   Only the owner pushes tasks, at the bottom. Tasks are taken from the top, both by the owner and by
+   other workers, so that each worker still executes its tasks in FIFO order. The owner only pops from
+   the bottom to run a task it is waiting for (see `task_manager::wait_for`). */
+class task_deque {
+    struct array {
+        size_t                                         m_capacity;
+        std::unique_ptr<atomic<lean_task_object *>[]> m_data;
+        array(size_t capacity):m_capacity(capacity), m_data(new atomic<lean_task_object *>[capacity]) {}
+        lean_task_object * get(size_t i) const { return m_data[i & (m_capacity - 1)].load(memory_order_relaxed); }
+        void set(size_t i, lean_task_object * t) { m_data[i & (m_capacity - 1)].store(t, memory_order_relaxed); }
+    };
+    atomic<size_t>                      m_top{0};
+    atomic<size_t>                      m_bottom{0};
+    atomic<array *>                     m_array{nullptr};
+    /* All arrays allocated by the owner. A thief may still be reading from an array that has been replaced
+       by a larger one, so they are only released when the deque is destroyed. */
+    std::vector<std::unique_ptr<array>> m_arrays;
+
+    array * grow(array * a, size_t top, size_t bottom) {
+        array * new_a = new array(a ? 2 * a->m_capacity : 32);
+        for (size_t i = top; i < bottom; i++)
+            new_a->set(i, a->get(i));
+        m_arrays.emplace_back(new_a);
+        m_array.store(new_a, memory_order_release);
+        return new_a;
+    }
+
+public:
+    bool empty() const {
+        return m_top.load(memory_order_relaxed) >= m_bottom.load(memory_order_relaxed);
+    }
+
+    /* Must only be used by the owner. */
+    void push(lean_task_object * t) {
+        size_t b  = m_bottom.load(memory_order_relaxed);
+        size_t tp = m_top.load(memory_order_acquire);
+        array * a = m_array.load(memory_order_relaxed);
+        if (!a || b - tp >= a->m_capacity)
+            a = grow(a, tp, b);
+        a->set(b, t);
+        atomic_thread_fence(memory_order_release);
+        m_bottom.store(b + 1, memory_order_relaxed);
+    }
+
+    /* Remove the last pushed task if it is `t`. Must only be used by the owner. */
+    bool pop_if(lean_task_object * t) {
+        size_t b  = m_bottom.load(memory_order_relaxed);
+        if (m_top.load(memory_order_relaxed) >= b || m_array.load(memory_order_relaxed)->get(b - 1) != t)
+            return false;
+        b--;
+        m_bottom.store(b, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        size_t tp = m_top.load(memory_order_relaxed);
+        if (tp < b)
+            return true;
+        bool r = false;
+        if (tp == b) {
+            // `t` is the last task, race against thieves
+            r = m_top.compare_exchange_strong(tp, tp + 1, memory_order_seq_cst, memory_order_relaxed);
+        }
+        m_bottom.store(b + 1, memory_order_relaxed);
+        return r;
+    }
+
+    /* Take the oldest task, or return `nullptr` if the deque is empty. */
+    lean_task_object * steal() {
+        while (true) {
+            size_t tp = m_top.load(memory_order_acquire);
+            atomic_thread_fence(memory_order_seq_cst);
+            size_t b  = m_bottom.load(memory_order_acquire);
+            if (tp >= b)
+                return nullptr;
+            lean_task_object * t = m_array.load(memory_order_acquire)->get(tp);
+            if (m_top.compare_exchange_strong(tp, tp + 1, memory_order_seq_cst, memory_order_relaxed))
+                return t;
+        }
+    }
+};
+
+struct task_worker {
+    unsigned   m_idx;
+    task_deque m_queues[LEAN_MAX_PRIO+1];
+};
+
+/* Standard worker of the task manager running on the current thread, if any. */
+LEAN_THREAD_PTR(task_worker, g_current_worker);
+
+/* Maximum number of standard workers spawned in addition to `task_manager::m_max_std_workers` to compensate for
+   workers blocked waiting for other tasks. */
+#define LEAN_MAX_SPARE_WORKERS 256
+
+/* Tasks are assigned a lock (and a condition variable to wait for them) by hashing their address. */
+#define LEAN_NUM_TASK_BUCKETS 256
+
+struct task_bucket {
+    mutex              m_mutex;
+    condition_variable m_cv;
+    unsigned           m_num_waiters{0};
+};
+
 class task_manager {
+    /* protects the creation, sleeping and termination of workers */
     mutex                                         m_mutex;
-    unsigned                                      m_num_std_workers{0};
-    unsigned                                      m_idle_std_workers{0};
+    /* number of standard workers created so far; they only terminate when shutting down */
+    atomic<unsigned>                              m_num_std_workers{0};
+    unsigned                                      m_num_finished_std_workers{0};
     unsigned                                      m_max_std_workers{0};
     unsigned                                      m_num_dedicated_workers{0};
-    std::deque<lean_task_object *>                m_queues[LEAN_MAX_PRIO+1];
-    unsigned                                      m_queues_size{0};
-    unsigned                                      m_max_prio{0};
+    std::unique_ptr<task_worker[]>                m_workers;
+    /* number of standard workers waiting on `m_queue_cv` */
+    atomic<unsigned>                              m_num_sleeping_workers{0};
+    /* number of standard workers waiting for a task to finish */
+    atomic<unsigned>                              m_num_blocked_workers{0};
+    /* tasks enqueued by threads that are not standard workers */
+    mutex                                         m_inject_mutex;
+    std::deque<lean_task_object *>                m_inject_queues[LEAN_MAX_PRIO+1];
+    atomic<unsigned>                              m_inject_queues_size{0};
+    /* number of tasks per priority in all queues */
+    atomic<unsigned>                              m_queues_size[LEAN_MAX_PRIO+1];
     condition_variable                            m_queue_cv;
-    condition_variable                            m_task_finished_cv;
     condition_variable                            m_worker_finished_cv;
-    bool                                          m_shutting_down{false};
+    /* `wait_any` waits for a set of tasks, so its waiters are not associated with a task bucket */
+    mutex                                         m_wait_any_mutex;
+    condition_variable                            m_wait_any_cv;
+    atomic<unsigned>                              m_num_wait_any{0};
+    task_bucket                                   m_task_buckets[LEAN_NUM_TASK_BUCKETS];
+    atomic<bool>                                  m_shutting_down{false};
+
+    task_bucket & get_task_bucket(lean_task_object * t) {
+        uint64 h = static_cast<uint64>(reinterpret_cast<uintptr_t>(t)) * 0x9E3779B97F4A7C15ull;
+        return m_task_buckets[h >> 56];
+    }
+
+    /* Lock protecting the state of `t` (see `lean_task_object`). */
+    mutex & get_task_mutex(lean_task_object * t) {
+        return get_task_bucket(t).m_mutex;
+    }
+
+    /* Number of standard workers that are neither sleeping nor blocked. The result may be inexact, and even
+       negative, when workers are concurrently changing their state. */
+    int num_active_workers() {
+        return static_cast<int>(m_num_std_workers.load()) - static_cast<int>(m_num_sleeping_workers.load()) -
+            static_cast<int>(m_num_blocked_workers.load());
+    }
 
-    lean_task_object * dequeue() {
-        lean_assert(m_queues_size != 0);
-        std::deque<lean_task_object *> & q = m_queues[m_max_prio];
-        lean_assert(!q.empty());
-        lean_task_object * result      = q.front();
+    bool can_spawn_worker() {
+        unsigned n = m_num_std_workers.load();
+        return n - m_num_blocked_workers.load() < m_max_std_workers && n < m_max_std_workers + LEAN_MAX_SPARE_WORKERS;
+    }
+
+    /* Must be invoked with `m_mutex` locked. */
+    void wake_or_spawn_worker() {
+        if (m_num_sleeping_workers.load() == 0 && can_spawn_worker())
+            spawn_worker();
+        else
+            m_queue_cv.notify_one();
+    }
+
+    unsigned num_queued_tasks() {
+        unsigned n = 0;
+        for (unsigned prio = 0; prio <= LEAN_MAX_PRIO; prio++)
+            n += m_queues_size[prio].load(memory_order_relaxed);
+        return n;
+    }
+
+    bool has_queued_tasks() {
+        for (unsigned prio = 0; prio <= LEAN_MAX_PRIO; prio++) {
+            if (m_queues_size[prio].load() != 0)
+                return true;
+        }
+        return false;
+    }
+
+    lean_task_object * dequeue_injected(unsigned prio) {
+        if (m_inject_queues_size.load(memory_order_relaxed) == 0)
+            return nullptr;
+        lock_guard<mutex> lock(m_inject_mutex);
+        std::deque<lean_task_object *> & q = m_inject_queues[prio];
+        if (q.empty())
+            return nullptr;
+        lean_task_object * result = q.front();
         q.pop_front();
-        m_queues_size--;
-        if (q.empty()) {
-            while (m_max_prio > 0) {
-                --m_max_prio;
-                if (!m_queues[m_max_prio].empty())
-                    break;
+        m_inject_queues_size--;
+        return result;
+    }
+
+    lean_task_object * steal(task_worker & w, unsigned prio) {
+        unsigned n = m_num_std_workers.load(memory_order_acquire);
+        for (unsigned i = 1; i < n; i++) {
+            task_worker & victim = m_workers[(w.m_idx + i) % n];
+            if (lean_task_object * t = victim.m_queues[prio].steal())
+                return t;
+        }
+        return nullptr;
+    }
+
+    /* Take a task of the highest priority available, preferring the worker's own queue. */
+    lean_task_object * dequeue(task_worker & w) {
+        for (unsigned prio = LEAN_MAX_PRIO + 1; prio-- > 0;) {
+            if (m_queues_size[prio].load(memory_order_relaxed) == 0)
+                continue;
+            lean_task_object * t = w.m_queues[prio].steal();
+            if (!t) t = dequeue_injected(prio);
+            if (!t) t = steal(w, prio);
+            if (t) {
+                m_queues_size[prio]--;
+                return t;
             }
         }
-        return result;
+        return nullptr;
     }
 
     void enqueue_core(lean_task_object * t) {
         lean_assert(t->m_imp);
         unsigned prio = t->m_imp->m_prio;
+        if (LEAN_UNLIKELY(g_task_trace))
+            task_trace_enqueue(t, get_task_fn(t->m_imp->m_closure), prio, num_queued_tasks() + 1);
         if (prio > LEAN_MAX_PRIO) {
             spawn_dedicated_worker(t);
             return;
         }
-        if (prio > m_max_prio)
-            m_max_prio = prio;
-        m_queues[prio].push_back(t);
-        m_queues_size++;
-        if (!m_idle_std_workers && m_num_std_workers < m_max_std_workers)
-            spawn_worker();
-        else
-            m_queue_cv.notify_one();
+        if (task_worker * w = g_current_worker) {
+            w->m_queues[prio].push(t);
+        } else {
+            lock_guard<mutex> lock(m_inject_mutex);
+            m_inject_queues[prio].push_back(t);
+            m_inject_queues_size++;
+        }
+        m_queues_size[prio]++;
+        /* The sequentially consistent increment above and load below make sure that either this thread sees
+           a worker that is about to sleep, or the worker sees the new task (see `spawn_worker`). */
+        if (m_num_sleeping_workers.load() == 0 && !can_spawn_worker())
+            return;
+        unique_lock<mutex> lock(m_mutex);
+        wake_or_spawn_worker();
     }
 
     void deactivate_task_core(unique_lock<mutex> & lock, lean_task_object * t) {
@@ -640,52 +835,71 @@ class task_manager {
             it = next_it;
         }
         if (c) dec_ref(c);
-        lock.lock();
     }
 
+    /* Must be invoked with `m_mutex` locked. */
     void spawn_worker() {
-        m_num_std_workers++;
-        lthread([this]() {
+        unsigned idx = m_num_std_workers.load();
+        task_worker * w = &m_workers[idx];
+        m_num_std_workers.store(idx + 1, memory_order_release);
+        lthread([this, w]() {
             save_stack_info(false);
-            unique_lock<mutex> lock(m_mutex);
-            m_idle_std_workers++;
+            g_current_worker = w;
+            if (g_task_trace)
+                task_trace_set_thread_name("worker " + std::to_string(w->m_idx));
             while (true) {
-                if (m_queues_size == 0) {
-                    if (m_shutting_down) {
-                        break;
+                /* Leave the tasks to other workers if there are too many active ones because a blocked worker resumed */
+                if (num_active_workers() <= static_cast<int>(m_max_std_workers)) {
+                    if (lean_task_object * t = dequeue(*w)) {
+                        run_task(t);
+                        reset_heartbeat();
+                        continue;
                     }
-                    m_queue_cv.wait(lock);
+                }
+                unique_lock<mutex> lock(m_mutex);
+                m_num_sleeping_workers++;
+                if (has_queued_tasks() && num_active_workers() < static_cast<int>(m_max_std_workers)) {
+                    m_num_sleeping_workers--;
                     continue;
                 }
-
-                lean_task_object * t = dequeue();
-                m_idle_std_workers--;
-                run_task(lock, t);
-                m_idle_std_workers++;
-                reset_heartbeat();
+                /* Dedicated workers may still enqueue tasks */
+                if (m_shutting_down && m_num_dedicated_workers == 0) {
+                    m_num_sleeping_workers--;
+                    break;
+                }
+                m_queue_cv.wait(lock);
+                m_num_sleeping_workers--;
             }
-            m_idle_std_workers--;
-            m_num_std_workers--;
+            g_current_worker = nullptr;
+            unique_lock<mutex> lock(m_mutex);
+            m_num_finished_std_workers++;
             m_worker_finished_cv.notify_all();
         });
         // `lthread` will be implicitly freed, which frees up its control resources but does not terminate the thread
     }
 
     void spawn_dedicated_worker(lean_task_object * t) {
+        unique_lock<mutex> lock(m_mutex);
         m_num_dedicated_workers++;
         lthread([this, t]() {
             save_stack_info(false);
+            if (g_task_trace)
+                task_trace_set_thread_name("dedicated worker");
+            run_task(t);
             unique_lock<mutex> lock(m_mutex);
-            run_task(lock, t);
             m_num_dedicated_workers--;
             m_worker_finished_cv.notify_all();
+            if (m_shutting_down)
+                m_queue_cv.notify_all();
         });
         // see above
     }
 
-    void run_task(unique_lock<mutex> & lock, lean_task_object * t) {
+    void run_task(lean_task_object * t) {
+        unique_lock<mutex> lock(get_task_mutex(t));
         lean_assert(t->m_imp);
         if (t->m_imp->m_deleted) {
+            lock.unlock();
             free_task(t);
             return;
         }
@@ -694,9 +908,16 @@ class task_manager {
         {
             scoped_current_task_object scope_cur_task(t);
             object * c = t->m_imp->m_closure;
+            unsigned prio = t->m_imp->m_prio;
             t->m_imp->m_closure = nullptr;
             lock.unlock();
+            uint64_t start = LEAN_UNLIKELY(g_task_trace) ? task_trace_now() : 0;
+            void * fn      = LEAN_UNLIKELY(g_task_trace) ? get_task_fn(c) : nullptr;
             v = lean_apply_1(c, box(0));
+            if (LEAN_UNLIKELY(g_task_trace))
+                task_trace_run(t, fn, prio, start);
+            if (v != nullptr)
+                mark_mt(v);
             // If deactivation was delayed by `m_keep_alive`, deactivate after the final execution (`v != nulltpr`)
             if (v != nullptr && t->m_imp->m_keep_alive) {
                 lean_dec_ref((lean_object*)t);
@@ -708,38 +929,51 @@ class task_manager {
             lock.unlock();
             if (v) lean_dec(v);
             free_task(t);
-            lock.lock();
         } else if (v != nullptr) {
             lean_assert(t->m_imp->m_closure == nullptr);
-            resolve_core(t, v);
+            resolve_core(lock, t, v);
         } else {
             // `bind` task has not finished yet, re-add as dependency of nested task
+            lean_task_object * t1 = lean_to_task(closure_arg_cptr(t->m_imp->m_closure)[0]);
             lock.unlock();
-            add_dep(lean_to_task(closure_arg_cptr(t->m_imp->m_closure)[0]), t);
-            lock.lock();
+            add_dep(t1, t);
         }
     }
 
-    void resolve_core(lean_task_object * t, object * v) {
-        handle_finished(t);
-        mark_mt(v);
+    /* Must be invoked with the lock of `t` held, and releases it. `v` must have been marked as MT. */
+    void resolve_core(unique_lock<mutex> & lock, lean_task_object * t, object * v) {
+        lean_task_object * deps = t->m_imp->m_head_dep;
+        bool canceled           = t->m_imp->m_canceled;
         t->m_value = v;
-        /* After the task has been finished and we propagated
-           dependencies, we can release `m_imp` and keep just the value */
+        /* After the task has been finished, we can release `m_imp` and keep just the value */
         free_task_imp(t->m_imp);
         t->m_imp   = nullptr;
-        m_task_finished_cv.notify_all();
+        if (LEAN_UNLIKELY(g_task_trace))
+            task_trace_resolve(t);
+        task_bucket & b = get_task_bucket(t);
+        if (b.m_num_waiters > 0)
+            b.m_cv.notify_all();
+        lock.unlock();
+        if (m_num_wait_any.load() > 0) {
+            lock_guard<mutex> wait_any_lock(m_wait_any_mutex);
+            m_wait_any_cv.notify_all();
+        }
+        handle_finished(deps, canceled);
     }
 
-    void handle_finished(lean_task_object * t) {
-        lean_task_object * it = t->m_imp->m_head_dep;
-        t->m_imp->m_head_dep = nullptr;
+    void handle_finished(lean_task_object * it, bool canceled) {
         while (it) {
-            if (t->m_imp->m_canceled)
-                it->m_imp->m_canceled = true;
-            lean_task_object * next_it = it->m_imp->m_next_dep;
-            it->m_imp->m_next_dep = nullptr;
-            if (it->m_imp->m_deleted) {
+            bool deleted;
+            lean_task_object * next_it;
+            {
+                lock_guard<mutex> lock(get_task_mutex(it));
+                if (canceled)
+                    it->m_imp->m_canceled = true;
+                next_it = it->m_imp->m_next_dep;
+                it->m_imp->m_next_dep = nullptr;
+                deleted = it->m_imp->m_deleted;
+            }
+            if (deleted) {
                 free_task(it);
             } else {
                 enqueue_core(it);
@@ -761,7 +995,11 @@ class task_manager {
 
 public:
     task_manager(unsigned max_std_workers):
-        m_max_std_workers(max_std_workers) {
+        m_max_std_workers(max_std_workers), m_workers(new task_worker[max_std_workers + LEAN_MAX_SPARE_WORKERS]) {
+        for (unsigned i = 0; i < max_std_workers + LEAN_MAX_SPARE_WORKERS; i++)
+            m_workers[i].m_idx = i;
+        for (unsigned prio = 0; prio <= LEAN_MAX_PRIO; prio++)
+            m_queues_size[prio].store(0);
     }
 
     ~task_manager() {
@@ -769,21 +1007,24 @@ public:
         m_shutting_down = true;
         m_queue_cv.notify_all();
         // wait for all workers to finish
-        m_worker_finished_cv.wait(lock, [&]() { return m_num_std_workers + m_num_dedicated_workers == 0; });
+        m_worker_finished_cv.wait(lock, [&]() {
+            return m_num_finished_std_workers == m_num_std_workers.load() && m_num_dedicated_workers == 0;
+        });
     }
 
     void enqueue(lean_task_object * t) {
-        unique_lock<mutex> lock(m_mutex);
         enqueue_core(t);
     }
 
     void resolve(lean_task_object * t, object * v) {
-        unique_lock<mutex> lock(m_mutex);
+        mark_mt(v);
+        unique_lock<mutex> lock(get_task_mutex(t));
         if (t->m_value) {
+            lock.unlock();
             dec(v);
             return;
         }
-        resolve_core(t, v);
+        resolve_core(lock, t, v);
     }
 
     void add_dep(lean_task_object * t1, lean_task_object * t2) {
@@ -792,38 +1033,104 @@ public:
             enqueue(t2);
             return;
         }
+        {
+            lock_guard<mutex> lock(get_task_mutex(t1));
+            if (!t1->m_value) {
+                t2->m_imp->m_next_dep = t1->m_imp->m_head_dep;
+                t1->m_imp->m_head_dep = t2;
+                return;
+            }
+        }
+        enqueue(t2);
+    }
+
+    /* Run `t` on the current worker if it is still in the worker's own queue, which is the case when it has
+       just been spawned by the waiting task. */
+    bool try_run_inline(task_worker & w, lean_task_object * t) {
+        // The stack is shared with the waiting task
+        if (get_used_stack_size() > get_available_stack_size())
+            return false;
+        for (unsigned prio = 0; prio <= LEAN_MAX_PRIO; prio++) {
+            if (w.m_queues[prio].pop_if(t)) {
+                m_queues_size[prio]--;
+                uint64_t heartbeats = get_num_heartbeats();
+                {
+                    scope_heartbeat scope_hb(0);
+                    run_task(t);
+                }
+                // do not charge the waiting task for the allocations of `t`
+                set_num_heartbeats(heartbeats);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* The current worker is about to block, let another worker run the queued tasks in the meantime. */
+    void begin_blocking() {
         unique_lock<mutex> lock(m_mutex);
-        lean_assert(t2->m_value == nullptr);
-        if (t1->m_value) {
-            enqueue_core(t2);
+        m_num_blocked_workers++;
+        if (has_queued_tasks())
+            wake_or_spawn_worker();
+    }
+
+    void end_blocking() {
+        m_num_blocked_workers--;
+    }
+
+    void wait_for_core(lean_task_object * t) {
+        task_worker * w = g_current_worker;
+        if (w && try_run_inline(*w, t) && t->m_value)
             return;
+        if (w)
+            begin_blocking();
+        task_bucket & b = get_task_bucket(t);
+        unique_lock<mutex> lock(b.m_mutex);
+        b.m_num_waiters++;
+        b.m_cv.wait(lock, [&]() { return t->m_value != nullptr; });
+        b.m_num_waiters--;
+        if (w)
+            end_blocking();
+    }
+
+    object * wait_any_core(object * task_list) {
+        task_worker * w = g_current_worker;
+        if (w)
+            begin_blocking();
+        unique_lock<mutex> lock(m_wait_any_mutex);
+        m_num_wait_any++;
+        while (true) {
+            if (object * t = wait_any_check(task_list)) {
+                m_num_wait_any--;
+                if (w)
+                    end_blocking();
+                return t;
+            }
+            m_wait_any_cv.wait(lock);
         }
-        t2->m_imp->m_next_dep = t1->m_imp->m_head_dep;
-        t1->m_imp->m_head_dep = t2;
     }
 
     void wait_for(lean_task_object * t) {
         if (t->m_value)
             return;
-        unique_lock<mutex> lock(m_mutex);
-        if (t->m_value)
-            return;
-        m_task_finished_cv.wait(lock, [&]() { return t->m_value != nullptr; });
+        uint64_t start = LEAN_UNLIKELY(g_task_trace) ? task_trace_now() : 0;
+        wait_for_core(t);
+        if (LEAN_UNLIKELY(g_task_trace))
+            task_trace_wait(t, start);
     }
 
     object * wait_any(object * task_list) {
         if (object * t = wait_any_check(task_list))
             return t;
-        unique_lock<mutex> lock(m_mutex);
-        while (true) {
-            if (object * t = wait_any_check(task_list))
-                return t;
-            m_task_finished_cv.wait(lock);
-        }
+        uint64_t start = LEAN_UNLIKELY(g_task_trace) ? task_trace_now() : 0;
+        object * t = wait_any_core(task_list);
+        if (LEAN_UNLIKELY(g_task_trace))
+            task_trace_wait(nullptr, start);
+        return t;
     }
 
     void deactivate_task(lean_task_object * t) {
-        unique_lock<mutex> lock(m_mutex);
+        unique_lock<mutex> lock(get_task_mutex(t));
         if (object * v = t->m_value) {
             lean_assert(t->m_imp == nullptr);
             lock.unlock();
@@ -837,7 +1144,7 @@ public:
     }
 
     void cancel(lean_task_object * t) {
-        unique_lock<mutex> lock(m_mutex);
+        lock_guard<mutex> lock(get_task_mutex(t));
         if (t->m_imp)
             t->m_imp->m_canceled = true;
     }
@@ -845,6 +1152,10 @@ public:
     bool shutting_down() const {
         return m_shutting_down;
     }
+
+    unsigned max_std_workers() const {
+        return m_max_std_workers;
+    }
 };
 
 static task_manager * g_task_manager = nullptr;
@@ -995,6 +1306,21 @@ static obj_res task_bind_fn1(obj_arg x, obj_arg f, obj_arg) {
     return nullptr; /* notify queue that task did not finish yet. */
 }
 
+/* Function to use as the label of a task running closure `c` in traces */
+static void * get_task_fn(object * c) {
+    if (c == nullptr || !lean_is_closure(c))
+        return nullptr;
+    void * fn = lean_closure_fun(c);
+    object * f = nullptr;
+    if (fn == reinterpret_cast<void *>(task_map_fn))
+        f = lean_closure_arg_cptr(c)[0];
+    else if (fn == reinterpret_cast<void *>(task_bind_fn1))
+        f = lean_closure_arg_cptr(c)[1];
+    if (f != nullptr && !lean_is_scalar(f) && lean_is_closure(f))
+        return lean_closure_fun(f);
+    return fn;
+}
+
 extern "C" LEAN_EXPORT obj_res lean_task_bind_core(obj_arg x, obj_arg f, unsigned prio, bool keep_alive) {
     if (!g_task_manager) {
         return apply_1(f, lean_task_get_own(x));
@@ -1023,6 +1349,10 @@ extern "C" LEAN_EXPORT bool lean_io_has_finished_core(b_obj_arg t) {
     return lean_to_task(t)->m_value != nullptr;
 }
 
+extern "C" LEAN_EXPORT unsigned lean_io_get_num_task_workers_core() {
+    return g_task_manager ? g_task_manager->max_std_workers() : 0;
+}
+
 extern "C" LEAN_EXPORT b_obj_res lean_io_wait_any_core(b_obj_arg task_list) {
     return g_task_manager->wait_any(task_list);
 }
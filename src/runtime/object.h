@@ -338,6 +338,9 @@ inline uint8 nat_dec_lt(b_obj_arg a1, b_obj_arg a2) { return lean_nat_dec_lt(a1,
 inline obj_res nat_land(b_obj_arg a1, b_obj_arg a2) { return lean_nat_land(a1, a2); }
 inline obj_res nat_lor(b_obj_arg a1, b_obj_arg a2) { return lean_nat_lor(a1, a2); }
 inline obj_res nat_lxor(b_obj_arg a1, b_obj_arg a2) { return lean_nat_lxor(a1, a2); }
+inline obj_res nat_shiftl(b_obj_arg a1, b_obj_arg a2) { return lean_nat_shiftl(a1, a2); }
+inline obj_res nat_shiftr(b_obj_arg a1, b_obj_arg a2) { return lean_nat_shiftr(a1, a2); }
+inline obj_res nat_log2(b_obj_arg a) { return lean_nat_log2(a); }
 
 // =======================================
 // Integers
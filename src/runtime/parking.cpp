@@ -0,0 +1,19 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#include <stdint.h>
+#include "runtime/parking.h"
+
+#define LEAN_NUM_PARKING_BUCKETS 256
+
+namespace lean {
+static parking_bucket g_parking_buckets[LEAN_NUM_PARKING_BUCKETS];
+
+parking_bucket & get_parking_bucket(void const * addr) {
+    uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(addr)) * 0x9E3779B97F4A7C15ull;
+    return g_parking_buckets[h >> 56];
+}
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#pragma once
+#include "runtime/thread.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* Number of times a thread checks its condition before parking */
+#define LEAN_PARKING_SPIN_ITERATIONS 128
+
+namespace lean {
+/* Parking lot: threads waiting for a condition on a memory location (e.g., the value of a thunk being set by another
+   thread) are parked on a bucket selected by hashing the address of the location, and woken up by `unpark_all`
+   with the same address. As with futexes, no memory needs to be reserved for each location, and waking up a location
+   nobody is waiting for only costs a load. */
+struct parking_bucket {
+    mutex              m_mutex;
+    condition_variable m_cv;
+    atomic<unsigned>   m_num_waiters{0};
+};
+
+parking_bucket & get_parking_bucket(void const * addr);
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/* Block the current thread until `ready()` holds. After a bounded number of checks, the thread is parked until
+   `unpark_all(addr)` is invoked. */
+template<typename F> void park_until(void const * addr, F && ready) {
+    for (unsigned i = 0; i < LEAN_PARKING_SPIN_ITERATIONS; i++) {
+        if (ready())
+            return;
+        cpu_relax();
+    }
+    parking_bucket & b = get_parking_bucket(addr);
+    unique_lock<mutex> lock(b.m_mutex);
+    b.m_num_waiters++;
+    while (!ready())
+        b.m_cv.wait(lock);
+    b.m_num_waiters--;
+}
+
+/* Wake up the threads parked on `addr`. The condition they are waiting for must have been established using a
+   sequentially consistent operation. */
+inline void unpark_all(void const * addr) {
+    parking_bucket & b = get_parking_bucket(addr);
+    if (b.m_num_waiters.load() != 0) {
+        lock_guard<mutex> lock(b.m_mutex);
+        b.m_cv.notify_all();
+    }
+}
+}
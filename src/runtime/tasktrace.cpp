@@ -0,0 +1,371 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if defined(LEAN_WINDOWS)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "runtime/thread.h"
+#include "runtime/heapprof.h"
+#include "runtime/object.h"
+#include "runtime/io.h"
+#include "runtime/tasktrace.h"
+
+#ifndef LEAN_DEFAULT_TASK_TRACE_BUFFER_SIZE
+#define LEAN_DEFAULT_TASK_TRACE_BUFFER_SIZE (1u << 18)
+#endif
+
+namespace lean {
+atomic<bool> g_task_trace(false);
+/* Maximum number of events kept by each thread */
+static size_t g_task_trace_buffer_size = LEAN_DEFAULT_TASK_TRACE_BUFFER_SIZE;
+
+enum class task_event_kind : uint8_t { Enqueue, Run, Resolve, Wait };
+
+struct task_event {
+    uint64_t           m_start;
+    /* end of `Run` and `Wait` events */
+    uint64_t           m_end;
+    lean_task_object * m_task;
+    void *             m_fn;
+    /* number of queued tasks for `Enqueue` events */
+    unsigned           m_num_queued;
+    task_event_kind    m_kind;
+    uint8_t            m_prio;
+};
+
+/* Events recorded by a thread. The mutex is only contended while the trace is being started or written. */
+struct task_trace_buffer {
+    mutex                   m_mutex;
+    unsigned                m_tid;
+    std::string             m_name;
+    /* Ring buffer containing the last `g_task_trace_buffer_size` events */
+    std::vector<task_event> m_events;
+    /* Number of events recorded since the trace was started, the next event is stored at `m_num_events % size` once
+       the buffer is full. */
+    uint64_t                m_num_events{0};
+
+    void push(task_event const & e) {
+        if (m_events.size() < g_task_trace_buffer_size)
+            m_events.push_back(e);
+        else
+            m_events[m_num_events % m_events.size()] = e;
+        m_num_events++;
+    }
+
+    /* Apply `f` to the events from the oldest to the newest one. */
+    template<typename F> void for_each(F && f) const {
+        size_t first = m_num_events > m_events.size() ? m_num_events % m_events.size() : 0;
+        for (size_t i = 0; i < m_events.size(); i++)
+            f(m_events[(first + i) % m_events.size()]);
+    }
+
+    uint64_t num_dropped() const { return m_num_events - m_events.size(); }
+
+    void clear() {
+        m_events.clear();
+        m_num_events = 0;
+    }
+};
+
+LEAN_THREAD_PTR(task_trace_buffer, g_task_trace_buffer);
+
+static unsigned get_pid() {
+#if defined(LEAN_WINDOWS)
+    return GetCurrentProcessId();
+#else
+    return getpid();
+#endif
+}
+
+static std::string json_escape(std::string const & s) {
+    std::string r;
+    for (char c : s) {
+        switch (c) {
+        case '"':  r += "\\\""; break;
+        case '\\': r += "\\\\"; break;
+        case '\n': r += "\\n"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                r += buf;
+            } else {
+                r.push_back(c);
+            }
+        }
+    }
+    return r;
+}
+
+class task_tracer {
+    mutex                                           m_mutex;
+    std::string                                     m_fname;
+    std::chrono::steady_clock::time_point           m_start_time;
+    std::vector<std::unique_ptr<task_trace_buffer>> m_buffers;
+    std::unordered_map<void *, std::string>         m_fn_names;
+
+    std::string const & get_fn_name(void * fn) {
+        auto it = m_fn_names.find(fn);
+        if (it != m_fn_names.end())
+            return it->second;
+        return m_fn_names.emplace(fn, fn ? json_escape(get_function_name(fn)) : std::string("task")).first->second;
+    }
+
+    /* Write the events recorded so far to `fname`. `m_mutex` must be held. */
+    bool write(char const * fname);
+
+public:
+    task_tracer():m_start_time(std::chrono::steady_clock::now()) {}
+
+    /* Return false if tracing was already enabled. */
+    bool start(std::string const & fname) {
+        lock_guard<mutex> lock(m_mutex);
+        if (g_task_trace)
+            return false;
+        m_fname = fname;
+        for (auto const & b : m_buffers) {
+            lock_guard<mutex> buffer_lock(b->m_mutex);
+            b->clear();
+        }
+        g_task_trace = true;
+        return true;
+    }
+
+    /* Return false if the trace could not be written. */
+    bool stop() {
+        lock_guard<mutex> lock(m_mutex);
+        if (!g_task_trace)
+            return true;
+        /* Threads that have already tested `g_task_trace` may still add events, they are discarded by the next
+           `start`. */
+        g_task_trace = false;
+        return write(m_fname.c_str());
+    }
+
+    std::string get_fname() {
+        lock_guard<mutex> lock(m_mutex);
+        return m_fname;
+    }
+
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start_time).count();
+    }
+
+    task_trace_buffer & get_buffer() {
+        if (!g_task_trace_buffer) {
+            lock_guard<mutex> lock(m_mutex);
+            task_trace_buffer * b = new task_trace_buffer();
+            b->m_tid  = m_buffers.size() + 1;
+            b->m_name = "thread " + std::to_string(b->m_tid);
+            m_buffers.emplace_back(b);
+            g_task_trace_buffer = b;
+        }
+        return *g_task_trace_buffer;
+    }
+
+    void add(task_event const & e) {
+        task_trace_buffer & b = get_buffer();
+        lock_guard<mutex> lock(b.m_mutex);
+        b.push(e);
+    }
+
+    void set_thread_name(std::string const & name) {
+        task_trace_buffer & b = get_buffer();
+        lock_guard<mutex> lock(b.m_mutex);
+        b.m_name = name;
+    }
+};
+
+bool task_tracer::write(char const * fname) {
+    std::ofstream out(fname);
+    if (!out)
+        return false;
+    unsigned pid = get_pid();
+    uint64_t num_dropped = 0;
+    std::vector<std::pair<task_event, unsigned>> events;
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":\"lean\"}}";
+    for (auto const & b : m_buffers) {
+        lock_guard<mutex> buffer_lock(b->m_mutex);
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << b->m_tid
+            << ",\"args\":{\"name\":\"" << json_escape(b->m_name) << "\"}}";
+        b->for_each([&](task_event const & e) { events.emplace_back(e, b->m_tid); });
+        num_dropped += b->num_dropped();
+    }
+    std::stable_sort(events.begin(), events.end(), [](std::pair<task_event, unsigned> const & e1, std::pair<task_event, unsigned> const & e2) {
+        return e1.first.m_start < e2.first.m_start;
+    });
+    /* enqueue time and function of the tasks that have been enqueued, used to compute the time spent in queues
+       and to label the tasks being waited for */
+    std::unordered_map<lean_task_object *, uint64_t> enqueued;
+    std::unordered_map<lean_task_object *, void *> task_fns;
+    char buf[64];
+    auto ts = [&](uint64_t t) {
+        snprintf(buf, sizeof(buf), "%.3f", t / 1000.0);
+        return std::string(buf);
+    };
+    auto task_id = [&](lean_task_object * t) {
+        snprintf(buf, sizeof(buf), "\"%p\"", static_cast<void *>(t));
+        return std::string(buf);
+    };
+    for (auto const & p : events) {
+        task_event const & e = p.first;
+        std::string common = ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(p.second);
+        switch (e.m_kind) {
+        case task_event_kind::Enqueue:
+            enqueued[e.m_task] = e.m_start;
+            task_fns[e.m_task] = e.m_fn;
+            out << ",\n{\"name\":\"enqueue\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts(e.m_start) << common
+                << ",\"args\":{\"task\":" << task_id(e.m_task) << ",\"label\":\"" << get_fn_name(e.m_fn)
+                << "\",\"prio\":" << static_cast<unsigned>(e.m_prio) << "}}";
+            out << ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"s\",\"id\":" << task_id(e.m_task)
+                << ",\"ts\":" << ts(e.m_start) << common << "}";
+            out << ",\n{\"name\":\"queued tasks\",\"ph\":\"C\",\"ts\":" << ts(e.m_start) << ",\"pid\":" << pid
+                << ",\"args\":{\"tasks\":" << e.m_num_queued << "}}";
+            break;
+        case task_event_kind::Run: {
+            out << ",\n{\"name\":\"" << get_fn_name(e.m_fn) << "\",\"cat\":\"task\",\"ph\":\"X\",\"ts\":" << ts(e.m_start)
+                << ",\"dur\":" << ts(e.m_end - e.m_start) << common << ",\"args\":{\"task\":" << task_id(e.m_task)
+                << ",\"prio\":" << static_cast<unsigned>(e.m_prio);
+            auto it = enqueued.find(e.m_task);
+            if (it != enqueued.end())
+                out << ",\"queued_us\":" << ts(e.m_start - it->second);
+            out << "}}";
+            if (it != enqueued.end()) {
+                out << ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << task_id(e.m_task)
+                    << ",\"ts\":" << ts(e.m_start) << common << "}";
+                enqueued.erase(it);
+            }
+            break;
+        }
+        case task_event_kind::Resolve:
+            out << ",\n{\"name\":\"resolve\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts(e.m_start) << common
+                << ",\"args\":{\"task\":" << task_id(e.m_task) << "}}";
+            task_fns.erase(e.m_task);
+            break;
+        case task_event_kind::Wait:
+            out << ",\n{\"name\":\"" << (e.m_task ? "wait" : "wait any") << "\",\"cat\":\"task\",\"ph\":\"X\",\"ts\":"
+                << ts(e.m_start) << ",\"dur\":" << ts(e.m_end - e.m_start) << common << ",\"args\":{";
+            if (e.m_task) {
+                out << "\"task\":" << task_id(e.m_task);
+                auto it = task_fns.find(e.m_task);
+                if (it != task_fns.end())
+                    out << ",\"label\":\"" << get_fn_name(it->second) << "\"";
+            }
+            out << "}}";
+            break;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << num_dropped << "}}\n";
+    return static_cast<bool>(out);
+}
+
+static task_tracer * g_task_tracer = nullptr;
+
+static mutex * g_task_tracer_mutex = nullptr;
+
+static void write_task_trace_at_exit() {
+    if (!stop_task_trace())
+        std::cerr << "failed to write task trace to '" << g_task_tracer->get_fname() << "'\n";
+}
+
+void start_task_trace(char const * fname) {
+    std::string f(fname);
+    size_t pos = f.find("%p");
+    if (pos != std::string::npos)
+        f.replace(pos, 2, std::to_string(get_pid()));
+    {
+        lock_guard<mutex> lock(*g_task_tracer_mutex);
+        if (!g_task_tracer) {
+            /* The tracer is never deleted: threads may still be adding events after tracing is stopped. */
+            g_task_tracer = new task_tracer();
+            g_task_tracer->set_thread_name("main");
+            std::atexit(write_task_trace_at_exit);
+        }
+    }
+    g_task_tracer->start(f);
+}
+
+bool stop_task_trace() {
+    return !g_task_tracer || g_task_tracer->stop();
+}
+
+uint64_t task_trace_now() {
+    return g_task_tracer ? g_task_tracer->now() : 0;
+}
+
+void task_trace_set_thread_name(std::string const & name) {
+    if (g_task_tracer)
+        g_task_tracer->set_thread_name(name);
+}
+
+static void add_event(task_event_kind kind, lean_task_object * t, void * fn, unsigned prio, uint64_t start, uint64_t end, unsigned num_queued = 0) {
+    if (!g_task_tracer || !g_task_trace)
+        return;
+    task_event e;
+    e.m_start      = start;
+    e.m_end        = end;
+    e.m_task       = t;
+    e.m_fn         = fn;
+    e.m_num_queued = num_queued;
+    e.m_kind       = kind;
+    e.m_prio       = static_cast<uint8_t>(std::min(prio, 255u));
+    g_task_tracer->add(e);
+}
+
+void task_trace_enqueue(lean_task_object * t, void * fn, unsigned prio, unsigned num_queued) {
+    uint64_t now = task_trace_now();
+    add_event(task_event_kind::Enqueue, t, fn, prio, now, now, num_queued);
+}
+
+void task_trace_run(lean_task_object * t, void * fn, unsigned prio, uint64_t start) {
+    add_event(task_event_kind::Run, t, fn, prio, start, task_trace_now());
+}
+
+void task_trace_resolve(lean_task_object * t) {
+    uint64_t now = task_trace_now();
+    add_event(task_event_kind::Resolve, t, nullptr, 0, now, now);
+}
+
+void task_trace_wait(lean_task_object * t, uint64_t start) {
+    add_event(task_event_kind::Wait, t, nullptr, 0, start, task_trace_now());
+}
+
+/* IO.startTaskTrace (fname : @& FilePath) : IO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_start_task_trace(b_obj_arg fname, obj_arg) {
+    start_task_trace(string_cstr(fname));
+    return io_result_mk_ok(box(0));
+}
+
+/* IO.stopTaskTrace : IO Unit */
+extern "C" LEAN_EXPORT obj_res lean_io_stop_task_trace(obj_arg) {
+    if (!stop_task_trace())
+        return io_result_mk_error("failed to write task trace to '" + g_task_tracer->get_fname() + "'");
+    return io_result_mk_ok(box(0));
+}
+
+void initialize_tasktrace() {
+    g_task_tracer_mutex = new mutex();
+#ifndef LEAN_EMSCRIPTEN
+    if (char const * size = std::getenv("LEAN_TASK_TRACE_BUFFER_SIZE"))
+        g_task_trace_buffer_size = std::max(1ul, std::strtoul(size, nullptr, 10));
+    if (char const * fname = std::getenv("LEAN_TASK_TRACE"))
+        start_task_trace(fname);
+#endif
+}
+}
@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2023 Microsoft Corporation. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Author: agent
+*/
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <lean/lean.h>
+#include "runtime/thread.h"
+
+namespace lean {
+/* Task tracing.
+   When enabled, the task manager records timestamped events for tasks being enqueued, run, and resolved, and for
+   threads waiting for tasks. They are written in the Chrome trace event format, which can be viewed
+   using `chrome://tracing` or https://ui.perfetto.dev. Tasks are labelled with the Lean declaration implementing
+   them, and the time a task spent in a queue before running is stored in the arguments of its `run` event.
+
+   Tracing is enabled by setting the environment variable `LEAN_TASK_TRACE` to the output file name, or using
+   the `--task-trace=file` option of the `lean` executable. `%p` in the file name is replaced with the process id,
+   so that the environment variable can also be used with processes starting other `lean` processes, such as
+   `lake build` and the language server. It can also be started and stopped at any time using `IO.startTaskTrace`
+   and `IO.stopTaskTrace`, which writes the trace; otherwise it is written at exit.
+
+   Each thread keeps its events in a ring buffer of `LEAN_TASK_TRACE_BUFFER_SIZE` events (default: 2^18), so
+   only the most recent events of long-running processes are written. */
+
+/* True if task tracing is enabled. */
+extern atomic<bool> g_task_trace;
+
+/* Start recording events, discarding the events of previous traces. Do nothing if tracing is already enabled. */
+void start_task_trace(char const * fname);
+/* Stop recording events and write the trace. Return false if the trace could not be written. */
+bool stop_task_trace();
+/* Current timestamp in nanoseconds */
+uint64_t task_trace_now();
+/* Name the current thread in the trace. */
+void task_trace_set_thread_name(std::string const & name);
+/* `t` is enqueued with priority `prio`, and will execute function `fn`. `num_queued` is the total number of tasks in the queues. */
+void task_trace_enqueue(lean_task_object * t, void * fn, unsigned prio, unsigned num_queued);
+/* `t` executed function `fn` since `start` */
+void task_trace_run(lean_task_object * t, void * fn, unsigned prio, uint64_t start);
+/* `t` has been resolved */
+void task_trace_resolve(lean_task_object * t);
+/* The current thread waited for `t` (or for any task in a list if `t` is null) since `start`. */
+void task_trace_wait(lean_task_object * t, uint64_t start);
+void initialize_tasktrace();
+}
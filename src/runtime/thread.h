@@ -88,8 +88,8 @@ public:
     atomic & operator=(atomic const & v) { m_value = v.m_value; return *this; }
     atomic & operator=(atomic && v) { m_value = std::forward<T>(v.m_value); return *this; }
     operator T() const { return m_value; }
-    void store(T const & v) { m_value = v; }
-    T load() const { return m_value; }
+    void store(T const & v, int = 0) { m_value = v; }
+    T load(int = 0) const { return m_value; }
     atomic & operator|=(T const & v) { m_value |= v; return *this; }
     atomic & operator+=(T const & v) { m_value += v; return *this; }
     atomic & operator-=(T const & v) { m_value -= v; return *this; }
@@ -102,7 +102,7 @@ public:
     friend T atomic_fetch_add_explicit(atomic * a, T const & v, int ) { T r(a->m_value); a->m_value += v; return r; }
     friend T atomic_fetch_sub_explicit(atomic * a, T const & v, int ) { T r(a->m_value); a->m_value -= v; return r; }
     T exchange(T desired) { T old = m_value; m_value = desired; return old; }
-    bool compare_exchange_strong(T & expected, T desired) {
+    bool compare_exchange_strong(T & expected, T desired, int = 0, int = 0) {
         if (m_value == expected) {
             m_value = desired;
             return true;
@@ -22,6 +22,8 @@ Author: Leonardo de Moura
 #include "runtime/load_dynlib.h"
 #include "runtime/array_ref.h"
 #include "runtime/object_ref.h"
+#include "runtime/heapprof.h"
+#include "runtime/tasktrace.h"
 #include "util/timer.h"
 #include "util/macros.h"
 #include "util/io.h"
@@ -223,6 +225,10 @@ static void display_help(std::ostream & out) {
     std::cout << "  --print-libdir     print the installation directory for Lean's built-in libraries and exit\n";
     std::cout << "  --profile          display elaboration/type checking time for each definition/theorem\n";
     std::cout << "  --stats            display environment statistics\n";
+    std::cout << "  --heap-profile=file write a profile of sampled allocations in pprof format to the given file at exit\n"
+              << "                     (sampling rate in bytes: LEAN_HEAP_PROFILE_RATE, default: 524288)\n";
+    std::cout << "  --task-trace=file  write a trace of the execution of tasks in Chrome trace event format to the given file at exit\n"
+              << "                     (`%p` is replaced with the process id)\n";
     DEBUG_CODE(
     std::cout << "  --debug=tag        enable assertions with the given tag\n";
         )
@@ -245,6 +251,8 @@ static struct option g_long_options[] = {
     {"trust",        required_argument, 0, 't'},
     {"profile",      no_argument,       0, 'P'},
     {"stats",        no_argument,       0, 'a'},
+    {"heap-profile", required_argument, 0, 'H'},
+    {"task-trace",   required_argument, 0, 'Y'},
     {"quiet",        no_argument,       0, 'q'},
     {"deps",         no_argument,       0, 'd'},
     {"deps-json",    no_argument,       0, 'J'},
@@ -599,6 +607,18 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
             case 'P':
                 opts = opts.update("profiler", true);
                 break;
+            case 'H': {
+                check_optarg("heap-profile");
+                size_t rate = 0;
+                if (char const * r = std::getenv("LEAN_HEAP_PROFILE_RATE"))
+                    rate = std::strtoull(r, nullptr, 10);
+                start_heap_profiler(optarg, rate);
+                break;
+            }
+            case 'Y':
+                check_optarg("task-trace");
+                start_task_trace(optarg);
+                break;
 #if defined(LEAN_DEBUG)
             case 'B':
                 check_optarg("B");
@@ -738,7 +758,7 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
         }
         if (olean_fn && ok) {
             time_task t(".olean serialization", opts);
-            write_module(env, *olean_fn);
+            write_module(env, *olean_fn, opts.get_bool("compressOLean"));
         }
 
         if (c_output && ok) {
@@ -0,0 +1,42 @@
+import Lean
+
+/-!
+Object compactor benchmark: serializes the data of all modules imported by `import Lean` into a single
+`.olean` file `n` times, and checks that reading it back produces the same constants. With the extra
+argument `stats`, it prints the throughput of `saveModuleData` instead of `ok`.
+-/
+open Lean
+
+def main : List String → IO UInt32
+  | n :: stats => do
+    initSearchPath (← findSysroot)
+    let env ← importModules #[{ module := `Lean }] {}
+    let mods := env.header.moduleData
+    let data : ModuleData := {
+      imports         := #[]
+      constNames      := mods.concatMap (·.constNames)
+      constants       := mods.concatMap (·.constants)
+      extraConstNames := mods.concatMap (·.extraConstNames)
+      entries         := mods.concatMap (·.entries)
+    }
+    let fname : System.FilePath := "compact.olean.tmp"
+    let n := n.toNat!
+    let start ← IO.monoNanosNow
+    for _ in [0:n] do
+      saveModuleData fname `Compact data
+    let time := (← IO.monoNanosNow) - start
+    let size := (← fname.metadata).byteSize
+    let (data', _) ← readModuleData fname
+    let ok := data'.constNames == data.constNames
+    IO.FS.removeFile fname
+    if !ok then
+      IO.println "mismatch"
+      return 1
+    if stats == ["stats"] then
+      let secs := time.toFloat / 1e9
+      IO.println s!"'constants/s': {(n * data.constants.size).toFloat / secs}"
+      IO.println s!"'MB/s': {(n * size.toNat).toFloat / 1e6 / secs}"
+    else
+      IO.println "ok"
+    return 0
+  | _ => return 1
@@ -0,0 +1,40 @@
+import Lean
+
+/-!
+Compressed `.olean` benchmark: saves the data of all modules imported by `import Init` as a single `.olean` file
+with and without compression, and reads each file `n` times, hashing all constant names so that the lazily mapped
+uncompressed file is actually loaded. Prints the size of both files and the average time to read them.
+-/
+open Lean
+
+unsafe def main : List String → IO UInt32
+  | [n] => do
+    initSearchPath (← findSysroot)
+    let env ← importModules #[{ module := `Init }] {}
+    let mods := env.header.moduleData
+    let data : ModuleData := {
+      imports         := #[]
+      constNames      := mods.concatMap (·.constNames)
+      constants       := mods.concatMap (·.constants)
+      extraConstNames := mods.concatMap (·.extraConstNames)
+      entries         := mods.concatMap (·.entries)
+    }
+    let n := n.toNat!
+    for compress in [false, true] do
+      let kind := if compress then "compressed" else "uncompressed"
+      let fname : System.FilePath := s!"{kind}.olean.tmp"
+      saveModuleData fname `CompressedOLean data compress
+      let size := (← fname.metadata).byteSize
+      let start ← IO.monoNanosNow
+      for _ in [0:n] do
+        let (data', region) ← readModuleData fname
+        if data'.constNames.foldl (mixHash · <| hash ·) 7 != data.constNames.foldl (mixHash · <| hash ·) 7 then
+          IO.println "mismatch"
+          return 1
+        region.free
+      let time := (← IO.monoNanosNow) - start
+      IO.FS.removeFile fname
+      IO.println s!"'{kind} MB': {size.toNat.toFloat / 1e6}"
+      IO.println s!"'{kind} read ms': {time.toFloat / 1e6 / n.toFloat}"
+    return 0
+  | _ => return 1
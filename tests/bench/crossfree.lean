@@ -0,0 +1,40 @@
+/-!
+Stress test for cross-thread deallocation: every tree is built on a short-lived
+dedicated thread and checked and freed by a different, long-running consumer
+thread, so almost every `dealloc` goes through the allocator's remote free path.
+-/
+inductive Tree
+  | nil
+  | node (l r : Tree)
+instance : Inhabited Tree := ⟨.nil⟩
+
+-- This function has an extra argument to suppress the
+-- common sub-expression elimination optimization
+partial def make' (n d : UInt32) : Tree :=
+  if d = 0 then .node .nil .nil
+  else .node (make' n (d - 1)) (make' (n + 1) (d - 1))
+
+def make (d : UInt32) := make' d d
+
+def check : Tree → UInt32
+  | .nil => 0
+  | .node l r => 1 + check l + check r
+
+-- receive `i` trees allocated by other threads, and free them on this one
+def consume (d : UInt32) : Nat → UInt32 → UInt32
+  | 0,   t => t
+  | i+1, t =>
+    let p := Task.spawn (prio := .dedicated) fun _ => make d
+    consume d i (t + check p.get)
+
+def main : List String → IO UInt32
+  | [n, d, i] => do
+    let n := n.toNat!
+    let d := d.toNat!
+    let i := i.toNat!
+    let consumers := (List.range n).map fun _ =>
+      Task.spawn (prio := .dedicated) fun _ => consume (.ofNat d) i 0
+    let c := consumers.foldl (fun c t => c + t.get) 0
+    IO.println s!"{n} threads, {i} trees of depth {d} each\t check: {c}"
+    return 0
+  | _ => return 1
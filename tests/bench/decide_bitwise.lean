@@ -0,0 +1,133 @@
+/-!
+  `decide` proofs over 256-bit values, as they appear in verified bit-vector and cryptography developments.
+  Both `Meta.whnf` and the kernel reduce `Nat.land`, `Nat.lor`, `Nat.xor`, `Nat.shiftLeft`, `Nat.shiftRight`, and
+  `Nat.log2` on literals using big-number operations instead of unfolding their definitions. `Int` operations on
+  literals reduce to the `Nat` ones. -/
+
+example : 0xa2d020b485f4ad6d3408fafffd2e5363f7634afe18e1be91ccee76e2f08d3e20 &&& 0x9d83255744e9215c2d84f0762d111ed35a61d57e5e8c82cd8b3cd96a83502b4b = 0x8080201404e0214c2400f0762d0012435261407e18808281882c506280002a00 := by decide
+example : 0xa2d020b485f4ad6d3408fafffd2e5363f7634afe18e1be91ccee76e2f08d3e20 ||| 0x9d83255744e9215c2d84f0762d111ed35a61d57e5e8c82cd8b3cd96a83502b4b = 0xbfd325f7c5fdad7d3d8cfafffd3f5ff3ff63dffe5eedbeddcffeffeaf3dd3f6b := by decide
+example : 0xa2d020b485f4ad6d3408fafffd2e5363f7634afe18e1be91ccee76e2f08d3e20 ^^^ 0x9d83255744e9215c2d84f0762d111ed35a61d57e5e8c82cd8b3cd96a83502b4b = 0x3f5305e3c11d8c31198c0a89d03f4db0ad029f80466d3c5c47d2af8873dd156b := by decide
+example : (0xa2d020b485f4ad6d3408fafffd2e5363f7634afe18e1be91ccee76e2f08d3e20 <<< 147) % 2^256 = 0x57f0c70df48e6773b7178469f100000000000000000000000000000000000000 := by decide
+example : 0xa2d020b485f4ad6d3408fafffd2e5363f7634afe18e1be91ccee76e2f08d3e20 >>> 147 = 0x000000000000000000000000000000000000145a041690be95ada6811f5fffa5 := by decide
+example : Nat.log2 0x9d83255744e9215c2d84f0762d111ed35a61d57e5e8c82cd8b3cd96a83502b4b = 255 := by decide
+example : (-0xa2d020b485f4ad6d3408fafffd2e5363f7634afe18e1be91ccee76e2f08d3e20 : Int) % 0x9d83255744e9215c2d84f0762d111ed35a61d57e5e8c82cd8b3cd96a83502b4b = -0x054cfb5d410b8c1106840a89d01d34909d01757fba553bc441b19d786d3d12d5 := by decide
+
+example : 0xb29cf0a3067c76d9a6a5be9256aa16bfa53b489c29a827b08ee50d83adbf1016 &&& 0x705f49b84792b45d178c13e0e7845acc667e04e4e4dcf2c42137c5dca46f6583 = 0x301c40a006103459068412804680128c243a00842088228000250580a42f0002 := by decide
+example : 0xb29cf0a3067c76d9a6a5be9256aa16bfa53b489c29a827b08ee50d83adbf1016 ||| 0x705f49b84792b45d178c13e0e7845acc667e04e4e4dcf2c42137c5dca46f6583 = 0xf2dff9bb47fef6ddb7adbff2f7ae5effe77f4cfcedfcf7f4aff7cddfadff7597 := by decide
+example : 0xb29cf0a3067c76d9a6a5be9256aa16bfa53b489c29a827b08ee50d83adbf1016 ^^^ 0x705f49b84792b45d178c13e0e7845acc667e04e4e4dcf2c42137c5dca46f6583 = 0xc2c3b91b41eec284b129ad72b12e4c73c3454c78cd74d574afd2c85f09d07595 := by decide
+example : (0xb29cf0a3067c76d9a6a5be9256aa16bfa53b489c29a827b08ee50d83adbf1016 <<< 224) % 2^256 = 0xadbf101600000000000000000000000000000000000000000000000000000000 := by decide
+example : 0xb29cf0a3067c76d9a6a5be9256aa16bfa53b489c29a827b08ee50d83adbf1016 >>> 224 = 0x00000000000000000000000000000000000000000000000000000000b29cf0a3 := by decide
+example : Nat.log2 0x705f49b84792b45d178c13e0e7845acc667e04e4e4dcf2c42137c5dca46f6583 = 254 := by decide
+example : (-0xb29cf0a3067c76d9a6a5be9256aa16bfa53b489c29a827b08ee50d83adbf1016 : Int) % 0x705f49b84792b45d178c13e0e7845acc667e04e4e4dcf2c42137c5dca46f6583 = -0x423da6eabee9c27c8f19aab16f25bbf33ebd43b744cb34ec6dad47a7094faa93 := by decide
+
+example : 0xfa1ceb1e871bc05361d87af23c7be69e421c545acaa061cbe0a8f8fa640591f3 &&& 0x7c69fa7f32b4d9b186b07d544965a3ea3e2d0f34cb03b06aa81e87d7efc51b21 = 0x7808ea1e0210c011009078500861a28a020c0410ca00204aa00880d264051121 := by decide
+example : 0xfa1ceb1e871bc05361d87af23c7be69e421c545acaa061cbe0a8f8fa640591f3 ||| 0x7c69fa7f32b4d9b186b07d544965a3ea3e2d0f34cb03b06aa81e87d7efc51b21 = 0xfe7dfb7fb7bfd9f3e7f87ff67d7fe7fe7e3d5f7ecba3f1ebe8beffffefc59bf3 := by decide
+example : 0xfa1ceb1e871bc05361d87af23c7be69e421c545acaa061cbe0a8f8fa640591f3 ^^^ 0x7c69fa7f32b4d9b186b07d544965a3ea3e2d0f34cb03b06aa81e87d7efc51b21 = 0x86751161b5af19e2e76807a6751e45747c315b6e01a3d1a148b67f2d8bc08ad2 := by decide
+example : (0xfa1ceb1e871bc05361d87af23c7be69e421c545acaa061cbe0a8f8fa640591f3 <<< 124) % 2^256 = 0xe421c545acaa061cbe0a8f8fa640591f30000000000000000000000000000000 := by decide
+example : 0xfa1ceb1e871bc05361d87af23c7be69e421c545acaa061cbe0a8f8fa640591f3 >>> 124 = 0x0000000000000000000000000000000fa1ceb1e871bc05361d87af23c7be69e4 := by decide
+example : Nat.log2 0x7c69fa7f32b4d9b186b07d544965a3ea3e2d0f34cb03b06aa81e87d7efc51b21 = 254 := by decide
+example : (-0xfa1ceb1e871bc05361d87af23c7be69e421c545acaa061cbe0a8f8fa640591f3 : Int) % 0x7c69fa7f32b4d9b186b07d544965a3ea3e2d0f34cb03b06aa81e87d7efc51b21 = -0x0148f62021b20cf054778049a9b09ec9c5c235f1349900f6906be94a847b5bb1 := by decide
+
+example : 0xa9dac8c19b17c34a5ca1375be9f783454cfa4b0089b9c737bbe0c4432589bfaa &&& 0x3682eae56826e5cbba11cc88a18ed53ad07de19907e0b24861eecfc3cd824063 = 0x2082c8c10806c14a18010408a18681004078410001a0820021e0c44305800022 := by decide
+example : 0xa9dac8c19b17c34a5ca1375be9f783454cfa4b0089b9c737bbe0c4432589bfaa ||| 0x3682eae56826e5cbba11cc88a18ed53ad07de19907e0b24861eecfc3cd824063 = 0xbfdaeae5fb37e7cbfeb1ffdbe9ffd77fdcffeb998ff9f77ffbeecfc3ed8bffeb := by decide
+example : 0xa9dac8c19b17c34a5ca1375be9f783454cfa4b0089b9c737bbe0c4432589bfaa ^^^ 0x3682eae56826e5cbba11cc88a18ed53ad07de19907e0b24861eecfc3cd824063 = 0x9f582224f3312681e6b0fbd34879567f9c87aa998e59757fda0e0b80e80bffc9 := by decide
+example : (0xa9dac8c19b17c34a5ca1375be9f783454cfa4b0089b9c737bbe0c4432589bfaa <<< 141) % 2^256 = 0x4960113738e6f77c188864b137f5400000000000000000000000000000000000 := by decide
+example : 0xa9dac8c19b17c34a5ca1375be9f783454cfa4b0089b9c737bbe0c4432589bfaa >>> 141 = 0x0000000000000000000000000000000000054ed6460cd8be1a52e509badf4fbc := by decide
+example : Nat.log2 0x3682eae56826e5cbba11cc88a18ed53ad07de19907e0b24861eecfc3cd824063 = 253 := by decide
+example : (-0xa9dac8c19b17c34a5ca1375be9f783454cfa4b0089b9c737bbe0c4432589bfaa : Int) % 0x3682eae56826e5cbba11cc88a18ed53ad07de19907e0b24861eecfc3cd824063 = -0x0652081162a311e72e6bd1c2054b0394db80a6357217b05e961454f7bd02fe81 := by decide
+
+example : 0xe2fcb3d9f87c50bbd57f5ef4404e0bb5897f11da48d5a893769249fb19de94f0 &&& 0x7179def131812a34fd7983ec7d59d2c1d5db25ccbb4a0e3b1113cc41d97e8cf1 = 0x607892d130000030d57902e440480281815b01c80840081310124841195e84f0 := by decide
+example : 0xe2fcb3d9f87c50bbd57f5ef4404e0bb5897f11da48d5a893769249fb19de94f0 ||| 0x7179def131812a34fd7983ec7d59d2c1d5db25ccbb4a0e3b1113cc41d97e8cf1 = 0xf3fdfff9f9fd7abffd7fdffc7d5fdbf5ddff35defbdfaebb7793cdfbd9fe9cf1 := by decide
+example : 0xe2fcb3d9f87c50bbd57f5ef4404e0bb5897f11da48d5a893769249fb19de94f0 ^^^ 0x7179def131812a34fd7983ec7d59d2c1d5db25ccbb4a0e3b1113cc41d97e8cf1 = 0x93856d28c9fd7a8f2806dd183d17d9745ca43416f39fa6a8678185bac0a01801 := by decide
+example : (0xe2fcb3d9f87c50bbd57f5ef4404e0bb5897f11da48d5a893769249fb19de94f0 <<< 25) % 2^256 = 0xb3f0f8a177aafebde8809c176b12fe23b491ab5126ed2493f633bd29e0000000 := by decide
+example : 0xe2fcb3d9f87c50bbd57f5ef4404e0bb5897f11da48d5a893769249fb19de94f0 >>> 25 = 0x000000717e59ecfc3e285deabfaf7a202705dac4bf88ed246ad449bb4924fd8c := by decide
+example : Nat.log2 0x7179def131812a34fd7983ec7d59d2c1d5db25ccbb4a0e3b1113cc41d97e8cf1 = 254 := by decide
+example : (-0xe2fcb3d9f87c50bbd57f5ef4404e0bb5897f11da48d5a893769249fb19de94f0 : Int) % 0x7179def131812a34fd7983ec7d59d2c1d5db25ccbb4a0e3b1113cc41d97e8cf1 = -0x0008f5f79579fc51da8c571b459a6631ddc8c640d2418c1d546ab17766e17b0e := by decide
+
+example : 0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 &&& 0xb5df2b729a77ce204adafa9f4998441aa77275b11809f83e98e24187fb09c57d = 0xa0d82212125100204a12700600184000274000911808b81c0042018618084141 := by decide
+example : 0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 ||| 0xb5df2b729a77ce204adafa9f4998441aa77275b11809f83e98e24187fb09c57d = 0xb7dfab7ffa77ee21dbfafedf7ff9767ab777f7b55c7dfdffdffee3fffbefff7d := by decide
+example : 0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 ^^^ 0xb5df2b729a77ce204adafa9f4998441aa77275b11809f83e98e24187fb09c57d = 0x1707896de826ee0191e88ed97fe1367a9037f724447545e3dfbce279e3e7be3c := by decide
+example : (0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 <<< 81) % 2^256 = 0xe88c6cf2e4c06e8b052ab8f97bba8ebd47fc31dcf68200000000000000000000 := by decide
+example : 0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 >>> 81 = 0x00000000000000000000516c510fb9289010ed993a231b3cb9301ba2c14aae3e := by decide
+example : Nat.log2 0xb5df2b729a77ce204adafa9f4998441aa77275b11809f83e98e24187fb09c57d = 255 := by decide
+example : (-0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 : Int) % 0xb5df2b729a77ce204adafa9f4998441aa77275b11809f83e98e24187fb09c57d = -0xa2d8a21f72512021db32744636797260374582955c7cbddd475ea3fe18ee7b41 := by decide
+
+example : 0xc30edf18ba231158bea60548aee9d6e3e9e4483b7999f4fbd79f459d5d223101 &&& 0xbb32c965e78c33ff78f1714d124f380038ef19467b216f468892770857198df7 = 0x8302c900a200115838a001480249100028e40802790164428092450855000101 := by decide
+example : 0xc30edf18ba231158bea60548aee9d6e3e9e4483b7999f4fbd79f459d5d223101 ||| 0xbb32c965e78c33ff78f1714d124f380038ef19467b216f468892770857198df7 = 0xfb3edf7dffaf33fffef7754dbeeffee3f9ef597f7bb9ffffdf9f779d5f3bbdf7 := by decide
+example : 0xc30edf18ba231158bea60548aee9d6e3e9e4483b7999f4fbd79f459d5d223101 ^^^ 0xbb32c965e78c33ff78f1714d124f380038ef19467b216f468892770857198df7 = 0x783c167d5daf22a7c6577405bca6eee3d10b517d02b89bbd5f0d32950a3bbcf6 := by decide
+example : (0xc30edf18ba231158bea60548aee9d6e3e9e4483b7999f4fbd79f459d5d223101 <<< 178) % 2^256 = 0xd3ef5e7d16757488c40400000000000000000000000000000000000000000000 := by decide
+example : 0xc30edf18ba231158bea60548aee9d6e3e9e4483b7999f4fbd79f459d5d223101 >>> 178 = 0x0000000000000000000000000000000000000000000030c3b7c62e88c4562fa9 := by decide
+example : Nat.log2 0xbb32c965e78c33ff78f1714d124f380038ef19467b216f468892770857198df7 = 255 := by decide
+example : (-0xc30edf18ba231158bea60548aee9d6e3e9e4483b7999f4fbd79f459d5d223101 : Int) % 0xbb32c965e78c33ff78f1714d124f380038ef19467b216f468892770857198df7 = -0x07dc15b2d296dd5945b493fb9c9a9ee3b0f52ef4fe7885b54f0cce950608a30a := by decide
+
+example : 0xef3ddfaf4c0f0300f40fed4a12e97a69e2a953137f66e8c103a0308299f97d2c &&& 0x8d4f4616fecf0760236e766a605a2f8772114c850337f23bbccced422b8f3a2f = 0x8d0d46064c0f0300200e644a00482a01620140010326e001008020020989382c := by decide
+example : 0xef3ddfaf4c0f0300f40fed4a12e97a69e2a953137f66e8c103a0308299f97d2c ||| 0x8d4f4616fecf0760236e766a605a2f8772114c850337f23bbccced422b8f3a2f = 0xef7fdfbffecf0760f76fff6a72fb7feff2b95f977f77fafbbfecfdc2bbff7f2f := by decide
+example : 0xef3ddfaf4c0f0300f40fed4a12e97a69e2a953137f66e8c103a0308299f97d2c ^^^ 0x8d4f4616fecf0760236e766a605a2f8772114c850337f23bbccced422b8f3a2f = 0x627299b9b2c00460d7619b2072b355ee90b81f967c511afabf6cddc0b2764703 := by decide
+example : (0xef3ddfaf4c0f0300f40fed4a12e97a69e2a953137f66e8c103a0308299f97d2c <<< 223) % 2^256 = 0x4cfcbe9600000000000000000000000000000000000000000000000000000000 := by decide
+example : 0xef3ddfaf4c0f0300f40fed4a12e97a69e2a953137f66e8c103a0308299f97d2c >>> 223 = 0x00000000000000000000000000000000000000000000000000000001de7bbf5e := by decide
+example : Nat.log2 0x8d4f4616fecf0760236e766a605a2f8772114c850337f23bbccced422b8f3a2f = 255 := by decide
+example : (-0xef3ddfaf4c0f0300f40fed4a12e97a69e2a953137f66e8c103a0308299f97d2c : Int) % 0x8d4f4616fecf0760236e766a605a2f8772114c850337f23bbccced422b8f3a2f = -0x61ee99984d3ffba0d0a176dfb28f4ae27098068e7c2ef68546d343406e6a42fd := by decide
+
+example : 0xf36773993c5ae078e7a39f038ff664f3b7fd45e083145f79966914b55dddbeda &&& 0x3825ace0acb6d90cd6f1217d341ffdecad25d5b2703a95abc3823cdea4199933 = 0x302520802c12c008c6a10101041664e0a52545a0001015298200149404199812 := by decide
+example : 0xf36773993c5ae078e7a39f038ff664f3b7fd45e083145f79966914b55dddbeda ||| 0x3825ace0acb6d90cd6f1217d341ffdecad25d5b2703a95abc3823cdea4199933 = 0xfb67fff9bcfef97cf7f3bf7fbffffdffbffdd5f2f33edffbd7eb3cfffdddbffb := by decide
+example : 0xf36773993c5ae078e7a39f038ff664f3b7fd45e083145f79966914b55dddbeda ^^^ 0x3825ace0acb6d90cd6f1217d341ffdecad25d5b2703a95abc3823cdea4199933 = 0xcb42df7990ec39743152be7ebbe9991f1ad89052f32ecad255eb286bf9c427e9 := by decide
+example : (0xf36773993c5ae078e7a39f038ff664f3b7fd45e083145f79966914b55dddbeda <<< 168) % 2^256 = 0x145f79966914b55dddbeda000000000000000000000000000000000000000000 := by decide
+example : 0xf36773993c5ae078e7a39f038ff664f3b7fd45e083145f79966914b55dddbeda >>> 168 = 0x000000000000000000000000000000000000000000f36773993c5ae078e7a39f := by decide
+example : Nat.log2 0x3825ace0acb6d90cd6f1217d341ffdecad25d5b2703a95abc3823cdea4199933 = 253 := by decide
+example : (-0xf36773993c5ae078e7a39f038ff664f3b7fd45e083145f79966914b55dddbeda : Int) % 0x3825ace0acb6d90cd6f1217d341ffdecad25d5b2703a95abc3823cdea4199933 = -0x12d0c016897f7c458bdf190ebf766d410365ef16c22a08ca8860213acd775a0e := by decide
+
+example : 0xca7b9d655e9cdbec6724d098b94c27d7eac66b36c7d090d32b804b91064ecd6a &&& 0x6d6161e757e0bf8881424a8c020ae1ea5cf94219bb7e4975218ba44ea6f09799 = 0x4861016556809b8801004088000821c248c04210835000512180000006408508 := by decide
+example : 0xca7b9d655e9cdbec6724d098b94c27d7eac66b36c7d090d32b804b91064ecd6a ||| 0x6d6161e757e0bf8881424a8c020ae1ea5cf94219bb7e4975218ba44ea6f09799 = 0xef7bfde75ffcffece766da9cbb4ee7fffeff6b3ffffed9f72b8befdfa6fedffb := by decide
+example : 0xca7b9d655e9cdbec6724d098b94c27d7eac66b36c7d090d32b804b91064ecd6a ^^^ 0x6d6161e757e0bf8881424a8c020ae1ea5cf94219bb7e4975218ba44ea6f09799 = 0xa71afc82097c6464e6669a14bb46c63db63f292f7caed9a60a0befdfa0be5af3 := by decide
+example : (0xca7b9d655e9cdbec6724d098b94c27d7eac66b36c7d090d32b804b91064ecd6a <<< 188) % 2^256 = 0x32b804b91064ecd6a00000000000000000000000000000000000000000000000 := by decide
+example : 0xca7b9d655e9cdbec6724d098b94c27d7eac66b36c7d090d32b804b91064ecd6a >>> 188 = 0x00000000000000000000000000000000000000000000000ca7b9d655e9cdbec6 := by decide
+example : Nat.log2 0x6d6161e757e0bf8881424a8c020ae1ea5cf94219bb7e4975218ba44ea6f09799 = 254 := by decide
+example : (-0xca7b9d655e9cdbec6724d098b94c27d7eac66b36c7d090d32b804b91064ecd6a : Int) % 0x6d6161e757e0bf8881424a8c020ae1ea5cf94219bb7e4975218ba44ea6f09799 = -0x5d1a3b7e06bc1c63e5e2860cb74145ed8dcd291d0c52475e09f4a7425f5e35d1 := by decide
+
+example : 0xdd510a85b9d7926cdef4a40c1185f8da333001a8b64be25e8c6b5d8529814feb &&& 0xd36de1138c3b33747882ebf79561bb38d9dc31cf42b9730348073d35eba67379 = 0xd1410001881312645880a0041101b818111001880209620208031d0529804369 := by decide
+example : 0xdd510a85b9d7926cdef4a40c1185f8da333001a8b64be25e8c6b5d8529814feb ||| 0xd36de1138c3b33747882ebf79561bb38d9dc31cf42b9730348073d35eba67379 = 0xdf7deb97bdffb37cfef6efff95e5fbfafbfc31eff6fbf35fcc6f7db5eba77ffb := by decide
+example : 0xdd510a85b9d7926cdef4a40c1185f8da333001a8b64be25e8c6b5d8529814feb ^^^ 0xd36de1138c3b33747882ebf79561bb38d9dc31cf42b9730348073d35eba67379 = 0x0e3ceb9635eca118a6764ffb84e443e2eaec3067f4f2915dc46c60b0c2273c92 := by decide
+example : (0xdd510a85b9d7926cdef4a40c1185f8da333001a8b64be25e8c6b5d8529814feb <<< 116) % 2^256 = 0x8da333001a8b64be25e8c6b5d8529814feb00000000000000000000000000000 := by decide
+example : 0xdd510a85b9d7926cdef4a40c1185f8da333001a8b64be25e8c6b5d8529814feb >>> 116 = 0x00000000000000000000000000000dd510a85b9d7926cdef4a40c1185f8da333 := by decide
+example : Nat.log2 0xd36de1138c3b33747882ebf79561bb38d9dc31cf42b9730348073d35eba67379 = 255 := by decide
+example : (-0xdd510a85b9d7926cdef4a40c1185f8da333001a8b64be25e8c6b5d8529814feb : Int) % 0xd36de1138c3b33747882ebf79561bb38d9dc31cf42b9730348073d35eba67379 = -0x09e329722d9c5ef86671b8147c243da15953cfd973926f5b4464204f3ddadc72 := by decide
+
+example : 0x8b03b18bd29b356146b65bb6261450bc6b5f2a1c2f5b2d0cf4635d228b988de3 &&& 0x1ba4154bb6b8608b36d1151eb6288014959732486aa97a4c6d93e76d220f4fa3 = 0x0b00110b929820010690111626000014011722082a09280c6403452002080da3 := by decide
+example : 0x8b03b18bd29b356146b65bb6261450bc6b5f2a1c2f5b2d0cf4635d228b988de3 ||| 0x1ba4154bb6b8608b36d1151eb6288014959732486aa97a4c6d93e76d220f4fa3 = 0x9ba7b5cbf6bb75eb76f75fbeb63cd0bcffdf3a5c6ffb7f4cfdf3ff6fab9fcfe3 := by decide
+example : 0x8b03b18bd29b356146b65bb6261450bc6b5f2a1c2f5b2d0cf4635d228b988de3 ^^^ 0x1ba4154bb6b8608b36d1151eb6288014959732486aa97a4c6d93e76d220f4fa3 = 0x90a7a4c0642355ea70674ea8903cd0a8fec8185445f2574099f0ba4fa997c240 := by decide
+example : (0x8b03b18bd29b356146b65bb6261450bc6b5f2a1c2f5b2d0cf4635d228b988de3 <<< 129) % 2^256 = 0xd6be54385eb65a19e8c6ba4517311bc600000000000000000000000000000000 := by decide
+example : 0x8b03b18bd29b356146b65bb6261450bc6b5f2a1c2f5b2d0cf4635d228b988de3 >>> 129 = 0x000000000000000000000000000000004581d8c5e94d9ab0a35b2ddb130a285e := by decide
+example : Nat.log2 0x1ba4154bb6b8608b36d1151eb6288014959732486aa97a4c6d93e76d220f4fa3 = 252 := by decide
+example : (-0x8b03b18bd29b356146b65bb6261450bc6b5f2a1c2f5b2d0cf4635d228b988de3 : Int) % 0x1ba4154bb6b8608b36d1151eb6288014959732486aa97a4c6d93e76d220f4fa3 = -0x00cf4711410152a934a0f21c9749d0557f6b2eb21a0bc98ed07fd800e14bffb4 := by decide
+
+example : 0xa7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d &&& 0x87e6e4135d3e70c047c3f0693293f2f8322040e45e79476dfc2e4f0679fdd1b7 = 0x87a48002492060404600306830928208102040c00a18474578204e044135c015 := by decide
+example : 0xa7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d ||| 0x87e6e4135d3e70c047c3f0693293f2f8322040e45e79476dfc2e4f0679fdd1b7 = 0xa7e6fc177d7e71cc5fc7f16bff9bfafa76356ee7fe7df7effc2fffbe7bfdffbf := by decide
+example : 0xa7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d ^^^ 0x87e6e4135d3e70c047c3f0693293f2f8322040e45e79476dfc2e4f0679fdd1b7 = 0x20427c15345e118c19c7c103cf0978f266152e27f465b0aa840fb1ba3ac83faa := by decide
+example : (0xa7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d <<< 28) % 2^256 = 0x66960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d0000000 := by decide
+example : 0xa7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d >>> 28 = 0x0000000a7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4 := by decide
+example : Nat.log2 0x87e6e4135d3e70c047c3f0693293f2f8322040e45e79476dfc2e4f0679fdd1b7 = 255 := by decide
+example : (-0xa7a498066960614c5e04316afd9a8a0a54356ec3aa1cf7c77821febc4335ee1d : Int) % 0x87e6e4135d3e70c047c3f0693293f2f8322040e45e79476dfc2e4f0679fdd1b7 = -0x1fbdb3f30c21f08c16404101cb06971222152ddf4ba3b0597bf3afb5c9381c66 := by decide
+
+example : 0x8608574cfc02d7eb9dfc4b403e69242bdb82be6b681a1e79db836ffb47e4267c &&& 0x0f694eb18eb6c3526c67dbdc961d5ae2ffcba5f612e010f139948e28483a832d = 0x060846008c02c3420c644b4016090022db82a4620000107119800e284020022c := by decide
+example : 0x8608574cfc02d7eb9dfc4b403e69242bdb82be6b681a1e79db836ffb47e4267c ||| 0x0f694eb18eb6c3526c67dbdc961d5ae2ffcba5f612e010f139948e28483a832d = 0x8f695ffdfeb6d7fbfdffdbdcbe7d7eebffcbbfff7afa1ef9fb97effb4ffea77d := by decide
+example : 0x8608574cfc02d7eb9dfc4b403e69242bdb82be6b681a1e79db836ffb47e4267c ^^^ 0x0f694eb18eb6c3526c67dbdc961d5ae2ffcba5f612e010f139948e28483a832d = 0x896119fd72b414b9f19b909ca8747ec924491b9d7afa0e88e217e1d30fdea551 := by decide
+example : (0x8608574cfc02d7eb9dfc4b403e69242bdb82be6b681a1e79db836ffb47e4267c <<< 29) % 2^256 = 0x9f805afd73bf896807cd24857b7057cd6d0343cf3b706dff68fc84cf80000000 := by decide
+example : 0x8608574cfc02d7eb9dfc4b403e69242bdb82be6b681a1e79db836ffb47e4267c >>> 29 = 0x000000043042ba67e016bf5cefe25a01f349215edc15f35b40d0f3cedc1b7fda := by decide
+example : Nat.log2 0x0f694eb18eb6c3526c67dbdc961d5ae2ffcba5f612e010f139948e28483a832d = 251 := by decide
+example : (-0x8608574cfc02d7eb9dfc4b403e69242bdb82be6b681a1e79db836ffb47e4267c : Int) % 0x0f694eb18eb6c3526c67dbdc961d5ae2ffcba5f612e010f139948e28483a832d = -0x0abde1c0864cbd583abd6c5b8d7e4d13dd258ebad11996f00edefeb906100d14 := by decide
+
+example : 0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa &&& 0xe9e0346068cd6c36165a583fc590d35f1d8cf68f198b9744c4258e5f75eb9c4d = 0x81c0140020c44412000258004410914c0808b004088913004000041375818008 := by decide
+example : 0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa ||| 0xe9e0346068cd6c36165a583fc590d35f1d8cf68f198b9744c4258e5f75eb9c4d = 0xfbe2f760fecf6d365f5b7e7fdf9af77f1facff9f5bfb9754e47fbf7ffdfffeef := by decide
+example : 0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa ^^^ 0xe9e0346068cd6c36165a583fc590d35f1d8cf68f198b9744c4258e5f75eb9c4d = 0x7a22e360de0b29245f59267f9b8a663317a44f9b53728454a47fbb6c887e7ee7 := by decide
+example : (0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa <<< 91) % 2^256 = 0x02f0d5ab605145c8a257c8988302d1a99fecaf15500000000000000000000000 := by decide
+example : 0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa >>> 91 = 0x000000000000000000000012785ae016d8c8a249206fc80bc356ad8145172289 := by decide
+example : Nat.log2 0xe9e0346068cd6c36165a583fc590d35f1d8cf68f198b9744c4258e5f75eb9c4d = 255 := by decide
+example : (-0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa : Int) % 0xe9e0346068cd6c36165a583fc590d35f1d8cf68f198b9744c4258e5f75eb9c4d = -0x93c2d700b6c6451249037e405e1ab56c0a28b9144af91310605a3533fd95e2aa := by decide
+
+example : 0xe173309385f2873505d019193b2b360d39c27b064f88547a5ad615de08d702bb &&& 0x7d57068bf71c6efed8e218a212ad1731c65632cc5ddc3ce2dadee2d2db840d41 = 0x615300838510063400c0180012291601004232044d8814625ad600d208840001 := by decide
+example : 0xe173309385f2873505d019193b2b360d39c27b064f88547a5ad615de08d702bb ||| 0x7d57068bf71c6efed8e218a212ad1731c65632cc5ddc3ce2dadee2d2db840d41 = 0xfd77369bf7feefffddf219bb3baf373dffd67bce5fdc7cfadadef7dedbd70ffb := by decide
+example : 0xe173309385f2873505d019193b2b360d39c27b064f88547a5ad615de08d702bb ^^^ 0x7d57068bf71c6efed8e218a212ad1731c65632cc5ddc3ce2dadee2d2db840d41 = 0x9c24361872eee9cbdd3201bb2986213cff9449ca125468988008f70cd3530ffa := by decide
+example : (0xe173309385f2873505d019193b2b360d39c27b064f88547a5ad615de08d702bb <<< 220) % 2^256 = 0xe08d702bb0000000000000000000000000000000000000000000000000000000 := by decide
+example : 0xe173309385f2873505d019193b2b360d39c27b064f88547a5ad615de08d702bb >>> 220 = 0x0000000000000000000000000000000000000000000000000000000e17330938 := by decide
+example : Nat.log2 0x7d57068bf71c6efed8e218a212ad1731c65632cc5ddc3ce2dadee2d2db840d41 = 254 := by decide
+example : (-0xe173309385f2873505d019193b2b360d39c27b064f88547a5ad615de08d702bb : Int) % 0x7d57068bf71c6efed8e218a212ad1731c65632cc5ddc3ce2dadee2d2db840d41 = -0x641c2a078ed618362cee0077287e1edb736c4839f1ac17977ff7330b2d52f57a := by decide
@@ -0,0 +1,28 @@
+/-!
+Task scheduler microbenchmark: a parallel computation of `fib n` in which every recursive call
+spawns its children from a worker thread and awaits them using `Task.bind`/`Task.map`, followed by
+`m` small tasks spawned from and awaited on the main thread. Use `LEAN_NUM_THREADS` to set the
+number of workers.
+-/
+def fib : Nat → Nat
+  | 0 => 0
+  | 1 => 1
+  | n+2 => fib n + fib (n+1)
+
+partial def pfib (cutoff n : Nat) : Task Nat :=
+  if n ≤ cutoff then
+    Task.spawn fun _ => fib n
+  else
+    (Task.spawn fun _ => (pfib cutoff (n - 1), pfib cutoff (n - 2))).bind fun (a, b) =>
+      a.bind fun x => b.map (x + ·)
+
+def spawnAwait (m : Nat) : Nat :=
+  let ts := (List.range m).map fun i => Task.spawn fun _ => fib (i % 10)
+  ts.foldl (fun s t => s + t.get) 0
+
+def main : List String → IO UInt32
+  | [n, cutoff, m] => do
+    let r := (pfib cutoff.toNat! n.toNat!).get
+    IO.println s!"fib: {r}, spawned: {spawnAwait m.toNat!}"
+    return 0
+  | _ => return 1
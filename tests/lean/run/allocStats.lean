@@ -0,0 +1,15 @@
+def test : IO Unit := do
+  let s₁ ← IO.getAllocStats
+  -- make sure the array is not a closed term
+  let n := 1000 + (s₁.numAllocs % 2).toNat
+  let xs := (List.range n).toArray
+  let s₂ ← IO.getAllocStats
+  assert! xs.size == n
+  assert! s₂.numAllocs > s₁.numAllocs
+  assert! s₂.numFrees ≤ s₂.numAllocs
+  assert! s₂.liveBytes > 0
+  assert! s₂.numSegments > 0 && s₂.numPages > 0
+  assert! s₂.slots.all fun s => s.objSize > 0 && s.numFrees ≤ s.numAllocs
+  assert! s₂.slots.foldl (fun n s => n + s.numAllocs) 0 ≤ s₂.numAllocs
+
+#eval test
@@ -0,0 +1,26 @@
+import Lean
+
+open Lean
+
+/-! Compacting a module using several tasks must produce the same file as compacting it sequentially. -/
+
+unsafe def testCompactTasks : IO Unit := do
+  let file ← findOLean `Lean.Elab.Term
+  let (mod, region) ← readModuleData file
+  -- large enough to be split into partitions, see `LEAN_COMPACTOR_MIN_PARALLEL_ROOTS`
+  assert! mod.constants.size ≥ 256
+  let fname (numTasks : UInt32) : System.FilePath := s!"compactTasks{numTasks}.olean.tmp"
+  for numTasks in [1, 2, 4, 0] do
+    saveModuleData (fname numTasks) `Lean.Elab.Term mod (numTasks := numTasks)
+  let expected ← IO.FS.readBinFile (fname 1)
+  for numTasks in [2, 4, 0] do
+    assert! (← IO.FS.readBinFile (fname numTasks)).data == expected.data
+  -- compressed files contain the same data
+  saveModuleData (fname 1) `Lean.Elab.Term mod (compress := true) (numTasks := 1)
+  saveModuleData (fname 4) `Lean.Elab.Term mod (compress := true) (numTasks := 4)
+  assert! (← IO.FS.readBinFile (fname 4)).data == (← IO.FS.readBinFile (fname 1)).data
+  region.free
+  for numTasks in [1, 2, 4, 0] do
+    IO.FS.removeFile (fname numTasks)
+
+#eval testCompactTasks
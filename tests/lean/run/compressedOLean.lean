@@ -0,0 +1,27 @@
+import Lean
+
+open Lean
+
+unsafe def testCompressedOLean : IO Unit := do
+  let file ← findOLean `Lean.Elab.Term
+  let (mod, region) ← readModuleData file
+  let fname : System.FilePath := "compressedOLean.olean.tmp"
+  saveModuleData fname `Lean.Elab.Term mod (compress := true)
+  assert! (← fname.metadata).byteSize < (← file.metadata).byteSize
+  let (mod', region') ← readModuleData fname
+  assert! mod'.imports.map (·.module) == mod.imports.map (·.module)
+  assert! mod'.constNames == mod.constNames
+  assert! mod'.constants.map (·.type) == mod.constants.map (·.type)
+  assert! mod'.entries.map (·.1) == mod.entries.map (·.1)
+  assert! mod'.constIndex.data == mod.constIndex.data
+  region'.free
+  region.free
+  -- truncated files are rejected
+  let bytes ← IO.FS.readBinFile fname
+  IO.FS.writeBinFile fname (bytes.extract 0 (bytes.size / 2))
+  match ← (readModuleData fname).toBaseIO with
+  | .ok _ => throw <| IO.userError "truncated file accepted"
+  | .error _ => pure ()
+  IO.FS.removeFile fname
+
+#eval testCompressedOLean
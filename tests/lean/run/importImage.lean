@@ -0,0 +1,55 @@
+import Lean.Meta
+
+open Lean
+open Lean.Meta
+
+unsafe def testImportImage : IO Unit := do
+  let dir : System.FilePath := "importImage.tmp"
+  if ← dir.pathExists then
+    IO.FS.removeDirAll dir
+  let imports := #[{ module := `Init.Data.List : Import }]
+  let (_, fname) := importImageFile dir imports
+  let opts := importImageDir.set {} dir.toString
+  withImportModules imports {} 0 fun env => do
+    withImportModules imports opts 0 fun _ => pure ()
+    assert! (← fname.pathExists)
+    -- the second import is served from the image
+    withImportModules imports opts 0 fun ienv => do
+      assert! ienv.header.regions.size == 1
+      assert! ienv.header.moduleNames == env.header.moduleNames
+      assert! ienv.constants.map₁.size == env.constants.map₁.size
+      for (c, info) in env.constants.map₁.toList do
+        assert! (ienv.find? c).map (·.type) == some info.type
+        assert! ienv.getModuleIdxFor? c == env.getModuleIdxFor? c
+      let (type, _, _) ← (inferType (mkConst ``List.map [levelOne, levelOne]) : MetaM _).toIO
+        { fileName := "", fileMap := default } { env := ienv }
+      IO.println type
+    -- a different header uses a different image
+    let imports' := #[{ module := `Init.Data.Array : Import }]
+    let (_, fname') := importImageFile dir imports'
+    assert! fname' != fname
+    withImportModules imports' opts 0 fun ienv => do
+      assert! ienv.contains ``Array.map && ienv.header.regions.size > 1
+    -- an image that does not match the header is ignored and replaced
+    IO.FS.writeBinFile fname (← IO.FS.readBinFile fname')
+    withImportModules imports opts 0 fun ienv => do
+      assert! ienv.header.moduleNames == env.header.moduleNames && ienv.header.regions.size > 1
+    withImportModules imports opts 0 fun ienv => do
+      assert! ienv.header.moduleNames == env.header.moduleNames && ienv.header.regions.size == 1
+    -- an `.olean` file is not read as an image
+    let olean ← IO.FS.readBinFile (← findOLean `Init.Data.List.Basic)
+    IO.FS.writeBinFile fname olean
+    withImportModules imports opts 0 fun ienv => do
+      assert! ienv.header.moduleNames == env.header.moduleNames && ienv.header.regions.size > 1
+    -- the images written least recently are deleted when the directory exceeds `importImageDirMaxSize`,
+    -- other files are left alone
+    IO.FS.writeBinFile (dir / "Foreign.olean") olean
+    IO.FS.writeFile (dir / "foreign.limg") "not an image"
+    let imports'' := #[{ module := `Init.Data.Nat : Import }]
+    let (_, fname'') := importImageFile dir imports''
+    withImportModules imports'' (importImageDirMaxSize.set opts 1) 0 fun _ => pure ()
+    assert! (← fname''.pathExists) && !(← fname.pathExists) && !(← fname'.pathExists)
+    assert! (← (dir / "Foreign.olean").pathExists) && (← (dir / "foreign.limg").pathExists)
+  IO.FS.removeDirAll dir
+
+#eval testImportImage
@@ -0,0 +1,49 @@
+import Lean
+
+open Lean
+
+def mkThm (name : Name) (type value : Expr) : Declaration :=
+  .thmDecl { name, levelParams := [], type, value }
+
+unsafe def testAddDeclAsync : IO Unit := do
+  withImportModules #[{ module := `Init.Prelude }] {} 0 fun env => do
+    let .ok env := env.addDeclAsync (mkThm `good (mkConst ``True) (mkConst ``True.intro))
+      | throw <| IO.userError "failed to add 'good'"
+    assert! env.contains `good && env.hasPendingKernelChecks
+    -- later declarations can use the theorem before its value has been checked
+    let .ok env := env.addDeclAsync (mkThm `good' (mkConst ``True) (mkConst `good))
+      | throw <| IO.userError "failed to add 'good''"
+    -- only the header is checked before the theorem is added
+    let .ok env := env.addDeclAsync (mkThm `bad (mkConst ``False) (mkConst ``True.intro))
+      | throw <| IO.userError "failed to add 'bad'"
+    let .ok env := env.addDeclAsync (mkThm `bad' (mkConst ``False) (mkConst `bad'))
+      | throw <| IO.userError "failed to add 'bad''"
+    assert! env.contains `bad && env.contains `bad'
+    match env.addDeclAsync (mkThm `badHeader (mkConst ``True.intro) (mkConst ``True.intro)) with
+    | .ok _    => throw <| IO.userError "invalid header accepted"
+    | .error _ => pure ()
+    let (env', failures) := env.joinKernelChecks
+    assert! failures.map (·.1) == [`bad, `bad']
+    assert! !env'.hasPendingKernelChecks && env'.contains `bad
+    -- failures are only reported once, but they are kept in the environment
+    let (env', failures) := env'.joinKernelChecks
+    assert! failures.isEmpty && env'.kernelCheckFailures == [`bad, `bad']
+    -- modules with failed checks are not written, even after joining the checks
+    let fname : System.FilePath := "kernelAsync.olean.tmp"
+    for env in [env, env'] do
+      match ← (writeModule env fname).toBaseIO with
+      | .ok _    => throw <| IO.userError "module with failed checks written"
+      | .error _ => assert! !(← fname.pathExists)
+  withImportModules #[{ module := `Init.Prelude }] {} 0 fun env => do
+    let .ok env := env.addDeclAsync (mkThm `good (mkConst ``True) (mkConst ``True.intro))
+      | throw <| IO.userError "failed to add 'good'"
+    let fname : System.FilePath := "kernelAsync.olean.tmp"
+    writeModule env fname
+    IO.FS.removeFile fname
+
+#eval testAddDeclAsync
+
+set_option kernel.async true in
+theorem asyncThm (n : Nat) : n + 0 = n := rfl
+
+#print axioms asyncThm
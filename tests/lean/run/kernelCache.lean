@@ -0,0 +1,49 @@
+import Lean
+
+open Lean
+
+def getHits (env : Environment) : IO Nat := do
+  let some cache := kernelCacheExt.getState env | throw <| IO.userError "no shared cache"
+  return (← cache.stats).foldl (fun n (_, hits, _) => n + hits) 0
+
+def natEq (a b : Expr) : Expr :=
+  mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) a b
+
+def mkThm (name : Name) (type value : Expr) : Declaration :=
+  .thmDecl { name, levelParams := [], type, value }
+
+unsafe def testKernelCache : IO Unit := do
+  let imports := #[{ module := `Init.Data.List : Import }]
+  withImportModules imports {} 0 fun env => do assert! (kernelCacheExt.getState env).isNone
+  withImportModules imports (kernel.sharedCacheSize.set {} 1000) 0 fun env => do
+    let len := mkApp2 (mkConst ``List.length [levelZero]) (mkConst ``Nat) (toExpr [1, 2, 3])
+    let .ok _ := Kernel.whnf env {} len | throw <| IO.userError "whnf failed"
+    let hits ← getHits env
+    -- a new type checker reuses the results of the previous one
+    let len' := mkApp2 (mkConst ``List.length [levelZero]) (mkConst ``Nat) (toExpr [0, 1, 2, 3])
+    assert! Kernel.isDefEq env {} len' (mkNatLit 4) matches .ok true
+    assert! (← getHits env) > hits
+    let thm := natEq len (mkNatLit 3)
+    let refl := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) (mkNatLit 3)
+    let .ok env := env.addDecl (mkThm `thm₁ thm refl) | throw <| IO.userError "failed to add 'thm₁'"
+    let hits ← getHits env
+    let .ok env := env.addDecl (mkThm `thm₂ thm refl) | throw <| IO.userError "failed to add 'thm₂'"
+    assert! (← getHits env) > hits
+    -- results for local constants are not shared, as they may differ between environments. This includes the extra
+    -- constant names of the imported modules, which are not imported constants.
+    let some extra := env.header.moduleData.findSome? (·.extraConstNames[0]?)
+      | throw <| IO.userError "no extra constant names"
+    for name in [`c, extra] do
+      let mkDef (n : Nat) := Declaration.defnDecl {
+        name, levelParams := [], type := mkConst ``Nat, value := mkNatLit n
+        hints := .abbrev, safety := .safe }
+      let .ok env₁ := env.addDecl (mkDef 1) | throw <| IO.userError s!"failed to add '{name}'"
+      let .ok env₂ := env.addDecl (mkDef 2) | throw <| IO.userError s!"failed to add '{name}'"
+      let c := mkApp2 (mkConst ``Nat.add) (mkConst name) (mkNatLit 0)
+      assert! Kernel.whnf env₁ {} c matches .ok (.lit (.natVal 1))
+      assert! Kernel.whnf env₂ {} c matches .ok (.lit (.natVal 2))
+      match env₂.addDecl (mkThm `bad (natEq c (mkNatLit 1)) (mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) (mkNatLit 1))) with
+      | .ok _    => throw <| IO.userError "invalid theorem accepted"
+      | .error _ => pure ()
+
+#eval testKernelCache
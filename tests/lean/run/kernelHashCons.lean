@@ -0,0 +1,46 @@
+import Lean
+
+open Lean
+
+/-- `n = n + [n].length` (false, but `hashCons` does not care), built at run time so that its subterms are not shared. -/
+def mkProp (n : Nat) : Expr :=
+  let len := mkApp2 (mkConst ``List.length [levelZero]) (mkConst ``Nat) (toExpr [n])
+  mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) (mkNatLit n) (mkApp2 (mkConst ``Nat.add) (mkNatLit n) len)
+
+unsafe def testHashCons : IO Unit := do
+  let r ← IO.mkRef 3
+  let e₁ := mkProp (← r.get)
+  let e₂ := mkProp (← r.get)
+  assert! ptrAddrUnsafe e₁ != ptrAddrUnsafe e₂
+  let e₁ ← Kernel.hashCons e₁
+  let e₂ ← Kernel.hashCons e₂
+  assert! e₁ == mkProp 3
+  assert! ptrAddrUnsafe e₁ == ptrAddrUnsafe e₂
+  -- subterms are shared as well
+  let e₃ ← Kernel.hashCons (mkApp (mkConst ``Not) (mkProp (← r.get)))
+  assert! ptrAddrUnsafe e₃.appArg! == ptrAddrUnsafe e₁
+  -- binder names and annotations are preserved
+  let l₁ ← Kernel.hashCons (.lam `x (mkConst ``Nat) (.bvar 0) .default)
+  let l₂ ← Kernel.hashCons (.lam `y (mkConst ``Nat) (.bvar 0) .implicit)
+  assert! l₂.bindingName! == `y && l₂.binderInfo == .implicit
+  assert! ptrAddrUnsafe l₁ != ptrAddrUnsafe l₂
+  assert! ptrAddrUnsafe l₁.bindingDomain! == ptrAddrUnsafe l₂.bindingDomain!
+
+unsafe def testAddDecl : IO Unit := do
+  withImportModules #[{ module := `Init.Data.List : Import }] {} 0 fun env => do
+    let r ← IO.mkRef 3
+    let len := mkApp2 (mkConst ``List.length [levelZero]) (mkConst ``Nat) (toExpr [1, 2, (← r.get)])
+    let type := mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) len (mkNatLit (← r.get))
+    let value := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) (mkNatLit (← r.get))
+    let decl := Declaration.thmDecl { name := `thm, levelParams := [], type, value }
+    let (_, s) ← (addDecl decl : CoreM Unit).toIO
+      { fileName := "", fileMap := default, options := kernel.hashCons.set {} true } { env }
+    let some (.thmInfo info) := s.env.find? `thm | throw <| IO.userError "'thm' not added"
+    assert! info.type == type && info.value == value
+    assert! ptrAddrUnsafe info.type == ptrAddrUnsafe (← Kernel.hashCons type)
+
+#eval testHashCons
+#eval testAddDecl
+
+set_option kernel.hashCons true in
+theorem lengthThree : [1, 2, 3].length = 3 ∧ [1, 2, 3].length = 3 := ⟨rfl, rfl⟩
@@ -0,0 +1,41 @@
+import Lean
+
+open Lean
+
+def big : Nat := 2^200 + 12345
+def big' : Nat := 2^199 + 2^100 + 6789
+
+unsafe def testKernelNatBitwise : IO Unit := do
+  withImportModules #[{ module := `Init.Data.Nat : Import }] {} 0 fun env => do
+    let whnfEq (fn : Name) (args : List Nat) (v : Nat) : IO Unit := do
+      let e := mkAppN (mkConst fn) (args.map mkRawNatLit).toArray
+      match Kernel.whnf env {} e with
+      | .ok (.lit (.natVal v')) => assert! v == v'
+      | .ok e                   => throw <| IO.userError s!"{fn} {args} was not reduced to a literal: {e}"
+      | .error _                => throw <| IO.userError s!"{fn} {args} failed"
+    whnfEq ``Nat.land [big, big'] (big &&& big')
+    whnfEq ``Nat.lor [big, big'] (big ||| big')
+    whnfEq ``Nat.xor [big, big'] (big ^^^ big')
+    whnfEq ``Nat.shiftLeft [big, 100] (big <<< 100)
+    whnfEq ``Nat.shiftRight [big, 150] (big >>> 150)
+    whnfEq ``Nat.log2 [big] 200
+    whnfEq ``Nat.log2 [0] 0
+
+#eval testKernelNatBitwise
+
+-- like the kernel, `whnf` does not reduce shifts by amounts that the runtime cannot handle
+#eval show MetaM Unit from do
+  let shift (fn : Name) (a b : Nat) := mkApp2 (mkConst fn) (mkRawNatLit a) (mkRawNatLit b)
+  assert! (← Meta.reduceNat? (shift ``Nat.shiftLeft 3 4)) == some (mkRawNatLit 48)
+  assert! (← Meta.reduceNat? (shift ``Nat.shiftRight 48 4)) == some (mkRawNatLit 3)
+  assert! (← Meta.reduceNat? (shift ``Nat.shiftLeft 1 (2^32))).isNone
+  assert! (← Meta.reduceNat? (shift ``Nat.shiftRight 1 (2^64))).isNone
+
+example : (2^256 - 1) &&& 0xdeadbeef = 0xdeadbeef := by decide
+example : 2^255 ||| 1 = 2^255 + 1 := by decide
+example : (2^256 - 1) ^^^ (2^255) = 2^255 - 1 := by decide
+example : 3 <<< 254 = 2^255 + 2^254 := by decide
+example : (2^256 - 1) >>> 255 = 1 := by decide
+example : Nat.log2 (2^256 + 2^100) = 256 := by decide
+example : (-(2^200) : Int) / 2^100 = -(2^100) := by decide
+example : (-(2^200) - 1 : Int) % 2^100 = -1 := by decide
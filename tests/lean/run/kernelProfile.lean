@@ -0,0 +1,42 @@
+import Lean
+
+open Lean
+
+def lenEq (n : Nat) : Expr :=
+  let len := mkApp2 (mkConst ``List.length [levelZero]) (mkConst ``Nat) (toExpr [1, 2, 3])
+  mkApp3 (mkConst ``Eq [levelOne]) (mkConst ``Nat) len (mkNatLit n)
+
+def mkThm (name : Name) (type : Expr) : Declaration :=
+  .thmDecl { name, levelParams := [], type, value := mkApp2 (mkConst ``Eq.refl [levelOne]) (mkConst ``Nat) (mkNatLit 3) }
+
+unsafe def testKernelProfile : IO Unit := do
+  withImportModules #[{ module := `Init.Data.List : Import }] {} 0 fun env => do
+    let (.ok env', profile) := env.addDeclWithProfile (mkThm `thm (lenEq 3))
+      | throw <| IO.userError "failed to add 'thm'"
+    assert! env'.contains `thm
+    let calls (fn : String) := (profile.counters.find? (·.fn == fn)).map (·.calls) |>.getD 0
+    assert! calls "isDefEqCore" > 0 && calls "whnfCore" > 0 && calls "inferType" > 0
+    assert! profile.unfolded.any (·.1 == ``List.length)
+    let (r, _) := env.addDeclWithProfile (mkThm `thm (lenEq 4))
+    assert! r matches .error _
+    -- reports of `addDecl`
+    let fileName : System.FilePath := "kernelProfile.json.tmp"
+    if ← fileName.pathExists then
+      IO.FS.removeFile fileName
+    let opts := kernel.profile.set {} true
+    let opts := kernel.profile.threshold.set opts 0
+    let opts := kernel.profile.json.set opts fileName.toString
+    let (_, s) ← (addDecl (mkThm `thm (lenEq 3)) : CoreM Unit).toIO
+      { fileName := "", fileMap := default, options := opts } { env }
+    assert! s.messages.msgs.size == 1
+    let some line := (← IO.FS.lines fileName)[0]? | throw <| IO.userError "no JSON report"
+    let .ok json := Json.parse line | throw <| IO.userError "invalid JSON report"
+    assert! json.getObjValAs? (List Name) "decls" matches .ok [`thm]
+    assert! (json.getObjValD "unfolded").getObjVal? "List.length" |>.isOk
+    IO.FS.removeFile fileName
+
+#eval testKernelProfile
+
+set_option kernel.profile true in
+set_option kernel.profile.threshold 0 in
+theorem lengthThree : [1, 2, 3].length = 3 := rfl
@@ -0,0 +1,52 @@
+import Lean.Meta
+
+open Lean
+open Lean.Meta
+
+unsafe def testLazyImport : IO Unit := do
+  let imports := #[{ module := `Init.Data.List : Import }]
+  withImportModules imports {} 0 fun env =>
+  withImportModules imports (lazyImport.set {} true) 0 fun lenv => do
+    assert! lenv.constants.map₁.isEmpty
+    for (c, info) in env.constants.map₁.toList do
+      assert! (lenv.find? c).map (·.type) == some info.type
+      assert! lenv.contains c
+      assert! lenv.getModuleIdxFor? c == env.getModuleIdxFor? c
+      assert! (lenv.find? (c.str "_notThere")).isNone
+    for mod in env.header.moduleData do
+      for c in mod.extraConstNames do
+        assert! lenv.getModuleIdxFor? c == env.getModuleIdxFor? c
+    let (type, _, _) ← (inferType (mkConst ``List.map [levelOne, levelOne]) : MetaM _).toIO
+      { fileName := "", fileMap := default } { env := lenv }
+    IO.println type
+
+#eval testLazyImport
+
+unsafe def testDuplicate : IO Unit := do
+  withImportModules #[{ module := `Init.Data.List : Import }] {} 0 fun env => do
+    let mods := env.header.moduleData.map fun mod => { mod with constIndex := mkConstIndex mod.constNames }
+    match mkImportedConstIndex (mods.push mods[1]!) with
+    | .ok _ => throw <| IO.userError "duplicate not detected"
+    | .error (modIdx, i) => assert! modIdx == mods.size && mods[1]!.constNames[i]! != .anonymous
+    match mkImportedConstIndex mods with
+    | .ok index =>
+      for (c, _) in env.constants.map₁.toList do
+        assert! (findImportedConst? index mods c).map (·.name) == some c
+    | .error _ => throw <| IO.userError "unexpected duplicate"
+
+#eval testDuplicate
+
+unsafe def testForConstants : IO Unit := do
+  let imports := #[{ module := `Init.Data.List : Import }]
+  withImportModules imports {} 0 fun env =>
+  withImportModules imports (lazyImport.set {} true) 0 fun lenv => do
+    let .ok lenv := lenv.addDecl <| .axiomDecl { name := `ax, levelParams := [], type := mkSort levelZero, isUnsafe := false }
+      | throw <| IO.userError "failed to add declaration"
+    let (_, names) ← (lenv.forConstantsM fun n _ => modify (·.insert n) : StateT NameSet IO Unit).run {}
+    assert! names.size == env.constants.size + 1 && names.contains `ax
+    for (c, _) in env.constants.map₁.toList do
+      assert! names.contains c
+    assert! lenv.foldConstants 0 (fun n _ _ => n + 1) == names.size
+    assert! env.foldConstants 0 (fun n _ _ => n + 1) == env.constants.size
+
+#eval testForConstants
@@ -0,0 +1,25 @@
+import Lean
+
+open Lean
+
+unsafe def testOLeanHash : IO Unit := do
+  let (mod, region) ← readModuleData (← findOLean `Lean.Elab.Term)
+  let fname : System.FilePath := "oleanHash.olean.tmp"
+  saveModuleData fname `Lean.Elab.Term mod
+  let some hash ← readModuleDataHash? fname | throw <| IO.userError "no hash"
+  -- the hash only depends on the contents
+  saveModuleData fname `Lean.Elab.Term mod
+  assert! (← readModuleDataHash? fname) == some hash
+  saveModuleData fname `Lean.Elab.Term mod (compress := true)
+  assert! (← readModuleDataHash? fname) == some hash
+  saveModuleData fname `Lean.Elab.Term { mod with constNames := mod.constNames.pop }
+  assert! (← readModuleDataHash? fname) != some hash
+  -- files with a hash are read as usual
+  saveModuleData fname `Lean.Elab.Term mod
+  let (mod', region') ← readModuleData fname
+  assert! mod'.constNames == mod.constNames
+  region'.free
+  region.free
+  IO.FS.removeFile fname
+
+#eval testOLeanHash
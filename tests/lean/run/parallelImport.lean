@@ -0,0 +1,43 @@
+import Lean
+
+open Lean
+
+partial def importSequentially (imports : Array Import) : ImportStateM Unit := do
+  for i in imports do
+    if i.runtimeOnly || (← get).moduleNameSet.contains i.module then
+      continue
+    modify fun s => { s with moduleNameSet := s.moduleNameSet.insert i.module }
+    let (mod, region) ← readModuleData (← findOLean i.module)
+    importSequentially mod.imports
+    modify fun s => { s with
+      moduleData  := s.moduleData.push mod
+      regions     := s.regions.push region
+      moduleNames := s.moduleNames.push i.module
+    }
+
+def testParallelImport : IO Unit := do
+  let imports := #[{ module := `Lean.Meta : Import }, { module := `Init.Data.List : Import }]
+  let (_, s₁) ← importSequentially imports |>.run
+  let (_, s₂) ← importModulesCore imports |>.run
+  let (_, s₃) ← (do importModulesCore #[{ module := `Init : Import }]; importModulesCore imports) |>.run
+  assert! s₁.moduleNames == s₂.moduleNames
+  assert! s₁.moduleNames == s₃.moduleNames
+  assert! s₁.moduleData.map (·.constNames) == s₂.moduleData.map (·.constNames)
+
+#eval testParallelImport
+
+unsafe def testConstMaps : IO Unit := do
+  withImportModules #[{ module := `Lean.Meta : Import }] {} 0 fun env => do
+    let mut modIdxs : HashMap Name ModuleIdx := {}
+    for h : modIdx in [0:env.header.moduleData.size] do
+      let mod := env.header.moduleData[modIdx]'h.upper
+      for c in mod.constNames ++ mod.extraConstNames do
+        modIdxs := modIdxs.insert c modIdx
+    assert! env.const2ModIdx.size == modIdxs.size
+    for (c, modIdx) in modIdxs.toList do
+      assert! env.getModuleIdxFor? c == some modIdx
+    for mod in env.header.moduleData do
+      for c in mod.constNames do
+        assert! (env.find? c).map (·.name) == some c
+
+#eval testConstMaps
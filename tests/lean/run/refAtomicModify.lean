@@ -0,0 +1,60 @@
+/-!
+Concurrent updates of a shared `IO.Ref` using `atomicModify`, `modify`, and `swap` must not lose any update,
+and threads reading or taking the value of a reference must wait for it without spinning.
+-/
+
+def incrementAll (r : IO.Ref Nat) (n k : Nat) (inc : IO.Ref Nat → IO Unit) : IO Unit := do
+  let ts ← (List.range n).mapM fun _ => IO.asTask (prio := .dedicated) do
+    for _ in [0:k] do inc r
+  for t in ts do
+    let _ ← IO.ofExcept t.get
+
+def testModify : IO Unit := do
+  let r ← IO.mkRef 0
+  incrementAll r 8 1000 (·.atomicModify (· + 1))
+  assert! (← r.get) == 8000
+  incrementAll r 8 1000 (·.modify (· + 1))
+  assert! (← r.get) == 16000
+  incrementAll r 8 1000 fun r => do let _ ← r.atomicModifyGet fun n => (n, n + 1)
+  assert! (← r.get) == 24000
+
+#eval testModify
+
+-- threads continuously reading `r` must not prevent `atomicModify` from making progress
+def testModifyWithReaders : IO Unit := do
+  let r ← IO.mkRef 0
+  let done ← IO.mkRef false
+  let readers ← (List.range 4).mapM fun _ => IO.asTask (prio := .dedicated) do
+    while !(← done.get) do
+      let _ ← r.get
+  incrementAll r 4 1000 (·.atomicModify (· + 1))
+  done.set true
+  for t in readers do
+    let _ ← IO.ofExcept t.get
+  assert! (← r.get) == 4000
+
+#eval testModifyWithReaders
+
+-- `swap` must return the previous value even when racing with other writers
+def testSwap : IO Unit := do
+  let r ← IO.mkRef 0
+  let ts ← (List.range 8).mapM fun i => IO.asTask (prio := .dedicated) do
+    let mut s := 0
+    for _ in [0:1000] do s := s + (← r.swap i)
+    return s
+  let mut total := 0
+  for t in ts do total := total + (← IO.ofExcept t.get)
+  -- every value stored in `r` is either returned by exactly one `swap` or remains in `r`
+  let expected := (List.range 8).foldl (fun s i => s + 1000 * i) 0
+  assert! total + (← r.get) == expected
+
+#eval testSwap
+
+-- threads forcing a thunk evaluated by another thread wait for its value
+def testThunk : IO Unit := do
+  let t : Thunk Nat := Thunk.mk fun _ => (List.range 100000).foldl (· + ·) 0
+  let ts ← (List.range 8).mapM fun _ => IO.asTask (prio := .dedicated) (pure t.get)
+  for task in ts do
+    assert! (← IO.ofExcept task.get) == 4999950000
+
+#eval testThunk
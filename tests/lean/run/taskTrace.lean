@@ -0,0 +1,19 @@
+def sumTo (n : Nat) : Nat :=
+  (List.range n).foldl (· + ·) 0
+
+def test : IO Unit := do
+  let fname := "taskTrace.lean.trace.json"
+  IO.startTaskTrace fname
+  let tasks := (List.range 8).map fun i => Task.spawn fun _ => sumTo (1000 * (i + 1))
+  for t in tasks do
+    discard <| IO.wait t
+  IO.stopTaskTrace
+  -- tracing is already stopped
+  IO.stopTaskTrace
+  let trace ← IO.FS.readFile fname
+  IO.FS.removeFile fname
+  assert! trace.startsWith "{\"traceEvents\":["
+  assert! (trace.splitOn "\"name\":\"enqueue\"").length > 8
+  assert! (trace.splitOn "\"dropped_events\":0").length == 2
+
+#eval test
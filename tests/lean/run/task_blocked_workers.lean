@@ -0,0 +1,18 @@
+/-!
+Workers blocked in `Task.get` must not keep the tasks they are waiting for from running. This used to
+stall whenever at least as many tasks were waiting as there were workers.
+-/
+
+-- every task waits for a promise that is only resolved by the last spawned task
+def waitPromises (n : Nat) : IO Nat := do
+  let ps ← (List.range n).mapM fun _ => IO.Promise.new (α := Nat)
+  let ws := ps.map fun p => Task.spawn fun _ => p.result.get + 1
+  let _ ← IO.asTask (ps.forM fun p => p.resolve 1)
+  return ws.foldl (fun s t => s + t.get) 0
+
+-- every task waits for a task it spawned
+partial def nested (n : Nat) : Nat :=
+  if n == 0 then 0 else (Task.spawn fun _ => nested (n - 1)).get + 1
+
+#eval show IO Unit from do assert! (← waitPromises 64) == 128
+#eval show IO Unit from do assert! (Task.spawn fun _ => nested 200).get == 200